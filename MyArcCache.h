@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "MyCachePolicy.h"
+#include "MyFlatIndex.h"
+#include "MyNodePool.h"
+#include "MyRemovalQueue.h"
+
+namespace MyCache {
+
+	// ARC(Adaptive Replacement Cache)：T1存只访问过一次的数据，T2存访问过至少两次的数据，
+	// B1/B2分别是从T1/T2淘汰下来的幽灵key（只留key不留value）。
+	// 命中B1说明T1给小了，命中B2说明T2给小了，据此在线调整T1的目标大小p_，扫描流量只会冲刷T1，T2里的热点留得住
+	template<typename Key, typename Value, template<typename...> class Index = MyFlatIndex>
+	class MyArcCache :public MyCachePolicy<Key, Value> {
+	private:
+		enum ListId : uint8_t { kT1, kT2, kB1, kB2, kListNum };
+
+		struct Node {
+			Key key;
+			Value value;
+			Node* prev;
+			Node* next;
+			uint8_t list; // 所在的链表
+
+			Node() :key(), value(), prev(this), next(this), list(kT1) {}
+
+			template<typename... Args>
+			explicit Node(const Key& k, Args&&... args) :key(k), value(std::forward<Args>(args)...), prev(nullptr), next(nullptr), list(kT1) {}
+		};
+
+		struct List { // 带哨兵的循环链表，head.next是最近使用端，head.prev是最久未使用端
+			Node   head;
+			size_t size = 0;
+		};
+
+		using NodePtr = Node*;
+		using NodeMap = Index<Key, NodePtr>; // 四个链表共用一个索引，幽灵key也在索引里
+		using Lock = MyNotifyingLock<std::mutex, Key, Value>;
+
+		int                capacity_;
+		size_t             p_; // T1的目标大小，范围[0, capacity_]
+		List               lists_[kListNum];
+		NodeMap            nodeMap_;
+		MyNodePool<Node>   nodePool_;
+		std::mutex         mutex_;
+		MyRemovalQueue<Key, Value> removals_; // 锁内排队的移除通知，实体降为幽灵也算淘汰
+
+	public:
+		explicit MyArcCache(int capacity)
+			:capacity_(capacity), p_(0),
+			nodeMap_(capacity > 0 ? static_cast<size_t>(capacity) * 2 : 0),
+			nodePool_(capacity > 0 ? static_cast<size_t>(capacity) * 2 : 0) {} // 实体和幽灵合计最多2c个
+
+		~MyArcCache() override {
+			for (List& list : lists_) {
+				clearList(list);
+			}
+		}
+
+		void put(const Key& key, const Value& value) override {
+			putInternal(key, value);
+		}
+
+		void put(const Key& key, Value&& value) override {
+			putInternal(key, std::move(value));
+		}
+
+		Value get(const Key& key) override {
+			Value value{};
+			get(key, value);
+			return value;
+		}
+
+		bool get(const Key& key, Value& value) override {
+			return getInternal(key, value);
+		}
+
+		// 异构查找，例如key为std::string时直接传std::string_view/const char*
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		bool get(const K& key, Value& value) {
+			return getInternal(key, value);
+		}
+
+		bool contains(const Key& key) override { // 只看T1/T2，不算一次访问
+			Lock lock(mutex_, removals_);
+			NodePtr* it = nodeMap_.find(key);
+			return it != nullptr && isResident(*it);
+		}
+
+		// 删掉实体；幽灵key不算缓存里的条目，返回false，但也一并忘掉
+		bool erase(const Key& key) override {
+			Lock lock(mutex_, removals_);
+			uint64_t h = nodeMap_.hash(key);
+			NodePtr* it = nodeMap_.find(key, h);
+			if (it == nullptr)
+				return false;
+			NodePtr node = *it;
+			bool resident = isResident(node);
+			if (resident)
+				removals_.push(node->key, std::move(node->value), MyRemovalCause::kExplicit);
+			unlink(node);
+			nodeMap_.erase(node->key, h);
+			nodePool_.deallocate(node);
+			return resident;
+		}
+
+		void clear() override { // 实体和幽灵全部清空，自适应目标回到0
+			Lock lock(mutex_, removals_);
+			for (uint8_t id : { kT1, kT2 }) {
+				for (NodePtr node = lists_[id].head.next; node != &lists_[id].head; node = node->next) {
+					removals_.push(node->key, std::move(node->value), MyRemovalCause::kExplicit);
+				}
+			}
+			for (List& list : lists_) {
+				clearList(list);
+			}
+			nodeMap_.clear();
+			p_ = 0;
+		}
+
+		size_t size() override {
+			Lock lock(mutex_, removals_);
+			return residentSize();
+		}
+
+		// 实体被淘汰（降为幽灵或直接丢弃）或删除时的回调，在解锁后调用
+		void setEvictionListener(MyEvictionListener<Key, Value> listener) {
+			Lock lock(mutex_, removals_);
+			removals_.setListener(std::move(listener));
+		}
+
+		size_t target() { // 当前T1的目标大小，调试和观察自适应效果用
+			Lock lock(mutex_, removals_);
+			return p_;
+		}
+
+	private:
+		template<typename V>
+		void putInternal(const Key& key, V&& value) {
+			if (capacity_ <= 0)return;
+
+			Lock lock(mutex_, removals_);
+			uint64_t h = nodeMap_.hash(key);
+			NodePtr* it = nodeMap_.find(key, h);
+			if (it == nullptr) {
+				addNode(key, h, std::forward<V>(value));
+				return;
+			}
+
+			NodePtr node = *it;
+			if (isResident(node)) { // 情况1：命中T1/T2，更新值并提升到T2
+				node->value = std::forward<V>(value);
+				moveTo(node, kT2);
+				return;
+			}
+
+			size_t c = static_cast<size_t>(capacity_);
+			size_t b1 = lists_[kB1].size, b2 = lists_[kB2].size;
+			bool inB2 = node->list == kB2;
+			if (!inB2) { // 情况2：命中B1，T1的份额加大
+				p_ = std::min(c, p_ + std::max<size_t>(b2 / b1, 1));
+			}
+			else { // 情况3：命中B2，T2的份额加大
+				size_t delta = std::max<size_t>(b1 / b2, 1);
+				p_ = p_ > delta ? p_ - delta : 0;
+			}
+			unlink(node); // 先摘下来，replace不会把自己挑走
+			if (residentSize() >= c)
+				replace(inB2);
+			node->value = std::forward<V>(value);
+			linkFront(node, kT2);
+		}
+
+		template<typename K>
+		bool getInternal(const K& key, Value& value) {
+			Lock lock(mutex_, removals_);
+			NodePtr* it = nodeMap_.find(key);
+			if (it == nullptr || !isResident(*it)) // 命中幽灵key没有value可返回，等调用方回源后put时再做自适应
+				return false;
+			NodePtr node = *it;
+			moveTo(node, kT2);
+			value = node->value;
+			return true;
+		}
+
+		template<typename V>
+		void addNode(const Key& key, uint64_t h, V&& value) { // 情况4：完全没见过的key
+			size_t c = static_cast<size_t>(capacity_);
+			size_t t1b1 = lists_[kT1].size + lists_[kB1].size;
+			if (t1b1 >= c) {
+				if (lists_[kT1].size < c) {
+					dropLeastRecent(kB1);
+					if (residentSize() >= c)
+						replace(false);
+				}
+				else { // B1为空且T1满，T1最久的直接丢掉，不进幽灵表
+					dropLeastRecent(kT1);
+				}
+			}
+			else {
+				size_t total = t1b1 + lists_[kT2].size + lists_[kB2].size;
+				if (total >= c) {
+					if (total >= 2 * c)
+						dropLeastRecent(kB2);
+					if (residentSize() >= c)
+						replace(false);
+				}
+			}
+
+			NodePtr node = nodePool_.allocate(key, std::forward<V>(value));
+			linkFront(node, kT1);
+			nodeMap_.emplace(key, node, h);
+		}
+
+		// 从T1或T2淘汰一个实体到对应的幽灵表：T1超过目标大小（命中B2时等于也算）就淘汰T1，否则淘汰T2
+		void replace(bool hitB2) {
+			size_t t1 = lists_[kT1].size;
+			if (t1 > 0 && (t1 > p_ || (hitB2 && t1 == p_) || lists_[kT2].size == 0)) {
+				demote(kT1, kB1);
+			}
+			else {
+				demote(kT2, kB2);
+			}
+		}
+
+		void demote(uint8_t from, uint8_t ghost) {
+			NodePtr node = lists_[from].head.prev;
+			unlink(node);
+			if (removals_.active())
+				removals_.push(node->key, std::move(node->value), MyRemovalCause::kEvicted);
+			node->value = Value(); // 幽灵只留key，value的内存立刻释放
+			linkFront(node, ghost);
+		}
+
+		void dropLeastRecent(uint8_t id) {
+			List& list = lists_[id];
+			if (list.size == 0)
+				return;
+			NodePtr node = list.head.prev;
+			unlink(node);
+			if (isResident(node))
+				removals_.push(node->key, std::move(node->value), MyRemovalCause::kEvicted);
+			nodeMap_.erase(node->key);
+			nodePool_.deallocate(node);
+		}
+
+		size_t residentSize() const {
+			return lists_[kT1].size + lists_[kT2].size;
+		}
+
+		static bool isResident(NodePtr node) {
+			return node->list == kT1 || node->list == kT2;
+		}
+
+		void moveTo(NodePtr node, uint8_t id) {
+			unlink(node);
+			linkFront(node, id);
+		}
+
+		void unlink(NodePtr node) {
+			node->prev->next = node->next;
+			node->next->prev = node->prev;
+			lists_[node->list].size--;
+		}
+
+		void linkFront(NodePtr node, uint8_t id) {
+			List& list = lists_[id];
+			node->list = id;
+			node->prev = &list.head;
+			node->next = list.head.next;
+			list.head.next->prev = node;
+			list.head.next = node;
+			list.size++;
+		}
+
+		void clearList(List& list) { // 池不负责析构节点，逐个归还
+			NodePtr node = list.head.next;
+			while (node != &list.head) {
+				NodePtr next = node->next;
+				nodePool_.deallocate(node);
+				node = next;
+			}
+			list.head.next = list.head.prev = &list.head;
+			list.size = 0;
+		}
+	};
+
+}
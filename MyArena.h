@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace MyCache {
+
+	// 一整块匿名内存：构造时一次性向系统申请，内容全为0，析构时整块归还，中间不再有任何分配。
+	// hugePages为true时优先用2MB大页（Linux先试MAP_HUGETLB，系统没有预留大页时退回普通页并用madvise请求透明大页），
+	// 百万级条目的数组能少占几百个TLB项；Windows的大页需要额外权限，这里只做普通的VirtualAlloc
+	class MyArena {
+	private:
+		static constexpr size_t kHugePageSize = 2u << 20;
+
+		void*  data_;
+		size_t size_;
+		bool   hugePages_; // 是否真的拿到了MAP_HUGETLB大页
+
+	public:
+		explicit MyArena(size_t bytes, bool hugePages = false) :data_(nullptr), size_(0), hugePages_(false) {
+			if (bytes == 0)
+				return;
+#if defined(_WIN32)
+			(void)hugePages;
+			data_ = ::VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if (data_ == nullptr)
+				throw std::bad_alloc();
+			size_ = bytes;
+#else
+			if (hugePages && bytes >= kHugePageSize) {
+				size_t rounded = (bytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+#ifdef MAP_HUGETLB
+				void* p = ::mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+				if (p != MAP_FAILED) {
+					data_ = p;
+					size_ = rounded;
+					hugePages_ = true;
+					return;
+				}
+#endif
+				bytes = rounded; // 按大页对齐申请，透明大页才能整页覆盖
+			}
+			void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED)
+				throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+			if (hugePages)
+				::madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+			data_ = p;
+			size_ = bytes;
+#endif
+		}
+
+		~MyArena() {
+			if (data_ == nullptr)
+				return;
+#if defined(_WIN32)
+			::VirtualFree(data_, 0, MEM_RELEASE);
+#else
+			::munmap(data_, size_);
+#endif
+		}
+
+		MyArena(const MyArena&) = delete;
+		MyArena& operator=(const MyArena&) = delete;
+
+		void* data() const { return data_; }
+		size_t size() const { return size_; }
+		bool hugePages() const { return hugePages_; }
+	};
+
+}
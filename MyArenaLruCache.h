@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+#include "MyArena.h"
+#include "MyCachePolicy.h"
+#include "MyCacheStats.h"
+#include "MyFlatIndex.h"
+#include "MyLruCache.h"
+#include "MyRemovalQueue.h"
+
+namespace MyCache {
+
+	// 可平凡拷贝的Key/Value专用的LRU：条目不再是一个个节点，而是槽位下标，key、value、链表下标分别放在三个连续数组里(SoA)，
+	// 三个数组在构造时从一块MyArena里切出来，之后没有任何分配。
+	// 每个条目的额外开销是8字节的前后下标，加上索引里的1字节控制字节和4字节槽位号（索引里另存一份key）；
+	// 链表操作只碰下标数组，命中时才读value数组，淘汰从最久未使用端顺序取槽位直接复用。
+	// 容量固定，不支持weigher和ttl，需要这些功能或Value不可平凡拷贝时用MyLruCache
+	template<typename Key, typename Value, template<typename...> class Index = MyFlatIndex>
+	class MyArenaLruCache :public MyCachePolicy<Key, Value> {
+		static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+			"MyArenaLruCache只能存可平凡拷贝的Key和Value");
+
+	private:
+		using Slot = uint32_t;
+		using Lock = MyNotifyingLock<std::mutex, Key, Value>;
+
+		struct Link {
+			Slot prev;
+			Slot next;
+		};
+
+		static constexpr Slot kSentinel = 0; // 第0个槽位是哨兵：links_[0].next是最近使用端，links_[0].prev是最久未使用端
+
+		int                   capacity_;
+		size_t                used_; // 1..used_是分配过的槽位
+		Slot                  freeHead_; // erase空出来的槽位经links_[].next串成的空闲链，kSentinel表示没有
+		MyArena               arena_;
+		Link*                 links_;
+		Key*                  keys_;
+		Value*                values_;
+		Index<Key, Slot>      nodeMap_;
+		std::mutex            mutex_;
+		MyStatsCounter        stats_;
+		MyRemovalQueue<Key, Value> removals_;
+
+	public:
+		// hugePages为true时数组所在的内存优先用大页
+		explicit MyArenaLruCache(int capacity, bool hugePages = false)
+			:capacity_(capacity > 0 ? capacity : 0), used_(0), freeHead_(kSentinel),
+			arena_(arenaBytes(capacity > 0 ? static_cast<size_t>(capacity) + 1 : 0), hugePages),
+			links_(nullptr), keys_(nullptr), values_(nullptr),
+			nodeMap_(capacity > 0 ? static_cast<size_t>(capacity) : 0) {
+			if (capacity_ <= 0)
+				return;
+			size_t slots = static_cast<size_t>(capacity_) + 1;
+			char* base = static_cast<char*>(arena_.data());
+			links_ = ::new (base) Link[slots];
+			keys_ = reinterpret_cast<Key*>(base + keysOffset(slots));
+			values_ = reinterpret_cast<Value*>(base + valuesOffset(slots));
+			links_[kSentinel].prev = links_[kSentinel].next = kSentinel;
+		}
+
+		~MyArenaLruCache() override = default; // 元素都可平凡析构，arena整块归还即可
+
+		void put(const Key& key, const Value& value) override {
+			if (capacity_ <= 0)return;
+
+			Lock lock(mutex_, stats_, removals_);
+			putLocked(key, nodeMap_.hash(key), value);
+		}
+
+		void put(const Key& key, Value&& value) override {
+			put(key, static_cast<const Value&>(value)); // 可平凡拷贝，移动和拷贝没有区别
+		}
+
+		Value get(const Key& key) override {
+			Value value{};
+			get(key, value);
+			return value;
+		}
+
+		bool get(const Key& key, Value& value) override {
+			Lock lock(mutex_, stats_, removals_);
+			Slot* it = nodeMap_.find(key);
+			if (it == nullptr) {
+				stats_.miss();
+				return false;
+			}
+			moveToFront(*it);
+			value = values_[*it];
+			stats_.hit();
+			return true;
+		}
+
+		// 批量读：整批只加一次锁，每kBatchChunk个key先算hash并预取索引，再依次探测
+		size_t getMany(const Key* keys, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) override {
+			size_t hitCount = 0;
+			uint64_t hashes[detail::kBatchChunk];
+			Lock lock(mutex_, stats_, removals_);
+			for (size_t base = 0; base < count; base += detail::kBatchChunk) {
+				size_t n = std::min(detail::kBatchChunk, count - base);
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = nodeMap_.hash(keys[detail::batchIndex(indices, base + i)]);
+					nodeMap_.prefetch(hashes[i]);
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t idx = detail::batchIndex(indices, base + i);
+					Slot* it = nodeMap_.find(keys[idx], hashes[i]);
+					hits[idx] = it != nullptr;
+					if (it != nullptr) {
+						moveToFront(*it);
+						values[idx] = values_[*it];
+						hitCount++;
+					}
+				}
+			}
+			stats_.hit(hitCount);
+			stats_.miss(count - hitCount);
+			return hitCount;
+		}
+
+		void putMany(const Key* keys, const Value* values, size_t count, const uint32_t* indices = nullptr) override {
+			if (capacity_ <= 0)return;
+
+			uint64_t hashes[detail::kBatchChunk];
+			Lock lock(mutex_, stats_, removals_);
+			for (size_t base = 0; base < count; base += detail::kBatchChunk) {
+				size_t n = std::min(detail::kBatchChunk, count - base);
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = nodeMap_.hash(keys[detail::batchIndex(indices, base + i)]);
+					nodeMap_.prefetch(hashes[i]);
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t idx = detail::batchIndex(indices, base + i);
+					putLocked(keys[idx], hashes[i], values[idx]);
+				}
+			}
+		}
+
+		bool contains(const Key& key) override { // 只查不动链表，不算一次访问
+			Lock lock(mutex_, stats_, removals_);
+			return nodeMap_.find(key) != nullptr;
+		}
+
+		bool peek(const Key& key, Value& value) { // 读值但不提升到最近使用
+			Lock lock(mutex_, stats_, removals_);
+			Slot* it = nodeMap_.find(key);
+			if (it == nullptr)
+				return false;
+			value = values_[*it];
+			return true;
+		}
+
+		bool erase(const Key& key) override {
+			Lock lock(mutex_, stats_, removals_);
+			uint64_t h = nodeMap_.hash(key);
+			Slot* it = nodeMap_.find(key, h);
+			if (it == nullptr)
+				return false;
+			Slot slot = *it;
+			nodeMap_.erase(key, h);
+			unlink(slot);
+			removals_.push(keys_[slot], Value(values_[slot]), MyRemovalCause::kExplicit);
+			links_[slot].next = freeHead_;
+			freeHead_ = slot;
+			return true;
+		}
+
+		void clear() override {
+			Lock lock(mutex_, stats_, removals_);
+			if (removals_.active()) {
+				for (Slot slot = links_[kSentinel].next; slot != kSentinel; slot = links_[slot].next) {
+					removals_.push(keys_[slot], Value(values_[slot]), MyRemovalCause::kExplicit);
+				}
+			}
+			nodeMap_.clear();
+			if (capacity_ > 0)
+				links_[kSentinel].prev = links_[kSentinel].next = kSentinel;
+			used_ = 0;
+			freeHead_ = kSentinel;
+		}
+
+		size_t size() override {
+			Lock lock(mutex_, stats_, removals_);
+			return nodeMap_.size();
+		}
+
+		// 条目被淘汰或删除时的回调，在解锁后调用
+		void setEvictionListener(MyEvictionListener<Key, Value> listener) {
+			Lock lock(mutex_, stats_, removals_);
+			removals_.setListener(std::move(listener));
+		}
+
+		bool hugePages() const { return arena_.hugePages(); }
+
+		MyCacheStats stats() const { // 不加锁
+			return stats_.snapshot();
+		}
+
+	private:
+		static size_t alignUp(size_t n, size_t align) { return (n + align - 1) / align * align; }
+
+		static size_t keysOffset(size_t slots) { return alignUp(sizeof(Link) * slots, alignof(Key)); }
+
+		static size_t valuesOffset(size_t slots) { return alignUp(keysOffset(slots) + sizeof(Key) * slots, alignof(Value)); }
+
+		static size_t arenaBytes(size_t slots) {
+			static_assert(alignof(Key) <= 4096 && alignof(Value) <= 4096, "arena按页对齐");
+			return slots == 0 ? 0 : valuesOffset(slots) + sizeof(Value) * slots;
+		}
+
+		void putLocked(const Key& key, uint64_t h, const Value& value) { // 调用方持有mutex_
+			stats_.put();
+			Slot* it = nodeMap_.find(key, h);
+			if (it != nullptr) {
+				values_[*it] = value;
+				moveToFront(*it);
+				return;
+			}
+
+			Slot slot;
+			if (freeHead_ != kSentinel) {
+				slot = freeHead_;
+				freeHead_ = links_[slot].next;
+			}
+			else if (used_ < static_cast<size_t>(capacity_)) {
+				slot = static_cast<Slot>(++used_);
+			}
+			else { // 满了：最久未使用的槽位原地复用
+				slot = links_[kSentinel].prev;
+				unlink(slot);
+				nodeMap_.erase(keys_[slot]);
+				removals_.push(keys_[slot], Value(values_[slot]), MyRemovalCause::kEvicted);
+				stats_.eviction();
+			}
+			::new (static_cast<void*>(keys_ + slot)) Key(key);
+			::new (static_cast<void*>(values_ + slot)) Value(value);
+			linkFront(slot);
+			nodeMap_.emplace(key, slot, h);
+		}
+
+		void moveToFront(Slot slot) {
+			if (links_[kSentinel].next == slot)
+				return; // 已在最近使用端，省掉四次写
+			unlink(slot);
+			linkFront(slot);
+		}
+
+		void unlink(Slot slot) {
+			Link& link = links_[slot];
+			links_[link.prev].next = link.next;
+			links_[link.next].prev = link.prev;
+		}
+
+		void linkFront(Slot slot) {
+			Slot first = links_[kSentinel].next;
+			links_[slot].prev = kSentinel;
+			links_[slot].next = first;
+			links_[first].prev = slot;
+			links_[kSentinel].next = slot;
+		}
+	};
+
+	// 按Key/Value类型选LRU实现：都可平凡拷贝时用MyArenaLruCache，否则用MyLruCache
+	template<typename Key, typename Value, template<typename...> class Index = MyFlatIndex>
+	using MyLruCacheFor = std::conditional_t<std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+		MyArenaLruCache<Key, Value, Index>, MyLruCache<Key, Value, Index>>;
+
+}
@@ -0,0 +1,472 @@
+#pragma once
+
+// 协程接口需要C++20；C++17下这个头文件是空的，不影响其他头文件
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "MyCachePolicy.h"
+#include "MyCacheStats.h"
+#include "MyHash.h"
+#include "MyShardedCache.h"
+
+namespace MyCache {
+
+	// 最简单的惰性协程任务：被co_await时才开始执行，结束时直接切回等待方（对称转移，不会越递归越深）。
+	// 只有一个等待方，结果取走一次；T不能是void
+	template<typename T>
+	class MyTask {
+	public:
+		struct promise_type {
+			std::optional<T>        value;
+			std::exception_ptr      error;
+			std::coroutine_handle<> continuation = std::noop_coroutine();
+
+			struct FinalAwaiter {
+				bool await_ready() noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept { return handle.promise().continuation; }
+				void await_resume() noexcept {}
+			};
+
+			MyTask get_return_object() { return MyTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			FinalAwaiter final_suspend() noexcept { return {}; }
+			void return_value(T result) { value.emplace(std::move(result)); }
+			void unhandled_exception() { error = std::current_exception(); }
+		};
+
+		MyTask(MyTask&& other) noexcept :handle_(std::exchange(other.handle_, {})) {}
+		MyTask& operator=(MyTask&& other) noexcept {
+			if (this != &other) {
+				if (handle_) handle_.destroy();
+				handle_ = std::exchange(other.handle_, {});
+			}
+			return *this;
+		}
+		~MyTask() {
+			if (handle_) handle_.destroy();
+		}
+
+		bool await_ready() const noexcept { return handle_.done(); }
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+			handle_.promise().continuation = awaiting;
+			return handle_;
+		}
+
+		T await_resume() {
+			promise_type& promise = handle_.promise();
+			if (promise.error)
+				std::rethrow_exception(promise.error);
+			return std::move(*promise.value);
+		}
+
+	private:
+		explicit MyTask(std::coroutine_handle<promise_type> handle) :handle_(handle) {}
+
+		std::coroutine_handle<promise_type> handle_;
+	};
+
+	struct MyAsyncStats {
+		uint64_t immediate = 0; // 第一次try_lock就拿到锁、没有挂起就完成的操作数
+		uint64_t suspended = 0; // try_lock失败、转去分片等待队列的操作数（包括正好自己成了清队线程的）
+		uint64_t loads = 0; // getOrLoadAsync调用loader的次数
+		uint64_t coalesced = 0; // getOrLoadAsync未命中时等在别人的加载上的次数
+	};
+
+	// MyShardedCache的协程前端：co_await getAsync/putAsync/eraseAsync/getOrLoadAsync。
+	// 每次操作先用非阻塞的try*Hashed试分片的锁，拿到就当场完成、不挂起；锁被占用时协程挂到这个分片的等待队列上，线程回去跑别的协程。
+	// 每个分片同一时刻最多一个“清队线程”：它阻塞等分片的锁，把队列里攒下的操作逐个做完再依次恢复对应的协程，
+	// 所以并发再高，每个分片也只有一个线程会卡在锁上。队列自己的mutex只保护几次指针操作，不会在持有它时碰分片的锁。
+	// 被排队的协程默认在清队线程上直接恢复；传入executor时交给它恢复（例如投递回自己的事件循环）。
+	// Policy需要提供tryGetHashed/tryPutHashed/tryEraseHashed以及对应的阻塞*Hashed接口（MyLruCache、MyLfuCache系列）。
+	// 不持有缓存；key按引用保存在等待体里，co_await完成之前必须保持有效
+	template<typename Key, typename Value, typename Policy, typename Hash = typename detail::policyHasher<Policy, Key>::type>
+	class MyAsyncCache {
+	public:
+		using Cache = MyShardedCache<Key, Value, Policy, Hash>;
+		using Executor = std::function<void(std::coroutine_handle<>)>;
+
+	private:
+		struct Op { // 排在分片队列里的一次操作，就是挂起协程帧里的等待体本身，入队不分配内存
+			Op*                     next = nullptr;
+			std::coroutine_handle<> handle;
+			std::exception_ptr      error; // run()抛出的异常，恢复后由await_resume抛给这个协程
+
+			virtual void run() = 0; // 清队线程调用，阻塞等锁
+
+			void runCaught() noexcept { // 一个操作失败不能打断清队，否则draining复位不了、后面排队的协程永远等不到恢复
+				try {
+					run();
+				}
+				catch (...) {
+					error = std::current_exception();
+				}
+			}
+
+		protected:
+			~Op() = default;
+		};
+
+		struct alignas(kCacheLineSize) Gate {
+			std::mutex mutex; // 只保护下面三个字段
+			Op*        head = nullptr;
+			Op*        tail = nullptr;
+			bool       draining = false;
+		};
+
+		struct Flight { // 一次正在进行的getOrLoadAsync加载
+			std::mutex                           mutex;
+			bool                                 done = false;
+			std::optional<Value>                 value;
+			std::exception_ptr                   error;
+			std::vector<std::coroutine_handle<>> waiters;
+		};
+
+		struct alignas(kCacheLineSize) Stripe {
+			std::mutex                                               mutex;
+			std::unordered_map<Key, std::shared_ptr<Flight>, Hash>   inflight;
+		};
+
+		static constexpr size_t kStripeNum = 16;
+
+		Cache&                    cache_;
+		Executor                  executor_;
+		std::unique_ptr<Gate[]>   gates_; // 和cache_.shard(i)一一对应
+		std::unique_ptr<Stripe[]> stripes_;
+
+		std::atomic<uint64_t>     immediate_{ 0 };
+		std::atomic<uint64_t>     suspended_{ 0 };
+		std::atomic<uint64_t>     loads_{ 0 };
+		std::atomic<uint64_t>     coalesced_{ 0 };
+
+		template<typename Derived>
+		class Awaiter :public Op { // 三种操作共用的挂起逻辑，Derived提供tryRun()/run()
+		public:
+			bool await_ready() {
+				if (static_cast<Derived*>(this)->tryRun()) {
+					owner_.immediate_.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+				return false;
+			}
+
+			bool await_suspend(std::coroutine_handle<> awaiting) {
+				this->handle = awaiting;
+				return owner_.enqueue(this, slot_);
+			}
+
+		protected:
+			Awaiter(MyAsyncCache& owner, const Key& key) :owner_(owner), key_(key) {
+				uint64_t h = owner.cache_.keyHash(key);
+				index_ = owner.cache_.shardOf(h);
+				hash_ = Cache::passesHash() ? h : owner.cache_.shard(index_).keyHash(key);
+			}
+
+			Policy& shardAt(size_t replica) { return owner_.cache_.shard(replica * owner_.cache_.shardNum() + index_); }
+
+			void rethrowError() {
+				if (this->error)
+					std::rethrow_exception(this->error);
+			}
+
+			MyAsyncCache& owner_;
+			const Key&    key_;
+			uint64_t      hash_;
+			size_t        index_; // 每套副本里的分片下标
+			size_t        slot_ = 0; // 排队的那个分片在cache_.shard()里的下标
+		};
+
+		class GetAwaiter :public Awaiter<GetAwaiter> {
+		public:
+			GetAwaiter(MyAsyncCache& owner, const Key& key) :Awaiter<GetAwaiter>(owner, key) {
+				replica_ = owner.cache_.localReplica();
+				this->slot_ = replica_ * owner.cache_.shardNum() + this->index_;
+			}
+
+			bool tryRun() {
+				Value value{};
+				MyTryResult result = this->shardAt(replica_).tryGetHashed(this->key_, this->hash_, value);
+				if (result == MyTryResult::kBusy)
+					return false;
+				if (result == MyTryResult::kHit)
+					result_.emplace(std::move(value));
+				return true;
+			}
+
+			void run() override {
+				Value value{};
+				if (this->shardAt(replica_).getHashed(this->key_, this->hash_, value))
+					result_.emplace(std::move(value));
+			}
+
+			std::optional<Value> await_resume() {
+				this->rethrowError();
+				return std::move(result_);
+			}
+
+		private:
+			size_t               replica_;
+			std::optional<Value> result_;
+		};
+
+		// 多套副本（kReplicated）时写入要在各副本上按同样的顺序应用，这由MyShardedCache每个分片下标一把的顺序锁保证，
+		// 所以不走try-lock快路径，直接排进第0套副本那个分片的队列，清队时调用cache_.put/erase一次写完所有副本
+		class PutAwaiter :public Awaiter<PutAwaiter> {
+		public:
+			PutAwaiter(MyAsyncCache& owner, const Key& key, Value value) :Awaiter<PutAwaiter>(owner, key), value_(std::move(value)) {}
+
+			bool tryRun() { // 拿不到锁时value_原样留着，清队时再写
+				this->slot_ = this->index_;
+				if (this->owner_.cache_.replicaNum() > 1)
+					return false;
+				return this->shardAt(0).tryPutHashed(this->key_, this->hash_, std::move(value_));
+			}
+
+			void run() override {
+				if (this->owner_.cache_.replicaNum() > 1)
+					this->owner_.cache_.put(this->key_, std::move(value_));
+				else
+					this->shardAt(0).putHashed(this->key_, this->hash_, std::move(value_));
+			}
+
+			void await_resume() { this->rethrowError(); }
+
+		private:
+			Value value_;
+		};
+
+		class EraseAwaiter :public Awaiter<EraseAwaiter> {
+		public:
+			EraseAwaiter(MyAsyncCache& owner, const Key& key) :Awaiter<EraseAwaiter>(owner, key) {}
+
+			bool tryRun() {
+				this->slot_ = this->index_;
+				if (this->owner_.cache_.replicaNum() > 1)
+					return false;
+				MyTryResult result = this->shardAt(0).tryEraseHashed(this->key_, this->hash_);
+				erased_ = result == MyTryResult::kHit;
+				return result != MyTryResult::kBusy;
+			}
+
+			void run() override {
+				if (this->owner_.cache_.replicaNum() > 1)
+					erased_ = this->owner_.cache_.erase(this->key_);
+				else
+					erased_ = this->shardAt(0).eraseHashed(this->key_, this->hash_);
+			}
+
+			bool await_resume() {
+				this->rethrowError();
+				return erased_;
+			}
+
+		private:
+			bool erased_ = false;
+		};
+
+		class FlightAwaiter {
+		public:
+			explicit FlightAwaiter(Flight& flight) :flight_(flight) {}
+
+			bool await_ready() {
+				std::lock_guard<std::mutex> lock(flight_.mutex);
+				return flight_.done;
+			}
+
+			bool await_suspend(std::coroutine_handle<> handle) {
+				std::lock_guard<std::mutex> lock(flight_.mutex);
+				if (flight_.done) // 检查和挂起之间加载刚好完成
+					return false;
+				flight_.waiters.push_back(handle);
+				return true;
+			}
+
+			void await_resume() {}
+
+		private:
+			Flight& flight_;
+		};
+
+	public:
+		// executor为空时，排过队的协程在清队线程上直接恢复；executor不能抛异常
+		explicit MyAsyncCache(Cache& cache, Executor executor = nullptr)
+			:cache_(cache), executor_(std::move(executor)), gates_(new Gate[cache.shardNum() * cache.replicaNum()]), stripes_(new Stripe[kStripeNum]) {}
+
+		MyAsyncCache(const MyAsyncCache&) = delete;
+		MyAsyncCache& operator=(const MyAsyncCache&) = delete;
+
+		// co_await的结果：命中时是值，未命中是nullopt
+		GetAwaiter getAsync(const Key& key) { return GetAwaiter(*this, key); }
+
+		PutAwaiter putAsync(const Key& key, Value value) { return PutAwaiter(*this, key, std::move(value)); }
+
+		// co_await的结果：是否删掉了条目
+		EraseAwaiter eraseAsync(const Key& key) { return EraseAwaiter(*this, key); }
+
+		// 命中直接返回；未命中由loader(key)加载并写入缓存，loader可以返回Value，也可以返回能co_await出Value的对象（例如MyTask<Value>）。
+		// 同一个key并发未命中时只有第一个请求调用loader，其余的挂起等它的结果；loader的异常抛给这一轮所有等待的请求，不写缓存。
+		// key和loader按值保存在协程帧里
+		template<typename Loader>
+		MyTask<Value> getOrLoadAsync(Key key, Loader loader) {
+			if (std::optional<Value> hit = co_await getAsync(key))
+				co_return std::move(*hit);
+
+			Stripe& stripe = stripeFor(key);
+			std::shared_ptr<Flight> flight;
+			bool leader = false;
+			{
+				std::lock_guard<std::mutex> lock(stripe.mutex);
+				auto it = stripe.inflight.find(key);
+				if (it != stripe.inflight.end()) {
+					flight = it->second;
+				}
+				else {
+					flight = std::make_shared<Flight>();
+					stripe.inflight.emplace(key, flight);
+					leader = true;
+				}
+			}
+			if (!leader) {
+				coalesced_.fetch_add(1, std::memory_order_relaxed);
+				co_await FlightAwaiter(*flight);
+				if (flight->error)
+					std::rethrow_exception(flight->error);
+				co_return *flight->value;
+			}
+
+			std::optional<Value> loaded;
+			try { // 锁外未命中之后上一轮加载可能刚好写完缓存、撤掉了inflight，登记之后再查一次，命中就不再回源
+				loaded = co_await getAsync(key);
+			}
+			catch (...) {
+				finishLoad(stripe, key, *flight, std::nullopt, std::current_exception());
+				throw;
+			}
+			if (loaded) {
+				finishLoad(stripe, key, *flight, *loaded, nullptr);
+				co_return std::move(*loaded);
+			}
+
+			loads_.fetch_add(1, std::memory_order_relaxed);
+			try {
+				if constexpr (std::is_convertible_v<std::invoke_result_t<Loader&, const Key&>, Value>)
+					loaded.emplace(loader(static_cast<const Key&>(key)));
+				else
+					loaded.emplace(co_await loader(static_cast<const Key&>(key)));
+			}
+			catch (...) {
+				finishLoad(stripe, key, *flight, std::nullopt, std::current_exception());
+				throw;
+			}
+			try {
+				co_await putAsync(key, *loaded); // 先写缓存再撤掉inflight，中间到来的请求要么等在flight上、要么直接命中
+			}
+			catch (...) { // 写缓存失败时加载结果照样交给等待的请求，异常只抛给发起加载的这一个
+				finishLoad(stripe, key, *flight, *loaded, nullptr);
+				throw;
+			}
+			finishLoad(stripe, key, *flight, *loaded, nullptr);
+			co_return std::move(*loaded);
+		}
+
+		MyAsyncStats stats() const {
+			MyAsyncStats stats;
+			stats.immediate = immediate_.load(std::memory_order_relaxed);
+			stats.suspended = suspended_.load(std::memory_order_relaxed);
+			stats.loads = loads_.load(std::memory_order_relaxed);
+			stats.coalesced = coalesced_.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		Cache& cache() { return cache_; }
+
+	private:
+		// 返回true表示协程已经挂在队列上；返回false表示当前线程成了清队线程，自己的操作和队列都已经做完，协程接着往下跑
+		bool enqueue(Op* op, size_t slot) {
+			Gate& gate = gates_[slot];
+			suspended_.fetch_add(1, std::memory_order_relaxed);
+			{
+				std::lock_guard<std::mutex> lock(gate.mutex);
+				if (gate.draining) {
+					op->next = nullptr;
+					if (gate.tail) gate.tail->next = op;
+					else gate.head = op;
+					gate.tail = op;
+					return true;
+				}
+				gate.draining = true;
+			}
+			op->runCaught();
+			drain(gate);
+			return false;
+		}
+
+		// 一批操作先全部做完再逐个恢复：恢复出来的协程如果又访问这个分片，只会排进下一批，不会在这里递归。
+		// 恢复之后等待体可能已经随协程帧销毁，next要先读出来
+		void drain(Gate& gate) {
+			for (;;) {
+				Op* batch;
+				{
+					std::lock_guard<std::mutex> lock(gate.mutex);
+					batch = gate.head;
+					gate.head = gate.tail = nullptr;
+					if (!batch) {
+						gate.draining = false;
+						return;
+					}
+				}
+				for (Op* op = batch; op; op = op->next) {
+					op->runCaught();
+				}
+				for (Op* op = batch; op;) {
+					Op* next = op->next;
+					resume(op->handle);
+					op = next;
+				}
+			}
+		}
+
+		void resume(std::coroutine_handle<> handle) {
+			if (executor_) executor_(handle);
+			else handle.resume();
+		}
+
+		Stripe& stripeFor(const Key& key) { // 取hash的高位，和分片、索引用的位错开
+			return stripes_[static_cast<size_t>(cache_.keyHash(key) >> 40) & (kStripeNum - 1)];
+		}
+
+		void finishLoad(Stripe& stripe, const Key& key, Flight& flight, std::optional<Value> value, std::exception_ptr error) {
+			{
+				std::lock_guard<std::mutex> lock(stripe.mutex);
+				stripe.inflight.erase(key);
+			}
+			std::vector<std::coroutine_handle<>> waiters;
+			{
+				std::lock_guard<std::mutex> lock(flight.mutex);
+				flight.done = true;
+				flight.value = std::move(value);
+				flight.error = error;
+				waiters.swap(flight.waiters);
+			}
+			for (std::coroutine_handle<> waiter : waiters) {
+				resume(waiter);
+			}
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,596 @@
+﻿// MyCacheBench.cpp : 吞吐/延迟基准，独立的main，和TestCache.cpp（命中率）分开编译。
+//
+// 每个策略 x 每种key分布 x 每种value大小，依次用1、2、4...N个线程跑同样的负载，
+// 输出ops/sec、命中率和p50/p99/p999/max延迟，用来画扩展曲线。
+//
+// 用法: MyCacheBench [--threads=N] [--ops=每线程操作数] [--read=读比例%] [--capacity=容量] [--keys=key空间]
+//                    [--dist=zipf,uniform,scan,hotcold,shift] [--zipf=theta] [--value-size=16,256]
+//                    [--trace=MyTraceRecorder录下的轨迹文件] [--help]
+//                    [--policy=lru,lrubuf,lru+l0,lru+lz,lfu,lfubuf,klru,slru,arc,tinylfu,clock,static-lru,arc+tinylfu,hashlru,hashlru-numa,hashlru-replica,shardedlfu,shardedclock] [--sample=每隔几次计一次延迟] [--csv]
+// 读操作未命中时会回填一次put（cache-aside），算作同一次操作。
+// 给了--trace时不再生成分布，改为回放录下的轨迹：key的hash当作key，get/put/erase/clear照原样执行，未命中不再回填（应用自己的回填已经作为put录下了），
+// 按记录线程的编号分给各个回放线程；轨迹是采样录的，容量按采样比例缩小；没给--value-size时value取轨迹里put的平均大小
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MyArcCache.h"
+#include "MyCachePolicy.h"
+#include "MyCacheTrace.h"
+#include "MyClockCache.h"
+#include "MyComposedCache.h"
+#include "MyCompressedCache.h"
+#include "MyFrontCache.h"
+#include "MyLfuCache.h"
+#include "MyLruCache.h"
+#include "MyShardedCache.h"
+#include "MySlruCache.h"
+#include "MyTinyLfuCache.h"
+
+namespace {
+
+    using BenchCache = MyCache::MyCachePolicy<int, std::string>;
+    using Clock = std::chrono::steady_clock;
+
+    // 对数线性直方图（HDR风格）：0~63ns逐个计数，之后每个[2^k, 2^(k+1))区间等分64份，相对误差不超过1/64。
+    // 每个线程各记一份，结束后合并，记录路径上没有任何共享写
+    class LatencyHistogram {
+    public:
+        static constexpr int kSubBits = 6;
+        static constexpr uint64_t kSubCount = 1ULL << kSubBits;
+
+        LatencyHistogram() : counts_(kSubCount + (64 - kSubBits) * kSubCount, 0), total_(0), max_(0) {}
+
+        void record(uint64_t ns) {
+            counts_[indexOf(ns)]++;
+            total_++;
+            if (ns > max_) max_ = ns;
+        }
+
+        void merge(const LatencyHistogram& other) {
+            for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+            total_ += other.total_;
+            max_ = std::max(max_, other.max_);
+        }
+
+        // 返回第p分位所在桶的上界
+        uint64_t percentile(double p) const {
+            if (total_ == 0) return 0;
+            uint64_t rank = static_cast<uint64_t>(std::ceil(p * static_cast<double>(total_)));
+            if (rank == 0) rank = 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < counts_.size(); ++i) {
+                seen += counts_[i];
+                if (seen >= rank) return std::min(upperBound(i), max_);
+            }
+            return max_;
+        }
+
+        uint64_t max() const { return max_; }
+
+    private:
+        static size_t indexOf(uint64_t v) {
+            if (v < kSubCount) return static_cast<size_t>(v);
+            int k = kSubBits;
+            while ((v >> (k + 1)) != 0) ++k; // k为最高位
+            uint64_t sub = (v >> (k - kSubBits)) - kSubCount;
+            return static_cast<size_t>(kSubCount + (k - kSubBits) * kSubCount + sub);
+        }
+
+        static uint64_t upperBound(size_t index) {
+            if (index < kSubCount) return index;
+            size_t k = (index - kSubCount) / kSubCount + kSubBits;
+            uint64_t sub = (index - kSubCount) % kSubCount;
+            return ((kSubCount + sub + 1) << (k - kSubBits)) - 1;
+        }
+
+        std::vector<uint64_t> counts_;
+        uint64_t              total_;
+        uint64_t              max_;
+    };
+
+    enum class Distribution { Zipf, Uniform, Scan, HotCold, Shift };
+
+    struct BenchConfig {
+        int                       maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        size_t                    opsPerThread = 1000000;
+        int                       readPercent = 90;
+        int                       capacity = 10000;
+        int                       keySpace = 100000;
+        double                    zipfTheta = 0.99;
+        int                       sampleEvery = 1;
+        bool                      csv = false;
+        bool                      help = false;
+        std::vector<Distribution> dists = { Distribution::Zipf, Distribution::Uniform, Distribution::Scan,
+                                            Distribution::HotCold, Distribution::Shift };
+        std::vector<size_t>       valueSizes = { 16, 256 };
+        bool                      valueSizesGiven = false;
+        std::string               tracePath; // 非空时回放轨迹，不生成分布
+        std::vector<std::string>  policies = { "lru", "lrubuf", "lru+l0", "lru+lz", "lfu", "lfubuf", "klru", "slru", "arc", "tinylfu", "clock", "static-lru", "arc+tinylfu", "hashlru", "hashlru-numa", "hashlru-replica", "shardedlfu", "shardedclock" };
+    };
+
+    const char* distName(Distribution dist) {
+        switch (dist) {
+        case Distribution::Zipf:    return "zipf";
+        case Distribution::Uniform: return "uniform";
+        case Distribution::Scan:    return "scan";
+        case Distribution::HotCold: return "hotcold";
+        case Distribution::Shift:   return "shift";
+        }
+        return "?";
+    }
+
+    bool parseDist(const std::string& name, Distribution& dist) {
+        for (Distribution d : { Distribution::Zipf, Distribution::Uniform, Distribution::Scan,
+                                Distribution::HotCold, Distribution::Shift }) {
+            if (name == distName(d)) {
+                dist = d;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::unique_ptr<BenchCache> makeCache(const std::string& policy, int capacity, int threads) {
+        size_t shards = static_cast<size_t>(std::max(threads, 1)) * 2; // 分片数随线程数走，避免单线程也被切得过碎
+        if (policy == "lru") return std::make_unique<MyCache::MyLruCache<int, std::string>>(capacity);
+        if (policy == "lrubuf") { // 开了读缓冲：命中只拿共享锁
+            auto cache = std::make_unique<MyCache::MyLruCache<int, std::string>>(capacity);
+            cache->enableReadBuffer();
+            return cache;
+        }
+        if (policy == "lru+l0") // 每个线程64个槽位的L0挡在前面
+            return std::make_unique<MyCache::MyFrontCache<int, std::string, MyCache::MyLruCache<int, std::string>>>(64, capacity);
+        if (policy == "lru+lz") // 64字节以上的value压缩后存；容量仍按条目数，和lru可比，看的是编解码的开销
+            return std::make_unique<MyCache::MyCompressedCache<int, MyCache::MyLruCache<int, std::string>>>(64, capacity);
+        if (policy == "lfu") return std::make_unique<MyCache::MyLfuCache<int, std::string>>(capacity);
+        if (policy == "lfubuf") {
+            auto cache = std::make_unique<MyCache::MyLfuCache<int, std::string>>(capacity);
+            cache->enableReadBuffer();
+            return cache;
+        }
+        if (policy == "klru") return std::make_unique<MyCache::MyKLruCache<int, std::string>>(capacity, capacity, 2);
+        if (policy == "slru") return std::make_unique<MyCache::MySlruCache<int, std::string>>(capacity);
+        if (policy == "arc") return std::make_unique<MyCache::MyArcCache<int, std::string>>(capacity);
+        if (policy == "tinylfu") return std::make_unique<MyCache::MyTinyLfuCache<int, std::string>>(capacity);
+        if (policy == "clock") return std::make_unique<MyCache::MyClockCache<int, std::string>>(capacity);
+        if (policy == "static-lru") // 编译期组合，和lru同样的淘汰顺序；这里经过MyPolicyAdapter多一次虚调用
+            return std::make_unique<MyCache::MyPolicyAdapter<MyCache::MyComposedCache<int, std::string>>>(static_cast<size_t>(capacity));
+        if (policy == "arc+tinylfu") // ARC淘汰加TinyLFU准入，同样是编译期组合
+            return std::make_unique<MyCache::MyPolicyAdapter<MyCache::MyComposedCache<int, std::string,
+                MyCache::MyArcEviction<int>, MyCache::MyTinyLfuAdmission<int>>>>(static_cast<size_t>(capacity));
+        if (policy == "hashlru") return std::make_unique<MyCache::MyHashLru<int, std::string>>(capacity, static_cast<int>(shards));
+        if (policy == "hashlru-numa") // 分片轮流摆到各个NUMA节点上
+            return std::make_unique<MyCache::MyHashLru<int, std::string>>(MyCache::MyNumaLayout::kPartitioned, capacity, static_cast<int>(shards));
+        if (policy == "hashlru-replica") // 每个节点一套副本，读只走本地
+            return std::make_unique<MyCache::MyHashLru<int, std::string>>(MyCache::MyNumaLayout::kReplicated, capacity, static_cast<int>(shards));
+        if (policy == "shardedlfu")
+            return std::make_unique<MyCache::MyShardedCache<int, std::string, MyCache::MyLfuCache<int, std::string>>>(capacity, shards);
+        if (policy == "shardedclock")
+            return std::make_unique<MyCache::MyShardedCache<int, std::string, MyCache::MyClockCache<int, std::string>>>(capacity, shards);
+        return nullptr;
+    }
+
+    // Zipf按秩采样：预先算好累积分布，采样时二分查找。秩0最热
+    class ZipfTable {
+    public:
+        ZipfTable(int n, double theta) : cdf_(static_cast<size_t>(n)) {
+            double sum = 0;
+            for (int i = 0; i < n; ++i) {
+                sum += 1.0 / std::pow(static_cast<double>(i + 1), theta);
+                cdf_[i] = sum;
+            }
+            for (double& c : cdf_) c /= sum;
+        }
+
+        template<typename Rng>
+        int sample(Rng& rng) const {
+            double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+            size_t rank = std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+            return static_cast<int>(std::min(rank, cdf_.size() - 1));
+        }
+
+    private:
+        std::vector<double> cdf_;
+    };
+
+    enum BenchOp : uint8_t { kOpPut = 0, kOpGet = 1, kOpErase = 2, kOpClear = 3 };
+
+    // 计时前把每个线程的key序列和操作序列都生成好，计时区间里只有缓存操作
+    struct ThreadTrace {
+        std::vector<int>     keys;
+        std::vector<uint8_t> ops; // BenchOp，生成的分布只有读和写
+        bool                 refill = true; // get未命中时是否回填put；回放的轨迹里已经有应用自己的回填
+    };
+
+    ThreadTrace makeTrace(const BenchConfig& config, Distribution dist, const ZipfTable& zipf, int threadIndex) {
+        std::mt19937_64 rng(0x9e3779b97f4a7c15ULL * (threadIndex + 1));
+        ThreadTrace trace;
+        size_t ops = config.opsPerThread;
+        trace.keys.resize(ops);
+        trace.ops.resize(ops);
+        int keySpace = config.keySpace;
+        int hotKeys = std::max(1, keySpace / 100);
+        int coldKeys = std::max(0, keySpace - hotKeys);
+        int scanPos = static_cast<int>((static_cast<long long>(keySpace) * threadIndex / std::max(config.maxThreads, 1)));
+        size_t phaseLength = std::max<size_t>(1, ops / 5);
+
+        for (size_t op = 0; op < ops; ++op) {
+            int key = 0;
+            switch (dist) {
+            case Distribution::Zipf:
+                key = zipf.sample(rng);
+                break;
+            case Distribution::Uniform:
+                key = static_cast<int>(rng() % keySpace);
+                break;
+            case Distribution::Scan: // 同TestCache的循环扫描：60%顺序、30%在扫描范围内随机、10%范围外
+                if (op % 100 < 60) {
+                    key = scanPos;
+                    scanPos = (scanPos + 1) % keySpace;
+                }
+                else if (op % 100 < 90) {
+                    key = static_cast<int>(rng() % keySpace);
+                }
+                else {
+                    key = keySpace + static_cast<int>(rng() % keySpace);
+                }
+                break;
+            case Distribution::HotCold: // 70%落在1%的热点key上
+                key = (op % 100 < 70 || coldKeys == 0) ? static_cast<int>(rng() % hotKeys)
+                    : hotKeys + static_cast<int>(rng() % coldKeys); // 冷key在[hotKeys, keySpace)
+                break;
+            case Distribution::Shift: { // 同TestCache的负载剧变：热点 -> 大范围随机 -> 顺序扫描 -> 局部性 -> 混合
+                size_t phase = std::min<size_t>(op / phaseLength, 4);
+                if (phase == 0) {
+                    key = static_cast<int>(rng() % hotKeys);
+                }
+                else if (phase == 1) {
+                    key = static_cast<int>(rng() % keySpace);
+                }
+                else if (phase == 2) {
+                    key = static_cast<int>((op - phaseLength * 2) % std::max(1, keySpace / 10));
+                }
+                else if (phase == 3) {
+                    int window = std::max(1, keySpace / 50);
+                    int locality = static_cast<int>((op / 1000) % 50);
+                    key = (locality * window + static_cast<int>(rng() % window)) % keySpace;
+                }
+                else {
+                    int r = static_cast<int>(rng() % 100);
+                    if (r < 30) key = static_cast<int>(rng() % hotKeys);
+                    else if (r < 60) key = (hotKeys + static_cast<int>(rng() % (keySpace / 10 + 1))) % keySpace;
+                    else key = static_cast<int>(rng() % keySpace);
+                }
+                break;
+            }
+            }
+            trace.keys[op] = key;
+            trace.ops[op] = static_cast<int>(rng() % 100) < config.readPercent ? kOpGet : kOpPut;
+        }
+        return trace;
+    }
+
+    // 录下的轨迹：记录线程t的访问按t % threads分给回放线程，每个回放线程内部保持原来的先后顺序
+    struct ReplayTrace {
+        std::vector<MyCache::MyTraceRecord> records;
+        uint32_t                            sampleEvery = 1;
+        double                              recordedHitRate = 0; // 录制时get的命中率
+        size_t                              averageValueSize = 16; // put的平均value大小，轨迹里没有put时取16
+    };
+
+    bool loadReplay(const std::string& path, ReplayTrace& replay) {
+        MyCache::MyTraceHeader header;
+        if (!MyCache::loadTrace(path, replay.records, &header))
+            return false;
+        replay.sampleEvery = header.sampleEvery > 0 ? header.sampleEvery : 1;
+        uint64_t gets = 0, hits = 0, puts = 0, bytes = 0;
+        for (const MyCache::MyTraceRecord& r : replay.records) {
+            if (r.op == MyCache::MyTraceOp::kGet) {
+                gets++;
+                hits += r.hit;
+            }
+            else if (r.op == MyCache::MyTraceOp::kPut) {
+                puts++;
+                bytes += r.valueSize;
+            }
+        }
+        replay.recordedHitRate = gets > 0 ? 100.0 * hits / gets : 0;
+        if (puts > 0) replay.averageValueSize = static_cast<size_t>(bytes / puts);
+        return true;
+    }
+
+    uint8_t benchOp(MyCache::MyTraceOp op) {
+        switch (op) {
+        case MyCache::MyTraceOp::kGet: return kOpGet;
+        case MyCache::MyTraceOp::kPut: return kOpPut;
+        case MyCache::MyTraceOp::kErase: return kOpErase;
+        default: return kOpClear;
+        }
+    }
+
+    std::vector<ThreadTrace> splitReplay(const ReplayTrace& replay, int threads) {
+        std::vector<ThreadTrace> traces(threads);
+        for (ThreadTrace& trace : traces) trace.refill = false;
+        for (const MyCache::MyTraceRecord& r : replay.records) {
+            ThreadTrace& trace = traces[r.thread % threads];
+            trace.keys.push_back(static_cast<int>(r.keyHash >> 33)); // 取31位非负整数当key，碰撞概率可以忽略
+            trace.ops.push_back(benchOp(r.op));
+        }
+        return traces;
+    }
+
+    struct ThreadResult {
+        LatencyHistogram histogram;
+        uint64_t         reads = 0;
+        uint64_t         hits = 0;
+    };
+
+    struct RunResult {
+        double           opsPerSec = 0;
+        double           hitRate = 0;
+        LatencyHistogram histogram;
+    };
+
+    void runThread(BenchCache& cache, const ThreadTrace& trace, const std::string& value, int sampleEvery,
+        std::atomic<int>& ready, const std::atomic<bool>& go, ThreadResult& result) {
+        std::string out;
+        ready.fetch_add(1);
+        while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+
+        size_t ops = trace.keys.size();
+        for (size_t op = 0; op < ops; ++op) {
+            int key = trace.keys[op];
+            bool timed = sampleEvery <= 1 || op % sampleEvery == 0;
+            Clock::time_point begin;
+            if (timed) begin = Clock::now();
+            switch (trace.ops[op]) {
+            case kOpGet:
+                result.reads++;
+                if (cache.get(key, out)) result.hits++;
+                else if (trace.refill) cache.put(key, value);
+                break;
+            case kOpPut:
+                cache.put(key, value);
+                break;
+            case kOpErase:
+                cache.erase(key);
+                break;
+            default:
+                cache.clear();
+                break;
+            }
+            if (timed) {
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+                result.histogram.record(static_cast<uint64_t>(ns));
+            }
+        }
+    }
+
+    RunResult runOnce(const BenchConfig& config, const std::string& policy, const std::vector<ThreadTrace>& traces,
+        const std::string& value, int threads, int capacity, bool warmUp) {
+        std::unique_ptr<BenchCache> cache = makeCache(policy, capacity, threads);
+        if (warmUp) {
+            for (int key = 0; key < std::min(capacity, config.keySpace); ++key) { // 预热，吞吐不含冷启动
+                cache->put(key, value);
+            }
+        }
+
+        std::vector<ThreadResult> results(threads);
+        std::vector<std::thread> workers;
+        std::atomic<int> ready(0);
+        std::atomic<bool> go(false);
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back(runThread, std::ref(*cache), std::cref(traces[t]), std::cref(value),
+                config.sampleEvery, std::ref(ready), std::cref(go), std::ref(results[t]));
+        }
+        while (ready.load() < threads) std::this_thread::yield();
+        Clock::time_point start = Clock::now();
+        go.store(true, std::memory_order_release);
+        for (std::thread& worker : workers) worker.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        RunResult run;
+        uint64_t reads = 0, hits = 0;
+        for (const ThreadResult& r : results) {
+            run.histogram.merge(r.histogram);
+            reads += r.reads;
+            hits += r.hits;
+        }
+        size_t totalOps = 0;
+        for (int t = 0; t < threads; ++t) totalOps += traces[t].keys.size();
+        run.opsPerSec = static_cast<double>(totalOps) / seconds;
+        run.hitRate = reads > 0 ? 100.0 * hits / reads : 0;
+        return run;
+    }
+
+    std::vector<std::string> splitList(const std::string& text) {
+        std::vector<std::string> items;
+        std::stringstream ss(text);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (!item.empty()) items.push_back(item);
+        }
+        return items;
+    }
+
+    void printUsage(std::ostream& out) {
+        BenchConfig defaults;
+        out << "用法: MyCacheBench [选项]\n"
+            << "  --threads=N          最多用几个线程，依次跑1、2、4...N（默认" << defaults.maxThreads << "）\n"
+            << "  --ops=N              每线程操作数（默认" << defaults.opsPerThread << "）\n"
+            << "  --read=P             读比例%（默认" << defaults.readPercent << "）\n"
+            << "  --capacity=N         缓存容量（默认" << defaults.capacity << "）\n"
+            << "  --keys=N             key空间（默认" << defaults.keySpace << "）\n"
+            << "  --dist=a,b           key分布: zipf,uniform,scan,hotcold,shift（默认全部）\n"
+            << "  --zipf=THETA         zipf的theta（默认" << defaults.zipfTheta << "）\n"
+            << "  --value-size=a,b     value字节数（默认16,256）\n"
+            << "  --trace=FILE         回放MyTraceRecorder录下的轨迹，不再生成分布\n"
+            << "  --policy=a,b         要测的策略（默认全部）:\n     ";
+        for (const std::string& policy : defaults.policies) out << ' ' << policy;
+        out << "\n"
+            << "  --sample=N           每隔N次操作计一次延迟（默认1）\n"
+            << "  --csv                输出CSV\n"
+            << "  --help               显示本说明" << std::endl;
+    }
+
+    bool parseArgs(int argc, char** argv, BenchConfig& config) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            size_t eq = arg.find('=');
+            std::string name = arg.substr(0, eq);
+            std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+            if (name == "--help" || name == "-h") {
+                config.help = true;
+                return true;
+            }
+            else if (name == "--threads") config.maxThreads = std::max(1, std::atoi(value.c_str()));
+            else if (name == "--ops") config.opsPerThread = std::max<size_t>(1, std::strtoull(value.c_str(), nullptr, 10));
+            else if (name == "--read") config.readPercent = std::min(100, std::max(0, std::atoi(value.c_str())));
+            else if (name == "--capacity") config.capacity = std::max(1, std::atoi(value.c_str()));
+            else if (name == "--keys") config.keySpace = std::max(1, std::atoi(value.c_str()));
+            else if (name == "--zipf") config.zipfTheta = std::atof(value.c_str());
+            else if (name == "--sample") config.sampleEvery = std::max(1, std::atoi(value.c_str()));
+            else if (name == "--csv") config.csv = true;
+            else if (name == "--policy") config.policies = splitList(value);
+            else if (name == "--trace") config.tracePath = value;
+            else if (name == "--value-size") {
+                config.valueSizesGiven = true;
+                config.valueSizes.clear();
+                for (const std::string& s : splitList(value)) config.valueSizes.push_back(std::strtoull(s.c_str(), nullptr, 10));
+            }
+            else if (name == "--dist") {
+                config.dists.clear();
+                for (const std::string& s : splitList(value)) {
+                    Distribution dist;
+                    if (!parseDist(s, dist)) {
+                        std::cerr << "未知的分布: " << s << std::endl;
+                        return false;
+                    }
+                    config.dists.push_back(dist);
+                }
+            }
+            else {
+                std::cerr << "未知的参数: " << arg << std::endl;
+                printUsage(std::cerr);
+                return false;
+            }
+        }
+        for (const std::string& policy : config.policies) {
+            if (!makeCache(policy, 1, 1)) {
+                std::cerr << "未知的策略: " << policy << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void printHeader(const char* dist, size_t valueSize) {
+        std::cout << "\n=== 分布: " << dist << "  value大小: " << valueSize << " ===" << std::endl;
+        std::cout << std::left << std::setw(14) << "policy" << std::right << std::setw(8) << "threads" // 表头用ASCII，中文宽度会让setw对不齐
+            << std::setw(14) << "Mops/s" << std::setw(10) << "hit%" << std::setw(10) << "p50ns"
+            << std::setw(10) << "p99ns" << std::setw(10) << "p999ns" << std::setw(12) << "maxns" << std::endl;
+    }
+
+    void printRow(const BenchConfig& config, const std::string& policy, const char* dist, size_t valueSize, int threads, const RunResult& run) {
+        const LatencyHistogram& h = run.histogram;
+        if (config.csv) {
+            std::cout << policy << ',' << dist << ',' << valueSize << ',' << threads << ','
+                << std::fixed << std::setprecision(0) << run.opsPerSec << ','
+                << std::setprecision(2) << run.hitRate << ',' << h.percentile(0.50) << ','
+                << h.percentile(0.99) << ',' << h.percentile(0.999) << ',' << h.max() << std::endl;
+        }
+        else {
+            std::cout << std::left << std::setw(14) << policy << std::right << std::setw(8) << threads
+                << std::setw(14) << std::fixed << std::setprecision(3) << run.opsPerSec / 1e6
+                << std::setw(10) << std::setprecision(2) << run.hitRate
+                << std::setw(10) << h.percentile(0.50) << std::setw(10) << h.percentile(0.99)
+                << std::setw(10) << h.percentile(0.999) << std::setw(12) << h.max() << std::endl;
+        }
+    }
+
+    std::vector<int> threadSteps(int maxThreads) { // 1, 2, 4 ... maxThreads
+        std::vector<int> steps;
+        for (int t = 1; t < maxThreads; t *= 2) steps.push_back(t);
+        steps.push_back(maxThreads);
+        return steps;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config)) return 1;
+    if (config.help) {
+        printUsage(std::cout);
+        return 0;
+    }
+
+    std::vector<int> steps = threadSteps(config.maxThreads);
+
+    if (config.csv) {
+        std::cout << "policy,dist,value_size,threads,ops_per_sec,hit_rate,p50_ns,p99_ns,p999_ns,max_ns" << std::endl;
+    }
+
+    if (!config.tracePath.empty()) {
+        ReplayTrace replay;
+        if (!loadReplay(config.tracePath, replay)) {
+            std::cerr << "读不了轨迹文件: " << config.tracePath << std::endl;
+            return 1;
+        }
+        int capacity = std::max(1, config.capacity / static_cast<int>(replay.sampleEvery));
+        if (!config.valueSizesGiven) config.valueSizes = { replay.averageValueSize };
+        if (!config.csv) {
+            std::cout << "轨迹: " << config.tracePath << "  记录数: " << replay.records.size() << "  采样: 1/" << replay.sampleEvery
+                << "  回放容量: " << capacity << "  录制时命中率: " << std::fixed << std::setprecision(2) << replay.recordedHitRate << "%" << std::endl;
+        }
+        for (size_t valueSize : config.valueSizes) {
+            std::string value(valueSize, 'v');
+            if (!config.csv) printHeader("trace", valueSize);
+            for (const std::string& policy : config.policies) {
+                for (int threads : steps) {
+                    std::vector<ThreadTrace> traces = splitReplay(replay, threads);
+                    RunResult run = runOnce(config, policy, traces, value, threads, capacity, false); // 从冷缓存开始，和录制时一样
+                    printRow(config, policy, "trace", valueSize, threads, run);
+                }
+            }
+        }
+        return 0;
+    }
+
+    ZipfTable zipf(config.keySpace, config.zipfTheta);
+    if (!config.csv) {
+        std::cout << "容量: " << config.capacity << "  key空间: " << config.keySpace << "  读比例: " << config.readPercent
+            << "%  每线程操作数: " << config.opsPerThread << std::endl;
+    }
+
+    for (Distribution dist : config.dists) {
+        std::vector<ThreadTrace> traces;
+        for (int t = 0; t < config.maxThreads; ++t) traces.push_back(makeTrace(config, dist, zipf, t));
+
+        for (size_t valueSize : config.valueSizes) {
+            std::string value(valueSize, 'v');
+            if (!config.csv) printHeader(distName(dist), valueSize);
+            for (const std::string& policy : config.policies) {
+                for (int threads : steps) {
+                    RunResult run = runOnce(config, policy, traces, value, threads, config.capacity, true);
+                    printRow(config, policy, distName(dist), valueSize, threads, run);
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -1,17 +1,94 @@
 #pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
 namespace MyCache{
 
+namespace detail {
+
+	constexpr size_t kBatchChunk = 16; // 批量接口每次先算这么多个key的hash并预取，再逐个探测
+
+	// 批量接口的下标映射：indices为空时按顺序处理，否则只处理indices列出的位置（分片缓存按分片分组时不用拷贝key）
+	inline size_t batchIndex(const uint32_t* indices, size_t i) {
+		return indices != nullptr ? indices[i] : i;
+	}
+
+}
+
+// 条目权重回调，例如返回value占用的字节数，这时容量就是总字节预算。
+// 为空表示每个条目权重为1，容量仍是条目数。容量是int，权重超过2^31时可以按KB等更粗的单位算
+template <typename Key, typename Value>
+using MyWeigher = std::function<size_t(const Key&, const Value&)>;
+
+// 条目被移除的原因
+enum class MyRemovalCause : uint8_t {
+	kEvicted, // 因容量或权重预算被淘汰
+	kExpired, // ttl到期
+	kExplicit, // erase/clear/ttl<=0的put
+};
+
+// 非阻塞接口(tryGetHashed等)的结果：kBusy表示锁正被占用，什么也没做，调用方稍后重试或者改走阻塞接口
+enum class MyTryResult : uint8_t {
+	kBusy,
+	kMiss, // 拿到了锁，key不存在
+	kHit, // 拿到了锁，key存在
+};
+
+// 移除回调：value已经从节点移出，回调可以直接拿走。
+// 策略在锁内只把通知排进队列，解锁后由触发移除的线程依次调用，回调里可以再访问同一个缓存；回调抛出的异常会被忽略
+template <typename Key, typename Value>
+using MyEvictionListener = std::function<void(const Key&, Value&&, MyRemovalCause)>;
+
 template <typename Key,typename Value>
 class MyCachePolicy {
 
-	// 缓存策略接口有：put,get
+	// 缓存策略接口有：put,get,erase,clear,contains,size。key一律按const引用传入，put另有右值版本，大value可以直接移进缓存
 
 public:
-	virtual void put(Key key, Value value) = 0;
+	virtual void put(const Key& key, const Value& value) = 0;
+
+	virtual void put(const Key& key, Value&& value) = 0;
+
+	virtual Value get(const Key& key) = 0;
+
+	virtual bool get(const Key& key, Value& value) = 0;
+
+	// 删除key，返回删除前是否存在（已过期还没回收的不算）
+	virtual bool erase(const Key& key) = 0;
+
+	// 上游数据变了时作废条目，等同erase
+	void invalidate(const Key& key) { erase(key); }
+
+	// 删除所有条目，统计计数保留
+	virtual void clear() = 0;
+
+	// 只查不算一次访问，不改变淘汰顺序
+	virtual bool contains(const Key& key) = 0;
+
+	// 当前条目数，可能包含已过期还没回收的条目
+	virtual size_t size() = 0;
 
-	virtual Value get(Key key) = 0;
+	// 批量读：hits[i]表示keys[i]是否命中，命中的值写入values[i]，返回命中个数。
+	// 默认实现逐个调用get，具体策略重写成一次加锁、先算hash预取再探测
+	virtual size_t getMany(const Key* keys, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) {
+		size_t hitCount = 0;
+		for (size_t i = 0; i < count; i++) {
+			size_t idx = detail::batchIndex(indices, i);
+			hits[idx] = get(keys[idx], values[idx]);
+			if (hits[idx]) hitCount++;
+		}
+		return hitCount;
+	}
 
-	virtual bool get(Key key, Value& value) = 0;
+	// 批量写：keys[i] -> values[i]
+	virtual void putMany(const Key* keys, const Value* values, size_t count, const uint32_t* indices = nullptr) {
+		for (size_t i = 0; i < count; i++) {
+			size_t idx = detail::batchIndex(indices, i);
+			put(keys[idx], values[idx]);
+		}
+	}
 
 	virtual ~MyCachePolicy() {};
 
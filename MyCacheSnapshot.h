@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MyCache {
+
+	// 快照文件：固定头 + 连续的记录，LRU按最近使用到最久未使用排列，LFU按频次从高到低排列。
+	// 数值按本机字节序原样写入，用于同一台机器上的热重启，不做跨平台交换格式
+	enum class MySnapshotKind : uint32_t { kLru = 1, kLfu = 2, kLog = 3 }; // kLog是二级缓存的日志段，只借用编码，不写文件头
+
+	struct MySnapshotHeader {
+		char     magic[8]; // "MYCACHE"
+		uint32_t version;
+		uint32_t kind;
+		uint64_t count; // 记录数
+		uint64_t payloadBytes; // 头之后的字节数，加载时据此判断文件是否完整
+	};
+
+	constexpr char     kSnapshotMagic[8] = { 'M', 'Y', 'C', 'A', 'C', 'H', 'E', '\0' };
+	constexpr uint32_t kSnapshotVersion = 1;
+
+	// 编码缓冲：缓存在锁内把条目编码进来，写文件在锁外进行
+	class MySnapshotWriter {
+	private:
+		std::vector<char> buffer_;
+		uint32_t          kind_;
+		uint64_t          count_;
+
+	public:
+		explicit MySnapshotWriter(MySnapshotKind kind) :kind_(static_cast<uint32_t>(kind)), count_(0) {}
+
+		void writeBytes(const void* data, size_t size) {
+			const char* bytes = static_cast<const char*>(data);
+			buffer_.insert(buffer_.end(), bytes, bytes + size);
+		}
+
+		template<typename T>
+		void write(const T& value) {
+			static_assert(std::is_trivially_copyable<T>::value, "write只接受可平凡拷贝的类型");
+			writeBytes(&value, sizeof(T));
+		}
+
+		void endRecord() { count_++; }
+
+		uint64_t count() const { return count_; }
+
+		void reserve(size_t bytes) { buffer_.reserve(bytes); }
+
+		const char* data() const { return buffer_.data(); }
+		size_t size() const { return buffer_.size(); }
+
+		void clear() { // 保留缓冲区的容量，反复编码不再分配
+			buffer_.clear();
+			count_ = 0;
+		}
+
+		// 先写临时文件再改名，写到一半崩溃也不会留下半个快照
+		bool saveTo(const std::string& path) const {
+			MySnapshotHeader header{};
+			std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+			header.version = kSnapshotVersion;
+			header.kind = kind_;
+			header.count = count_;
+			header.payloadBytes = buffer_.size();
+
+			std::string tmp = path + ".tmp";
+			{
+				std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+				if (!out)
+					return false;
+				out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				out.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+				if (!out.flush()) {
+					out.close();
+					std::remove(tmp.c_str());
+					return false;
+				}
+			}
+			std::remove(path.c_str()); // Windows上rename不覆盖已有文件
+			return std::rename(tmp.c_str(), path.c_str()) == 0;
+		}
+	};
+
+	// 只读映射整个文件，加载时直接从映射的内存解码，不经过一次read拷贝
+	class MyMappedFile {
+	private:
+		const char* data_;
+		size_t      size_;
+#if defined(_WIN32)
+		HANDLE      file_;
+		HANDLE      mapping_;
+#else
+		int         fd_;
+#endif
+
+	public:
+		explicit MyMappedFile(const std::string& path) :data_(nullptr), size_(0) {
+#if defined(_WIN32)
+			mapping_ = nullptr;
+			file_ = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file_ == INVALID_HANDLE_VALUE)
+				return;
+			LARGE_INTEGER size;
+			if (!::GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+				return;
+			mapping_ = ::CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping_ == nullptr)
+				return;
+			void* view = ::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+			if (view == nullptr)
+				return;
+			data_ = static_cast<const char*>(view);
+			size_ = static_cast<size_t>(size.QuadPart);
+#else
+			fd_ = ::open(path.c_str(), O_RDONLY);
+			if (fd_ < 0)
+				return;
+			struct stat st;
+			if (::fstat(fd_, &st) != 0 || st.st_size == 0)
+				return;
+			void* view = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+			if (view == MAP_FAILED)
+				return;
+			::madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL); // 只顺序扫一遍，让内核提前读
+			data_ = static_cast<const char*>(view);
+			size_ = static_cast<size_t>(st.st_size);
+#endif
+		}
+
+		~MyMappedFile() {
+#if defined(_WIN32)
+			if (data_ != nullptr) ::UnmapViewOfFile(data_);
+			if (mapping_ != nullptr) ::CloseHandle(mapping_);
+			if (file_ != INVALID_HANDLE_VALUE) ::CloseHandle(file_);
+#else
+			if (data_ != nullptr) ::munmap(const_cast<char*>(data_), size_);
+			if (fd_ >= 0) ::close(fd_);
+#endif
+		}
+
+		MyMappedFile(const MyMappedFile&) = delete;
+		MyMappedFile& operator=(const MyMappedFile&) = delete;
+
+		const char* data() const { return data_; }
+		size_t size() const { return size_; }
+		explicit operator bool() const { return data_ != nullptr; }
+	};
+
+	// 在映射的内存上顺序解码，每次读都检查越界，截断或损坏的文件只会让读取失败，不会越界
+	class MySnapshotReader {
+	private:
+		const char* cur_;
+		const char* end_;
+		uint64_t    count_;
+
+	public:
+		// 校验头部，失败时valid()为false。minRecordBytes是一条记录至少占的字节数，记录数和它对不上的头部当作损坏，
+		// 之后按count()预留不会因为损坏的记录数过量分配
+		MySnapshotReader(const MyMappedFile& file, MySnapshotKind kind, size_t minRecordBytes = 1) :cur_(nullptr), end_(nullptr), count_(0) {
+			MySnapshotHeader header;
+			if (!file || file.size() < sizeof(header))
+				return;
+			std::memcpy(&header, file.data(), sizeof(header));
+			if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 || header.version != kSnapshotVersion
+				|| header.kind != static_cast<uint32_t>(kind) || header.payloadBytes != file.size() - sizeof(header)
+				|| header.count > header.payloadBytes / std::max<size_t>(minRecordBytes, 1))
+				return;
+			cur_ = file.data() + sizeof(header);
+			end_ = cur_ + header.payloadBytes;
+			count_ = header.count;
+		}
+
+		// 直接解码一段内存，例如从日志段读出的一条记录
+		MySnapshotReader(const char* data, size_t size) :cur_(data), end_(data + size), count_(0) {}
+
+		bool valid() const { return cur_ != nullptr; }
+		uint64_t count() const { return count_; } // 头部记录的条目数，加载前用来预留
+		size_t remaining() const { return static_cast<size_t>(end_ - cur_); }
+
+		// 在一份拷贝上用readRecord把count()条记录整个解码一遍，条数和字节数都正好对上才返回true，自身的读位置不动。
+		// 加载前在锁外调用，损坏的文件一条也不装
+		template<typename ReadRecord>
+		bool verify(ReadRecord&& readRecord) const {
+			if (!valid())
+				return false;
+			MySnapshotReader copy(*this);
+			for (uint64_t i = 0; i < count_; i++) {
+				if (!readRecord(copy))
+					return false;
+			}
+			return copy.remaining() == 0;
+		}
+
+		// 取出接下来size个字节的指针（指向映射的内存），不拷贝
+		const char* readBytes(size_t size) {
+			if (static_cast<size_t>(end_ - cur_) < size)
+				return nullptr;
+			const char* p = cur_;
+			cur_ += size;
+			return p;
+		}
+
+		template<typename T>
+		bool read(T& value) {
+			static_assert(std::is_trivially_copyable<T>::value, "read只接受可平凡拷贝的类型");
+			const char* p = readBytes(sizeof(T));
+			if (p == nullptr)
+				return false;
+			std::memcpy(&value, p, sizeof(T)); // 映射的内存里没有对齐保证
+			return true;
+		}
+	};
+
+	// 快照里Key/Value的编解码。默认支持可平凡拷贝的类型和std::string，其它类型特化MySerializer，
+	// 或者给saveSnapshot/loadSnapshot传自己的序列化器，接口为：
+	//   static void write(MySnapshotWriter&, const T&);
+	//   static bool read(MySnapshotReader&, T&); 失败返回false
+	template<typename T, typename = void>
+	struct MySerializer;
+
+	template<typename T>
+	struct MySerializer<T, std::enable_if_t<std::is_trivially_copyable<T>::value>> {
+		static void write(MySnapshotWriter& out, const T& value) { out.write(value); }
+		static bool read(MySnapshotReader& in, T& value) { return in.read(value); }
+	};
+
+	template<>
+	struct MySerializer<std::string> { // 长度 + 字节
+		static void write(MySnapshotWriter& out, const std::string& value) {
+			out.write(static_cast<uint64_t>(value.size()));
+			out.writeBytes(value.data(), value.size());
+		}
+
+		static bool read(MySnapshotReader& in, std::string& value) {
+			uint64_t size = 0;
+			if (!in.read(size))
+				return false;
+			const char* p = in.readBytes(static_cast<size_t>(size));
+			if (p == nullptr)
+				return false;
+			value.assign(p, static_cast<size_t>(size));
+			return true;
+		}
+	};
+
+}
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// 编译时定义MYCACHE_PROFILE=1才开启剖析：锁等待/持有时间、LFU老化停顿的直方图和链表操作计数，用stats()旁边的profile()读。
+// 默认关闭，这时MyProfileCounter是空类、记录函数都是空的内联函数，热路径上不多一条指令。所有翻译单元必须用同一个设置
+#ifndef MYCACHE_PROFILE
+#define MYCACHE_PROFILE 0
+#endif
+
+namespace MyCache {
+
+	constexpr size_t kCacheLineSize = 64;
+
+	// 按2的幂分桶的耗时直方图快照：第0个桶是0ns，第i个桶是[2^(i-1), 2^i)ns。只用来看量级和长尾，精度是2倍
+	struct MyHistogramSnapshot {
+		static constexpr size_t kBuckets = 48; // 最后一个桶装下2^46ns（约19小时）以上的全部
+
+		uint64_t counts[kBuckets] = {};
+
+		uint64_t total() const {
+			uint64_t sum = 0;
+			for (uint64_t count : counts) sum += count;
+			return sum;
+		}
+
+		// 第q分位(0~1)所在桶的上界，没有样本时返回0
+		uint64_t percentile(double q) const {
+			uint64_t all = total();
+			if (all == 0)
+				return 0;
+			uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(all));
+			if (rank >= all) rank = all - 1;
+			uint64_t seen = 0;
+			for (size_t i = 0; i < kBuckets; i++) {
+				seen += counts[i];
+				if (seen > rank)
+					return i == 0 ? 0 : (uint64_t(1) << i) - 1;
+			}
+			return (uint64_t(1) << (kBuckets - 1)) - 1;
+		}
+
+		static size_t bucketOf(uint64_t nanos) {
+			size_t bucket = 0;
+			while (nanos != 0 && bucket < kBuckets - 1) {
+				nanos >>= 1;
+				bucket++;
+			}
+			return bucket;
+		}
+
+		MyHistogramSnapshot& operator+=(const MyHistogramSnapshot& other) {
+			for (size_t i = 0; i < kBuckets; i++) counts[i] += other.counts[i];
+			return *this;
+		}
+	};
+
+	// 剖析快照。只统计独占锁，读缓冲里只拿共享锁的命中不计入lockWait/lockHold
+	struct MyCacheProfile {
+		bool                enabled = false; // 编译时没开MYCACHE_PROFILE时为false，其余字段全是0
+		MyHistogramSnapshot lockWait; // 每次加独占锁的等待时间，没等待的记在0ns桶里
+		MyHistogramSnapshot lockHold; // 每次持有独占锁的时间（不含解锁后投递移除通知）
+		MyHistogramSnapshot agingPause; // LFU每次频次老化(handleOverMaxAverageNum)占用锁的时间
+		uint64_t            listMoves = 0; // 命中后的链表调整：LRU移到最近端、LFU挪到下一个频次桶
+		uint64_t            listInserts = 0; // 新条目挂进链表
+		uint64_t            listRemoves = 0; // 条目从链表摘下（淘汰、过期、删除、覆盖被拒）
+
+		MyCacheProfile& operator+=(const MyCacheProfile& other) {
+			enabled = enabled || other.enabled;
+			lockWait += other.lockWait;
+			lockHold += other.lockHold;
+			agingPause += other.agingPause;
+			listMoves += other.listMoves;
+			listInserts += other.listInserts;
+			listRemoves += other.listRemoves;
+			return *this;
+		}
+	};
+
+	// 剖析计数器，作为MyStatsCounter的一部分跟着每个缓存实例（每个分片）走。
+	// 和MyStatsCounter一样只在策略的互斥锁内写入，用relaxed的load+store
+	class MyProfileCounter {
+#if MYCACHE_PROFILE
+	private:
+		struct Histogram {
+			std::atomic<uint64_t> counts[MyHistogramSnapshot::kBuckets] = {};
+
+			void record(uint64_t nanos) { add(counts[MyHistogramSnapshot::bucketOf(nanos)], 1); }
+
+			void read(MyHistogramSnapshot& snapshot) const {
+				for (size_t i = 0; i < MyHistogramSnapshot::kBuckets; i++) snapshot.counts[i] = counts[i].load(std::memory_order_relaxed);
+			}
+		};
+
+		Histogram             lockWait_;
+		Histogram             lockHold_;
+		Histogram             agingPause_;
+		std::atomic<uint64_t> listMoves_{ 0 };
+		std::atomic<uint64_t> listInserts_{ 0 };
+		std::atomic<uint64_t> listRemoves_{ 0 };
+
+		static void add(std::atomic<uint64_t>& counter, uint64_t n) {
+			counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+
+	public:
+		static constexpr bool kEnabled = true;
+
+		static uint64_t now() {
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		void lockWait(uint64_t nanos) { lockWait_.record(nanos); }
+		void lockHold(uint64_t nanos) { lockHold_.record(nanos); }
+		void agingPause(uint64_t nanos) { agingPause_.record(nanos); }
+		void listMove() { add(listMoves_, 1); }
+		void listInsert() { add(listInserts_, 1); }
+		void listRemove() { add(listRemoves_, 1); }
+
+		MyCacheProfile snapshot() const {
+			MyCacheProfile profile;
+			profile.enabled = true;
+			lockWait_.read(profile.lockWait);
+			lockHold_.read(profile.lockHold);
+			agingPause_.read(profile.agingPause);
+			profile.listMoves = listMoves_.load(std::memory_order_relaxed);
+			profile.listInserts = listInserts_.load(std::memory_order_relaxed);
+			profile.listRemoves = listRemoves_.load(std::memory_order_relaxed);
+			return profile;
+		}
+#else
+	public:
+		static constexpr bool kEnabled = false;
+
+		static constexpr uint64_t now() { return 0; }
+
+		void lockWait(uint64_t) {}
+		void lockHold(uint64_t) {}
+		void agingPause(uint64_t) {}
+		void listMove() {}
+		void listInsert() {}
+		void listRemove() {}
+
+		MyCacheProfile snapshot() const { return MyCacheProfile(); }
+#endif
+	};
+
+	// 统计快照，stats()返回的是调用时刻各计数器的值
+	struct MyCacheStats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t puts = 0;
+		uint64_t evictions = 0; // 因容量或权重预算被淘汰的条目
+		uint64_t expirations = 0; // 因ttl到期被回收的条目
+		uint64_t agingRuns = 0; // LFU频次老化(handleOverMaxAverageNum)的次数
+		uint64_t lockContended = 0; // 加锁时try_lock失败、需要等待的次数
+		uint64_t lockWaitNanos = 0; // 等锁花掉的总时间
+
+		uint64_t requests() const { return hits + misses; }
+
+		double hitRate() const { return requests() > 0 ? static_cast<double>(hits) / static_cast<double>(requests()) : 0.0; }
+
+		MyCacheStats& operator+=(const MyCacheStats& other) {
+			hits += other.hits;
+			misses += other.misses;
+			puts += other.puts;
+			evictions += other.evictions;
+			expirations += other.expirations;
+			agingRuns += other.agingRuns;
+			lockContended += other.lockContended;
+			lockWaitNanos += other.lockWaitNanos;
+			return *this;
+		}
+	};
+
+	// 每个缓存实例（分片缓存里就是每个分片）一份计数器，8个计数器正好占满一条独立的cache line，不和锁、链表头等热数据伪共享。
+	// 写入都发生在策略自己的互斥锁内，已经串行化，所以用relaxed的load+store代替带lock前缀的fetch_add；
+	// stats()只做relaxed读，不加锁，读到的是近似一致的快照。剖析计数器放在基类里，关闭时是空基类，不占空间
+	class alignas(kCacheLineSize) MyStatsCounter :private MyProfileCounter {
+	private:
+		std::atomic<uint64_t> hits_{ 0 };
+		std::atomic<uint64_t> misses_{ 0 };
+		std::atomic<uint64_t> puts_{ 0 };
+		std::atomic<uint64_t> evictions_{ 0 };
+		std::atomic<uint64_t> expirations_{ 0 };
+		std::atomic<uint64_t> agingRuns_{ 0 };
+		std::atomic<uint64_t> lockContended_{ 0 };
+		std::atomic<uint64_t> lockWaitNanos_{ 0 };
+
+	public:
+		void hit(uint64_t n = 1) { add(hits_, n); }
+		void miss(uint64_t n = 1) { add(misses_, n); }
+		void put(uint64_t n = 1) { add(puts_, n); }
+		void eviction(uint64_t n = 1) { add(evictions_, n); }
+		void expiration(uint64_t n = 1) { add(expirations_, n); }
+		void agingRun() { add(agingRuns_, 1); }
+
+		// 只拿共享锁的读路径用：多个读线程会同时计数，必须用fetch_add；独占锁内的写入不会和它们并发
+		void sharedHit() { hits_.fetch_add(1, std::memory_order_relaxed); }
+		void sharedMiss() { misses_.fetch_add(1, std::memory_order_relaxed); }
+
+		void lockWait(uint64_t nanos) {
+			add(lockContended_, 1);
+			add(lockWaitNanos_, nanos);
+		}
+
+		MyProfileCounter& profile() { return *this; }
+		const MyProfileCounter& profile() const { return *this; }
+
+		MyCacheStats snapshot() const {
+			MyCacheStats stats;
+			stats.hits = hits_.load(std::memory_order_relaxed);
+			stats.misses = misses_.load(std::memory_order_relaxed);
+			stats.puts = puts_.load(std::memory_order_relaxed);
+			stats.evictions = evictions_.load(std::memory_order_relaxed);
+			stats.expirations = expirations_.load(std::memory_order_relaxed);
+			stats.agingRuns = agingRuns_.load(std::memory_order_relaxed);
+			stats.lockContended = lockContended_.load(std::memory_order_relaxed);
+			stats.lockWaitNanos = lockWaitNanos_.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+	private:
+		static void add(std::atomic<uint64_t>& counter, uint64_t n) { // 调用方持有缓存的互斥锁
+			counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+	};
+
+	// 带等锁统计的lock_guard：先try_lock，拿到了就和普通加锁一样；拿不到才读时钟计时阻塞，无竞争时没有额外开销。
+	// 开了MYCACHE_PROFILE时还记录每次的等待和持有时间
+	template<typename Mutex>
+	class MyStatsLock {
+	private:
+		Mutex&          mutex_;
+#if MYCACHE_PROFILE
+		MyStatsCounter& stats_;
+		uint64_t        acquiredAt_;
+#endif
+
+	public:
+#if MYCACHE_PROFILE
+		MyStatsLock(Mutex& mutex, MyStatsCounter& stats) :mutex_(mutex), stats_(stats) {
+			acquire(mutex_, stats);
+			acquiredAt_ = MyProfileCounter::now();
+		}
+
+		~MyStatsLock() {
+			stats_.profile().lockHold(MyProfileCounter::now() - acquiredAt_);
+			mutex_.unlock();
+		}
+#else
+		MyStatsLock(Mutex& mutex, MyStatsCounter& stats) :mutex_(mutex) {
+			acquire(mutex_, stats);
+		}
+
+		~MyStatsLock() { mutex_.unlock(); }
+#endif
+
+		static void acquire(Mutex& mutex, MyStatsCounter& stats) {
+			if (mutex.try_lock()) {
+				stats.profile().lockWait(0);
+				return;
+			}
+			auto begin = std::chrono::steady_clock::now();
+			mutex.lock();
+			auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin);
+			stats.lockWait(static_cast<uint64_t>(waited.count())); // 已经持有锁，计数的写入仍然是串行的
+			stats.profile().lockWait(static_cast<uint64_t>(waited.count()));
+		}
+
+		MyStatsLock(const MyStatsLock&) = delete;
+		MyStatsLock& operator=(const MyStatsLock&) = delete;
+	};
+
+}
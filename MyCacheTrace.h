@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "MyCachePolicy.h"
+#include "MyCacheStats.h"
+#include "MyHash.h"
+
+namespace MyCache {
+
+	enum class MyTraceOp : uint8_t {
+		kGet = 0,
+		kPut = 1,
+		kErase = 2,
+		kClear = 3,
+	};
+
+	// 一次访问，24字节，按本机字节序原样写盘
+	struct MyTraceRecord {
+		uint64_t  keyHash; // 只存key的64位hash：不泄露key本身，回放时用它当key
+		uint64_t  nanos; // 距开始记录的纳秒数
+		uint32_t  valueSize; // put的value字节数（std::string取size()，其它类型取sizeof），其余操作为0
+		uint16_t  thread; // 记录线程的编号，回放时按它分给各个线程，保持每个线程内的先后顺序
+		MyTraceOp op;
+		uint8_t   hit; // get是否命中、erase是否删到了
+	};
+	static_assert(sizeof(MyTraceRecord) == 24, "trace record layout");
+
+	// 文件头，后面紧跟若干条MyTraceRecord
+	struct MyTraceHeader {
+		char     magic[8] = { 'M', 'Y', 'T', 'R', 'A', 'C', 'E', '1' };
+		uint32_t version = 1;
+		uint32_t recordSize = sizeof(MyTraceRecord);
+		uint32_t sampleEvery = 1; // 每sampleEvery个key记一个，回放时容量也要按这个比例缩小
+		uint32_t reserved = 0;
+	};
+
+	// 访问轨迹记录器。每个线程固定写一个条带的缓冲，缓冲满了整块追加到文件，记录路径上只有一次几乎不会竞争的加锁。
+	// 采样按key的hash选：选中的key每一次访问都记，没选中的一次都不记，缩小后的轨迹里重用距离不变，拿来比较命中率仍然有效。
+	// 析构时把剩下的缓冲都写出去
+	class MyTraceRecorder {
+	private:
+		static constexpr size_t kStripeNum = 16;
+		static constexpr size_t kBufferRecords = 4096; // 每个条带攒满这么多条（96KB）写一次
+
+		struct alignas(kCacheLineSize) Stripe {
+			std::mutex                 mutex;
+			std::vector<MyTraceRecord> buffer;
+		};
+
+		std::FILE*                    file_;
+		uint32_t                      sampleEvery_;
+		std::chrono::steady_clock::time_point start_;
+		std::unique_ptr<Stripe[]>     stripes_;
+		std::mutex                    fileMutex_;
+		std::atomic<uint64_t>         recorded_{ 0 };
+
+	public:
+		// sampleEvery为1时记录全部访问
+		explicit MyTraceRecorder(const std::string& path, uint32_t sampleEvery = 1)
+			:file_(std::fopen(path.c_str(), "wb")), sampleEvery_(sampleEvery > 0 ? sampleEvery : 1),
+			start_(std::chrono::steady_clock::now()), stripes_(new Stripe[kStripeNum]) {
+			for (size_t i = 0; i < kStripeNum; i++) {
+				stripes_[i].buffer.reserve(kBufferRecords);
+			}
+			if (file_) {
+				MyTraceHeader header;
+				header.sampleEvery = sampleEvery_;
+				std::fwrite(&header, sizeof(header), 1, file_);
+			}
+		}
+
+		~MyTraceRecorder() {
+			flush();
+			if (file_) std::fclose(file_);
+		}
+
+		MyTraceRecorder(const MyTraceRecorder&) = delete;
+		MyTraceRecorder& operator=(const MyTraceRecorder&) = delete;
+
+		bool isOpen() const { return file_ != nullptr; }
+
+		uint32_t sampleEvery() const { return sampleEvery_; }
+
+		bool sampled(uint64_t keyHash) const { return sampleEvery_ == 1 || (keyHash >> 32) % sampleEvery_ == 0; } // 高位选，和分片、索引用的位错开
+
+		void record(uint64_t keyHash, MyTraceOp op, bool hit, uint32_t valueSize = 0) {
+			if (!file_ || (op != MyTraceOp::kClear && !sampled(keyHash)))
+				return;
+			MyTraceRecord record;
+			record.keyHash = keyHash;
+			record.nanos = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+			record.valueSize = valueSize;
+			record.thread = static_cast<uint16_t>(threadId());
+			record.op = op;
+			record.hit = hit ? 1 : 0;
+
+			Stripe& stripe = stripes_[threadId() % kStripeNum];
+			std::vector<MyTraceRecord> full;
+			{
+				std::lock_guard<std::mutex> lock(stripe.mutex);
+				stripe.buffer.push_back(record);
+				if (stripe.buffer.size() < kBufferRecords)
+					return;
+				full.reserve(kBufferRecords);
+				full.swap(stripe.buffer);
+			}
+			write(full); // 条带锁外写盘，同一条带的其它线程不用等磁盘
+		}
+
+		// 把所有条带里的记录写出去并刷到文件
+		void flush() {
+			for (size_t i = 0; i < kStripeNum; i++) {
+				std::vector<MyTraceRecord> pending;
+				{
+					std::lock_guard<std::mutex> lock(stripes_[i].mutex);
+					pending.swap(stripes_[i].buffer);
+					stripes_[i].buffer.reserve(kBufferRecords);
+				}
+				write(pending);
+			}
+			std::lock_guard<std::mutex> lock(fileMutex_);
+			if (file_) std::fflush(file_);
+		}
+
+		uint64_t recorded() const { return recorded_.load(std::memory_order_relaxed); } // 已经写到文件里的条数
+
+	private:
+		void write(const std::vector<MyTraceRecord>& records) {
+			if (records.empty() || !file_)
+				return;
+			std::lock_guard<std::mutex> lock(fileMutex_);
+			size_t written = std::fwrite(records.data(), sizeof(MyTraceRecord), records.size(), file_);
+			recorded_.fetch_add(written, std::memory_order_relaxed);
+		}
+
+		static size_t threadId() { // 线程第一次记录时分配，所有记录器共用
+			static std::atomic<size_t> next{ 0 };
+			thread_local size_t id = next.fetch_add(1, std::memory_order_relaxed);
+			return id;
+		}
+	};
+
+	// 读出整个轨迹文件，按时间戳稳定排序（各条带是整块写出的，文件里不按时间先后）。格式不对返回false
+	inline bool loadTrace(const std::string& path, std::vector<MyTraceRecord>& records, MyTraceHeader* header = nullptr) {
+		records.clear();
+		std::FILE* file = std::fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+		MyTraceHeader expected;
+		MyTraceHeader actual;
+		bool ok = std::fread(&actual, sizeof(actual), 1, file) == 1 && std::memcmp(actual.magic, expected.magic, sizeof(actual.magic)) == 0 &&
+			actual.version == expected.version && actual.recordSize == expected.recordSize;
+		if (ok) {
+			MyTraceRecord chunk[1024];
+			size_t n;
+			while ((n = std::fread(chunk, sizeof(MyTraceRecord), 1024, file)) > 0) {
+				records.insert(records.end(), chunk, chunk + n);
+			}
+			std::stable_sort(records.begin(), records.end(), [](const MyTraceRecord& a, const MyTraceRecord& b) { return a.nanos < b.nanos; });
+			if (header) *header = actual;
+		}
+		std::fclose(file);
+		return ok;
+	}
+
+	// 记录访问轨迹的前端，挡在任意策略Cache前面，把get/put/erase/clear连同结果交给MyTraceRecorder。
+	// contains不算访问，不记录。recorder不归这里所有，生命周期要覆盖这个前端
+	template<typename Key, typename Value, typename Cache, typename Hash = MyDefaultHash<Key>>
+	class MyTracingCache :public MyCachePolicy<Key, Value> {
+	private:
+		Cache            cache_;
+		MyTraceRecorder& recorder_;
+		Hash             hash_;
+
+	public:
+		// cacheArgs原样传给Cache的构造函数
+		template<typename... CacheArgs>
+		explicit MyTracingCache(MyTraceRecorder& recorder, CacheArgs&&... cacheArgs)
+			:cache_(std::forward<CacheArgs>(cacheArgs)...), recorder_(recorder) {}
+
+		MyTracingCache(const MyTracingCache&) = delete;
+		MyTracingCache& operator=(const MyTracingCache&) = delete;
+
+		void put(const Key& key, const Value& value) override {
+			recorder_.record(hashOf(key), MyTraceOp::kPut, false, valueSize(value));
+			cache_.put(key, value);
+		}
+
+		void put(const Key& key, Value&& value) override {
+			recorder_.record(hashOf(key), MyTraceOp::kPut, false, valueSize(value));
+			cache_.put(key, std::move(value));
+		}
+
+		Value get(const Key& key) override {
+			Value value{};
+			get(key, value);
+			return value;
+		}
+
+		bool get(const Key& key, Value& value) override {
+			bool hit = cache_.get(key, value);
+			recorder_.record(hashOf(key), MyTraceOp::kGet, hit);
+			return hit;
+		}
+
+		size_t getMany(const Key* keys, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) override {
+			size_t hitCount = cache_.getMany(keys, count, values, hits, indices);
+			for (size_t i = 0; i < count; i++) {
+				size_t idx = detail::batchIndex(indices, i);
+				recorder_.record(hashOf(keys[idx]), MyTraceOp::kGet, hits[idx]);
+			}
+			return hitCount;
+		}
+
+		void putMany(const Key* keys, const Value* values, size_t count, const uint32_t* indices = nullptr) override {
+			for (size_t i = 0; i < count; i++) {
+				size_t idx = detail::batchIndex(indices, i);
+				recorder_.record(hashOf(keys[idx]), MyTraceOp::kPut, false, valueSize(values[idx]));
+			}
+			cache_.putMany(keys, values, count, indices);
+		}
+
+		bool erase(const Key& key) override {
+			bool erased = cache_.erase(key);
+			recorder_.record(hashOf(key), MyTraceOp::kErase, erased);
+			return erased;
+		}
+
+		void clear() override {
+			recorder_.record(0, MyTraceOp::kClear, false);
+			cache_.clear();
+		}
+
+		bool contains(const Key& key) override { return cache_.contains(key); }
+
+		size_t size() override { return cache_.size(); }
+
+		Cache& cache() { return cache_; }
+
+	private:
+		uint64_t hashOf(const Key& key) const { return detail::hashKey(hash_, key); }
+
+		static uint32_t valueSize(const Value& value) {
+			if constexpr (std::is_same<Value, std::string>::value) return static_cast<uint32_t>(std::min<size_t>(value.size(), UINT32_MAX));
+			else return static_cast<uint32_t>(sizeof(Value));
+		}
+	};
+
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "MyCachePolicy.h"
+#include "MyFlatIndex.h"
+#include "MyRemovalQueue.h"
+
+namespace MyCache {
+
+	// CLOCK(second-chance)缓存：近似LRU的读多写少模式。
+	// 命中时不移动任何节点，只把槽位的引用位置1（relaxed原子操作），所以get只拿共享锁，读线程之间互不阻塞；
+	// 淘汰时时钟指针扫过槽位，引用位为1的清零给第二次机会，遇到为0的就淘汰
+	template<typename Key, typename Value, template<typename...> class Index = MyFlatIndex>
+	class MyClockCache :public MyCachePolicy<Key, Value> {
+	private:
+		struct Entry {
+			Key key;
+			Value value;
+			std::atomic<uint8_t> referenced;
+
+			Entry() :key(), value(), referenced(0) {}
+		};
+
+		using SlotMap = Index<Key, size_t>; // key到槽位下标
+		using Lock = MyNotifyingLock<std::shared_mutex, Key, Value>; // 独占锁，解锁后投递移除通知
+
+		int                       capacity_;
+		size_t                    size_; // 已占用的槽位数，未满时按顺序往后填
+		size_t                    hand_; // 时钟指针
+		std::unique_ptr<Entry[]>  entries_;
+		std::vector<size_t>       freeSlots_; // erase空出来的槽位，插入时优先复用，所以时钟扫到的槽位总是有效的
+		SlotMap                   slotMap_;
+		mutable std::shared_mutex mutex_; // get拿共享锁，put拿独占锁
+		MyRemovalQueue<Key, Value> removals_;
+
+	public:
+		explicit MyClockCache(int capacity)
+			:capacity_(capacity), size_(0), hand_(0),
+			entries_(new Entry[capacity > 0 ? capacity : 0]), slotMap_(capacity > 0 ? capacity : 0) {}
+
+		~MyClockCache() override = default;
+
+		void put(const Key& key, const Value& value) override {
+			putInternal(key, value);
+		}
+
+		void put(const Key& key, Value&& value) override {
+			putInternal(key, std::move(value));
+		}
+
+		Value get(const Key& key) override {
+			Value value{};
+			get(key, value);
+			return value;
+		}
+
+		bool get(const Key& key, Value& value) override {
+			return getInternal(key, value);
+		}
+
+		// 异构查找，例如key为std::string时直接传std::string_view/const char*
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		bool get(const K& key, Value& value) {
+			return getInternal(key, value);
+		}
+
+		// 批量读：整批只拿一次共享锁，先算hash预取再探测
+		size_t getMany(const Key* keys, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) override {
+			size_t hitCount = 0;
+			uint64_t hashes[detail::kBatchChunk];
+			std::shared_lock<std::shared_mutex> lock(mutex_);
+			for (size_t base = 0; base < count; base += detail::kBatchChunk) {
+				size_t n = std::min(detail::kBatchChunk, count - base);
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = slotMap_.hash(keys[detail::batchIndex(indices, base + i)]);
+					slotMap_.prefetch(hashes[i]);
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t idx = detail::batchIndex(indices, base + i);
+					const size_t* slot = slotMap_.find(keys[idx], hashes[i]);
+					hits[idx] = slot != nullptr;
+					if (slot != nullptr) {
+						readEntry(entries_[*slot], values[idx]);
+						hitCount++;
+					}
+				}
+			}
+			return hitCount;
+		}
+
+		void putMany(const Key* keys, const Value* values, size_t count, const uint32_t* indices = nullptr) override {
+			if (capacity_ <= 0)return;
+			Lock lock(mutex_, removals_);
+			for (size_t i = 0; i < count; i++) {
+				size_t idx = detail::batchIndex(indices, i);
+				putLocked(keys[idx], values[idx]);
+			}
+		}
+
+		bool erase(const Key& key) override {
+			Lock lock(mutex_, removals_);
+			size_t* slot = slotMap_.find(key);
+			if (slot == nullptr)
+				return false;
+			size_t index = *slot;
+			slotMap_.erase(key);
+			releaseEntry(entries_[index], MyRemovalCause::kExplicit);
+			freeSlots_.push_back(index);
+			return true;
+		}
+
+		void clear() override {
+			Lock lock(mutex_, removals_);
+			for (size_t i = 0; i < size_; i++) {
+				const size_t* slot = slotMap_.find(entries_[i].key);
+				if (slot != nullptr && *slot == i) // 跳过erase空出来的槽位
+					releaseEntry(entries_[i], MyRemovalCause::kExplicit);
+			}
+			slotMap_.clear();
+			freeSlots_.clear();
+			size_ = 0;
+			hand_ = 0;
+		}
+
+		bool contains(const Key& key) override { // 不置引用位
+			std::shared_lock<std::shared_mutex> lock(mutex_);
+			return slotMap_.find(key) != nullptr;
+		}
+
+		size_t size() override {
+			std::shared_lock<std::shared_mutex> lock(mutex_);
+			return slotMap_.size();
+		}
+
+		// 条目被淘汰或删除时的回调，在解锁后调用
+		void setEvictionListener(MyEvictionListener<Key, Value> listener) {
+			Lock lock(mutex_, removals_);
+			removals_.setListener(std::move(listener));
+		}
+
+	private:
+		template<typename V>
+		void putInternal(const Key& key, V&& value) {
+			if (capacity_ <= 0)return;
+			Lock lock(mutex_, removals_);
+			putLocked(key, std::forward<V>(value));
+		}
+
+		template<typename V>
+		void putLocked(const Key& key, V&& value) { // 调用方持有独占锁
+			size_t* slot = slotMap_.find(key);
+			if (slot != nullptr) {
+				Entry& entry = entries_[*slot];
+				entry.value = std::forward<V>(value);
+				entry.referenced.store(1, std::memory_order_relaxed);
+				return;
+			}
+
+			size_t index;
+			if (!freeSlots_.empty()) {
+				index = freeSlots_.back();
+				freeSlots_.pop_back();
+			}
+			else {
+				index = size_ < static_cast<size_t>(capacity_) ? size_++ : evictSlot();
+			}
+			Entry& entry = entries_[index];
+			entry.key = key;
+			entry.value = std::forward<V>(value);
+			entry.referenced.store(0, std::memory_order_relaxed); // 新数据没有第二次机会，扫描流量进来会被优先淘汰
+			slotMap_.emplace(key, index);
+		}
+
+		template<typename K>
+		bool getInternal(const K& key, Value& value) {
+			std::shared_lock<std::shared_mutex> lock(mutex_);
+			const size_t* slot = slotMap_.find(key);
+			if (slot == nullptr)
+				return false;
+			readEntry(entries_[*slot], value);
+			return true;
+		}
+
+		static void readEntry(Entry& entry, Value& value) { // 调用方至少持有共享锁
+			if (entry.referenced.load(std::memory_order_relaxed) == 0) { // 已经置位就不再写，热点key的槽位不会被反复写脏
+				entry.referenced.store(1, std::memory_order_relaxed);
+			}
+			value = entry.value;
+		}
+
+		size_t evictSlot() { // 调用方持有独占锁；最多扫两圈一定能找到引用位为0的槽位
+			while (true) {
+				Entry& entry = entries_[hand_];
+				size_t index = hand_;
+				hand_ = (hand_ + 1) % static_cast<size_t>(capacity_);
+				if (entry.referenced.load(std::memory_order_relaxed) != 0) {
+					entry.referenced.store(0, std::memory_order_relaxed);
+					continue;
+				}
+				slotMap_.erase(entry.key);
+				removals_.push(entry.key, std::move(entry.value), MyRemovalCause::kEvicted);
+				return index;
+			}
+		}
+
+		void releaseEntry(Entry& entry, MyRemovalCause cause) { // 槽位变空：value交给通知队列或直接释放，引用位清零
+			removals_.push(entry.key, std::move(entry.value), cause);
+			entry.key = Key();
+			entry.value = Value();
+			entry.referenced.store(0, std::memory_order_relaxed);
+		}
+	};
+
+}
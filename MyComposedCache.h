@@ -0,0 +1,723 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+#include "MyCachePolicy.h"
+#include "MyCacheStats.h"
+#include "MyFlatIndex.h"
+#include "MyFrequencySketch.h"
+#include "MyHash.h"
+#include "MyNodePool.h"
+#include "MyRemovalQueue.h"
+
+namespace MyCache {
+
+	// 编译期组合的缓存：淘汰策略、准入策略、索引、节点存储、锁都是模板参数，调用之间没有虚函数，整条路径都能内联。
+	// 需要运行时多态的地方用MyPolicyAdapter包成MyCachePolicy。
+	//
+	// 淘汰策略Eviction（不需要继承，满足下面的接口即可）：
+	//   struct Hook;                              嵌进每个节点的字段，节点从Hook派生
+	//   explicit Eviction(size_t capacity);
+	//   void  onMiss(const Key& key);             新key插入前调用，ARC据此调整目标
+	//   Hook* victim();                           缓存满时下一个淘汰的节点，不摘下
+	//   void  onInsert(Hook* hook);               新节点插入后调用
+	//   void  onAccess(Hook* hook);               命中或更新已有key
+	//   void  onEvict(Hook* hook, const Key& key); 因容量淘汰，ARC据此留下幽灵key
+	//   void  onErase(Hook* hook);                显式删除
+	//   void  clear();                            节点由缓存统一释放，这里只重置链表
+	// 准入策略Admission：
+	//   explicit Admission(size_t capacity);
+	//   void onAccess(const Key& key);            每次get/put都调用
+	//   void onMiss(const Key& key);              get未命中时调用
+	//   bool admit(const Key& candidate, const Key* victim); 新key插入前调用，victim为空表示还有空位；返回false就不插入
+
+	// 不加锁，单线程使用或外层已经串行化时代替std::mutex
+	struct MyNullMutex {
+		bool try_lock() { return true; }
+		void lock() {}
+		void unlock() {}
+	};
+
+	// ---- 淘汰策略 ----
+
+	// LRU：一条带哨兵的双向链表，head.next是最近使用端
+	template<typename Key>
+	class MyLruEviction {
+	public:
+		struct Hook {
+			Hook* prev = nullptr;
+			Hook* next = nullptr;
+		};
+
+	private:
+		Hook head_;
+
+	public:
+		explicit MyLruEviction(size_t) { head_.prev = head_.next = &head_; }
+
+		MyLruEviction(const MyLruEviction&) = delete;
+		MyLruEviction& operator=(const MyLruEviction&) = delete;
+
+		void onMiss(const Key&) {}
+		Hook* victim() { return head_.prev; }
+		void onInsert(Hook* hook) { linkFront(hook); }
+
+		void onAccess(Hook* hook) {
+			if (head_.next == hook)
+				return; // 已在最近使用端
+			unlink(hook);
+			linkFront(hook);
+		}
+
+		void onEvict(Hook* hook, const Key&) { unlink(hook); }
+		void onErase(Hook* hook) { unlink(hook); }
+		void clear() { head_.prev = head_.next = &head_; }
+
+	private:
+		static void unlink(Hook* hook) {
+			hook->prev->next = hook->next;
+			hook->next->prev = hook->prev;
+		}
+
+		void linkFront(Hook* hook) {
+			hook->prev = &head_;
+			hook->next = head_.next;
+			head_.next->prev = hook;
+			head_.next = hook;
+		}
+	};
+
+	// LFU：按频次升序排列的桶，每个桶里按LRU排，命中时挪到频次+1的桶，全部O(1)。
+	// 不做老化，早期的热点会一直占着高频桶；需要老化和ttl时用MyLfuCache
+	template<typename Key>
+	class MyLfuEviction {
+	public:
+		struct Bucket;
+
+		struct Hook {
+			Hook*   prev = nullptr;
+			Hook*   next = nullptr;
+			Bucket* bucket = nullptr;
+		};
+
+		struct Bucket {
+			size_t  freq = 0;
+			Bucket* prev = this;
+			Bucket* next = this;
+			Hook    head; // 桶内链表的哨兵，head.next是桶内最近访问的
+
+			Bucket() { head.prev = head.next = &head; }
+		};
+
+	private:
+		Bucket             head_; // 桶链表的哨兵，head_.next是频次最小的桶
+		MyNodePool<Bucket> buckets_;
+
+	public:
+		explicit MyLfuEviction(size_t) {}
+
+		~MyLfuEviction() { clear(); }
+
+		MyLfuEviction(const MyLfuEviction&) = delete;
+		MyLfuEviction& operator=(const MyLfuEviction&) = delete;
+
+		void onMiss(const Key&) {}
+
+		Hook* victim() { return head_.next->head.prev; } // 最小频次桶里最久未访问的
+
+		void onInsert(Hook* hook) {
+			Bucket* first = head_.next;
+			if (first == &head_ || first->freq != 1)
+				first = insertBucketAfter(&head_, 1);
+			linkFront(first, hook);
+		}
+
+		void onAccess(Hook* hook) {
+			Bucket* bucket = hook->bucket;
+			Bucket* target = bucket->next;
+			if (target == &head_ || target->freq != bucket->freq + 1)
+				target = insertBucketAfter(bucket, bucket->freq + 1);
+			unlink(hook);
+			linkFront(target, hook);
+		}
+
+		void onEvict(Hook* hook, const Key&) { unlink(hook); }
+		void onErase(Hook* hook) { unlink(hook); }
+
+		void clear() {
+			Bucket* bucket = head_.next;
+			while (bucket != &head_) {
+				Bucket* next = bucket->next;
+				buckets_.deallocate(bucket);
+				bucket = next;
+			}
+			head_.prev = head_.next = &head_;
+		}
+
+	private:
+		Bucket* insertBucketAfter(Bucket* prev, size_t freq) {
+			Bucket* bucket = buckets_.allocate();
+			bucket->freq = freq;
+			bucket->prev = prev;
+			bucket->next = prev->next;
+			prev->next->prev = bucket;
+			prev->next = bucket;
+			return bucket;
+		}
+
+		static void linkFront(Bucket* bucket, Hook* hook) {
+			hook->bucket = bucket;
+			hook->prev = &bucket->head;
+			hook->next = bucket->head.next;
+			bucket->head.next->prev = hook;
+			bucket->head.next = hook;
+		}
+
+		void unlink(Hook* hook) { // 桶空了就回收
+			hook->prev->next = hook->next;
+			hook->next->prev = hook->prev;
+			Bucket* bucket = hook->bucket;
+			if (bucket->head.next == &bucket->head) {
+				bucket->prev->next = bucket->next;
+				bucket->next->prev = bucket->prev;
+				buckets_.deallocate(bucket);
+			}
+		}
+	};
+
+	// ARC：T1放只访问过一次的，T2放至少两次的；淘汰下来的key留在幽灵链表B1/B2里，命中幽灵时调整T1的目标大小p_。
+	// 幽灵key有自己的索引和节点池，合计不超过capacity个
+	template<typename Key, template<typename...> class Index = MyFlatIndex>
+	class MyArcEviction {
+	public:
+		struct Hook {
+			Hook*   prev = nullptr;
+			Hook*   next = nullptr;
+			uint8_t list = 0;
+		};
+
+	private:
+		enum ListId : uint8_t { kT1, kT2, kB1 = 0, kB2 = 1 };
+
+		struct Ghost {
+			Key     key;
+			Ghost*  prev;
+			Ghost*  next;
+			uint8_t list;
+
+			Ghost() :key(), prev(this), next(this), list(kB1) {}
+			explicit Ghost(const Key& k) :key(k), prev(nullptr), next(nullptr), list(kB1) {}
+		};
+
+		size_t                 capacity_;
+		size_t                 p_; // T1的目标大小
+		Hook                   lists_[2]; // T1、T2的哨兵
+		size_t                 sizes_[2] = { 0, 0 };
+		Ghost                  ghosts_[2]; // B1、B2的哨兵
+		size_t                 ghostSizes_[2] = { 0, 0 };
+		Index<Key, Ghost*>     ghostIndex_;
+		MyNodePool<Ghost>      ghostPool_;
+		bool                   fromGhost_ = false; // 正在插入的key刚命中过幽灵，直接进T2
+		bool                   fromB2_ = false;
+
+	public:
+		explicit MyArcEviction(size_t capacity) :capacity_(capacity), p_(0), ghostIndex_(capacity), ghostPool_(capacity + 1) {
+			for (Hook& list : lists_) list.prev = list.next = &list;
+		}
+
+		~MyArcEviction() { clearGhosts(); }
+
+		MyArcEviction(const MyArcEviction&) = delete;
+		MyArcEviction& operator=(const MyArcEviction&) = delete;
+
+		void onMiss(const Key& key) {
+			fromGhost_ = fromB2_ = false;
+			Ghost** it = ghostIndex_.find(key);
+			if (it == nullptr)
+				return;
+			Ghost* ghost = *it;
+			if (ghost->list == kB1) { // T1给小了
+				size_t delta = std::max<size_t>(ghostSizes_[kB2] / std::max<size_t>(ghostSizes_[kB1], 1), 1);
+				p_ = std::min(capacity_, p_ + delta);
+			}
+			else { // T2给小了
+				size_t delta = std::max<size_t>(ghostSizes_[kB1] / std::max<size_t>(ghostSizes_[kB2], 1), 1);
+				p_ = p_ > delta ? p_ - delta : 0;
+				fromB2_ = true;
+			}
+			fromGhost_ = true;
+			dropGhost(ghost);
+		}
+
+		Hook* victim() { // ARC的REPLACE：T1超过目标（或者刚命中B2且T1正好等于目标）时淘汰T1，否则淘汰T2
+			bool fromT1 = sizes_[kT1] > 0 && (sizes_[kT1] > p_ || (fromB2_ && sizes_[kT1] == p_) || sizes_[kT2] == 0);
+			return lists_[fromT1 ? kT1 : kT2].prev;
+		}
+
+		void onInsert(Hook* hook) {
+			linkFront(hook, fromGhost_ ? kT2 : kT1);
+			fromGhost_ = fromB2_ = false;
+		}
+
+		void onAccess(Hook* hook) {
+			if (hook->list == kT2 && lists_[kT2].next == hook)
+				return;
+			unlink(hook);
+			linkFront(hook, kT2);
+		}
+
+		void onEvict(Hook* hook, const Key& key) {
+			uint8_t list = hook->list;
+			unlink(hook);
+			Ghost* ghost = ghostPool_.allocate(key);
+			ghost->list = list; // T1淘汰进B1，T2淘汰进B2
+			linkGhost(ghost);
+			ghostIndex_.emplace(key, ghost, ghostIndex_.hash(key));
+			while (ghostSizes_[kB1] + ghostSizes_[kB2] > capacity_) { // T1+B1超过容量时从B1丢，否则从B2丢
+				uint8_t from = ghostSizes_[kB1] > 0 && (sizes_[kT1] + ghostSizes_[kB1] > capacity_ || ghostSizes_[kB2] == 0) ? kB1 : kB2;
+				dropGhost(ghosts_[from].prev);
+			}
+		}
+
+		void onErase(Hook* hook) { unlink(hook); }
+
+		void clear() {
+			for (Hook& list : lists_) list.prev = list.next = &list;
+			sizes_[kT1] = sizes_[kT2] = 0;
+			clearGhosts();
+			p_ = 0;
+		}
+
+		size_t target() const { return p_; }
+
+	private:
+		void unlink(Hook* hook) {
+			hook->prev->next = hook->next;
+			hook->next->prev = hook->prev;
+			sizes_[hook->list]--;
+		}
+
+		void linkFront(Hook* hook, uint8_t list) {
+			Hook& head = lists_[list];
+			hook->list = list;
+			hook->prev = &head;
+			hook->next = head.next;
+			head.next->prev = hook;
+			head.next = hook;
+			sizes_[list]++;
+		}
+
+		void linkGhost(Ghost* ghost) {
+			Ghost& head = ghosts_[ghost->list];
+			ghost->prev = &head;
+			ghost->next = head.next;
+			head.next->prev = ghost;
+			head.next = ghost;
+			ghostSizes_[ghost->list]++;
+		}
+
+		void dropGhost(Ghost* ghost) {
+			ghost->prev->next = ghost->next;
+			ghost->next->prev = ghost->prev;
+			ghostSizes_[ghost->list]--;
+			ghostIndex_.erase(ghost->key, ghostIndex_.hash(ghost->key));
+			ghostPool_.deallocate(ghost);
+		}
+
+		void clearGhosts() {
+			for (Ghost& head : ghosts_) {
+				Ghost* ghost = head.next;
+				while (ghost != &head) {
+					Ghost* next = ghost->next;
+					ghostPool_.deallocate(ghost);
+					ghost = next;
+				}
+				head.prev = head.next = &head;
+			}
+			ghostSizes_[kB1] = ghostSizes_[kB2] = 0;
+			ghostIndex_.clear();
+		}
+	};
+
+	// ---- 准入策略 ----
+
+	template<typename Key>
+	struct MyAdmitAll { // 不做准入，空函数全部内联掉
+		explicit MyAdmitAll(size_t) {}
+		void onAccess(const Key&) {}
+		void onMiss(const Key&) {}
+		bool admit(const Key&, const Key*) { return true; }
+	};
+
+	// LRU-K准入：不在缓存里的key的访问次数记在一个按LRU淘汰的历史队列里（容量同缓存），第K次put才放行，同MyKLruCache
+	template<typename Key, int K = 2, template<typename...> class Index = MyFlatIndex>
+	class MyLruKAdmission {
+	private:
+		struct Record {
+			Key     key;
+			size_t  count;
+			Record* prev;
+			Record* next;
+
+			Record() :key(), count(0), prev(this), next(this) {}
+			explicit Record(const Key& k) :key(k), count(0), prev(nullptr), next(nullptr) {}
+		};
+
+		size_t              capacity_;
+		Record              head_;
+		Index<Key, Record*> index_;
+		MyNodePool<Record>  pool_;
+
+	public:
+		explicit MyLruKAdmission(size_t capacity) :capacity_(capacity), index_(capacity), pool_(capacity + 1) {}
+
+		~MyLruKAdmission() {
+			Record* record = head_.next;
+			while (record != &head_) {
+				Record* next = record->next;
+				pool_.deallocate(record);
+				record = next;
+			}
+		}
+
+		MyLruKAdmission(const MyLruKAdmission&) = delete;
+		MyLruKAdmission& operator=(const MyLruKAdmission&) = delete;
+
+		void onAccess(const Key&) {}
+
+		void onMiss(const Key& key) { // 未命中只记一次，真正入缓存要等put
+			recordAccess(key, index_.hash(key));
+		}
+
+		bool admit(const Key& key, const Key*) {
+			uint64_t h = index_.hash(key);
+			Record* record = recordAccess(key, h);
+			if (record == nullptr)
+				return true; // 历史队列容量为0，直接放行
+			if (record->count < static_cast<size_t>(K))
+				return false;
+			remove(record, h);
+			return true;
+		}
+
+	private:
+		Record* recordAccess(const Key& key, uint64_t h) { // 次数+1，不存在就以1插入
+			if (capacity_ == 0)
+				return nullptr;
+			Record** it = index_.find(key, h);
+			Record* record;
+			if (it != nullptr) {
+				record = *it;
+				unlink(record);
+			}
+			else {
+				if (index_.size() >= capacity_) {
+					Record* oldest = head_.prev;
+					remove(oldest, index_.hash(oldest->key));
+				}
+				record = pool_.allocate(key);
+				index_.emplace(key, record, h);
+			}
+			record->count++;
+			linkFront(record);
+			return record;
+		}
+
+		void remove(Record* record, uint64_t h) {
+			unlink(record);
+			index_.erase(record->key, h);
+			pool_.deallocate(record);
+		}
+
+		static void unlink(Record* record) {
+			record->prev->next = record->next;
+			record->next->prev = record->prev;
+		}
+
+		void linkFront(Record* record) {
+			record->prev = &head_;
+			record->next = head_.next;
+			head_.next->prev = record;
+			head_.next = record;
+		}
+	};
+
+	// TinyLFU准入：每次访问记进频次sketch，缓存满时候选者的估计频次要高于淘汰者才放行，一次性访问的key挤不掉热点
+	template<typename Key, typename Hash = MyDefaultHash<Key>>
+	class MyTinyLfuAdmission {
+	private:
+		MyFrequencySketch sketch_;
+		Hash              hash_;
+
+	public:
+		explicit MyTinyLfuAdmission(size_t capacity) :sketch_(capacity) {}
+
+		void onAccess(const Key& key) { sketch_.increment(static_cast<uint64_t>(hash_(key))); }
+		void onMiss(const Key&) {}
+
+		bool admit(const Key& candidate, const Key* victim) {
+			return victim == nullptr || frequency(candidate) > frequency(*victim);
+		}
+
+		int frequency(const Key& key) const { return sketch_.frequency(static_cast<uint64_t>(hash_(key))); }
+	};
+
+	// ---- 缓存 ----
+
+	// 不从MyCachePolicy派生：接口名字一样，但都是普通成员函数。Storage<Node>需要提供allocate(args...)/deallocate(node)，
+	// 例如MyNodePool、MyHeapStorage。例如：
+	//   MyComposedCache<int, std::string, MyArcEviction<int>, MyTinyLfuAdmission<int>> cache(1000);
+	template<typename Key, typename Value,
+		typename Eviction = MyLruEviction<Key>,
+		typename Admission = MyAdmitAll<Key>,
+		template<typename...> class Index = MyFlatIndex,
+		template<typename> class Storage = MyNodePool,
+		typename Mutex = std::mutex>
+	class MyComposedCache {
+	public:
+		using KeyType = Key;
+		using ValueType = Value;
+
+	private:
+		using Hook = typename Eviction::Hook;
+
+		struct Node :Hook {
+			Key   key;
+			Value value;
+
+			template<typename... Args>
+			explicit Node(const Key& k, Args&&... args) :Hook(), key(k), value(std::forward<Args>(args)...) {}
+		};
+
+		using NodePtr = Node*;
+		using Lock = MyNotifyingLock<Mutex, Key, Value>;
+
+		size_t                     capacity_;
+		Eviction                   eviction_;
+		Admission                  admission_;
+		Index<Key, NodePtr>        index_;
+		Storage<Node>              storage_;
+		Mutex                      mutex_;
+		MyStatsCounter             stats_;
+		MyRemovalQueue<Key, Value> removals_;
+
+	public:
+		// 按容量一次性预留索引和节点，先淘汰再分配，节点数不会超过容量
+		explicit MyComposedCache(size_t capacity)
+			:capacity_(capacity), eviction_(capacity), admission_(capacity), index_(capacity), storage_(capacity) {}
+
+		~MyComposedCache() { releaseAll(); } // 析构不发移除通知
+
+		MyComposedCache(const MyComposedCache&) = delete;
+		MyComposedCache& operator=(const MyComposedCache&) = delete;
+
+		void put(const Key& key, const Value& value) { putInternal(key, value); }
+
+		void put(const Key& key, Value&& value) { putInternal(key, std::move(value)); }
+
+		template<typename... Args>
+		void emplace(const Key& key, Args&&... args) { putInternal(key, std::forward<Args>(args)...); }
+
+		bool get(const Key& key, Value& value) {
+			Lock lock(mutex_, stats_, removals_);
+			return getLocked(key, index_.hash(key), value);
+		}
+
+		Value get(const Key& key) {
+			Value value{};
+			get(key, value);
+			return value;
+		}
+
+		// 批量读：整批只加一次锁，每kBatchChunk个key先算hash并预取索引，再依次探测
+		size_t getMany(const Key* keys, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) {
+			size_t hitCount = 0;
+			uint64_t hashes[detail::kBatchChunk];
+			Lock lock(mutex_, stats_, removals_);
+			for (size_t base = 0; base < count; base += detail::kBatchChunk) {
+				size_t n = std::min(detail::kBatchChunk, count - base);
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = index_.hash(keys[detail::batchIndex(indices, base + i)]);
+					index_.prefetch(hashes[i]);
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t idx = detail::batchIndex(indices, base + i);
+					hits[idx] = getLocked(keys[idx], hashes[i], values[idx]);
+					if (hits[idx]) hitCount++;
+				}
+			}
+			return hitCount;
+		}
+
+		void putMany(const Key* keys, const Value* values, size_t count, const uint32_t* indices = nullptr) {
+			if (capacity_ == 0)return;
+
+			uint64_t hashes[detail::kBatchChunk];
+			Lock lock(mutex_, stats_, removals_);
+			for (size_t base = 0; base < count; base += detail::kBatchChunk) {
+				size_t n = std::min(detail::kBatchChunk, count - base);
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = index_.hash(keys[detail::batchIndex(indices, base + i)]);
+					index_.prefetch(hashes[i]);
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t idx = detail::batchIndex(indices, base + i);
+					putLocked(keys[idx], hashes[i], values[idx]);
+				}
+			}
+		}
+
+		bool erase(const Key& key) {
+			Lock lock(mutex_, stats_, removals_);
+			uint64_t h = index_.hash(key);
+			NodePtr* it = index_.find(key, h);
+			if (it == nullptr)
+				return false;
+			NodePtr node = *it;
+			eviction_.onErase(node);
+			removeNode(node, h, MyRemovalCause::kExplicit);
+			return true;
+		}
+
+		void clear() { // 准入策略的历史/频次保留，清空后热点key仍然更容易被接纳
+			Lock lock(mutex_, stats_, removals_);
+			if (removals_.active()) {
+				index_.forEach([this](const Key&, NodePtr& node) {
+					removals_.push(node->key, std::move(node->value), MyRemovalCause::kExplicit);
+				});
+			}
+			releaseAll();
+			index_.clear();
+			eviction_.clear();
+		}
+
+		bool contains(const Key& key) { // 只查不动淘汰顺序，不算一次访问
+			Lock lock(mutex_, stats_, removals_);
+			return index_.find(key) != nullptr;
+		}
+
+		size_t size() {
+			Lock lock(mutex_, stats_, removals_);
+			return index_.size();
+		}
+
+		size_t capacity() const { return capacity_; }
+
+		MyCacheStats stats() const { // 不加锁
+			return stats_.snapshot();
+		}
+
+		// 条目被淘汰或删除时的回调，在解锁后调用；没被准入的新key也算一次淘汰
+		void setEvictionListener(MyEvictionListener<Key, Value> listener) {
+			Lock lock(mutex_, stats_, removals_);
+			removals_.setListener(std::move(listener));
+		}
+
+	private:
+		template<typename... Args>
+		void putInternal(const Key& key, Args&&... args) {
+			if (capacity_ == 0)return;
+
+			Lock lock(mutex_, stats_, removals_);
+			putLocked(key, index_.hash(key), std::forward<Args>(args)...);
+		}
+
+		bool getLocked(const Key& key, uint64_t h, Value& value) { // 调用方持有mutex_
+			admission_.onAccess(key);
+			NodePtr* it = index_.find(key, h);
+			if (it == nullptr) {
+				admission_.onMiss(key);
+				stats_.miss();
+				return false;
+			}
+			eviction_.onAccess(*it);
+			value = (*it)->value;
+			stats_.hit();
+			return true;
+		}
+
+		template<typename... Args>
+		void putLocked(const Key& key, uint64_t h, Args&&... args) { // 调用方持有mutex_
+			stats_.put();
+			admission_.onAccess(key);
+			NodePtr* it = index_.find(key, h);
+			if (it != nullptr) {
+				assignValue((*it)->value, std::forward<Args>(args)...);
+				eviction_.onAccess(*it);
+				return;
+			}
+
+			eviction_.onMiss(key);
+			NodePtr victim = index_.size() >= capacity_ ? static_cast<NodePtr>(eviction_.victim()) : nullptr;
+			if (!admission_.admit(key, victim != nullptr ? &victim->key : nullptr)) {
+				if (removals_.active())
+					removals_.push(key, Value(std::forward<Args>(args)...), MyRemovalCause::kEvicted);
+				return;
+			}
+			if (victim != nullptr) {
+				eviction_.onEvict(victim, victim->key);
+				removeNode(victim, index_.hash(victim->key), MyRemovalCause::kEvicted);
+				stats_.eviction();
+			}
+			NodePtr node = storage_.allocate(key, std::forward<Args>(args)...);
+			index_.emplace(key, node, h);
+			eviction_.onInsert(node);
+		}
+
+		template<typename V>
+		static void assignValue(Value& target, V&& value) { target = std::forward<V>(value); }
+
+		template<typename... Args>
+		static void assignValue(Value& target, Args&&... args) { target = Value(std::forward<Args>(args)...); }
+
+		void removeNode(NodePtr node, uint64_t h, MyRemovalCause cause) { // 节点已经从淘汰策略里摘下
+			if (removals_.active())
+				removals_.push(node->key, std::move(node->value), cause);
+			index_.erase(node->key, h);
+			storage_.deallocate(node);
+		}
+
+		void releaseAll() { // 节点全部还给存储，不动索引
+			index_.forEach([this](const Key&, NodePtr& node) { storage_.deallocate(node); });
+		}
+	};
+
+	// 把编译期组合的缓存包成MyCachePolicy，给需要运行时多态的代码用；热路径上直接用被包的类型就没有虚调用
+	template<typename Cache>
+	class MyPolicyAdapter final :public MyCachePolicy<typename Cache::KeyType, typename Cache::ValueType> {
+	private:
+		using Key = typename Cache::KeyType;
+		using Value = typename Cache::ValueType;
+
+		Cache cache_;
+
+	public:
+		// args原样传给Cache的构造函数
+		template<typename... Args>
+		explicit MyPolicyAdapter(Args&&... args) :cache_(std::forward<Args>(args)...) {}
+
+		void put(const Key& key, const Value& value) override { cache_.put(key, value); }
+		void put(const Key& key, Value&& value) override { cache_.put(key, std::move(value)); }
+		Value get(const Key& key) override { return cache_.get(key); }
+		bool get(const Key& key, Value& value) override { return cache_.get(key, value); }
+		bool erase(const Key& key) override { return cache_.erase(key); }
+		void clear() override { cache_.clear(); }
+		bool contains(const Key& key) override { return cache_.contains(key); }
+		size_t size() override { return cache_.size(); }
+
+		size_t getMany(const Key* keys, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) override {
+			return cache_.getMany(keys, count, values, hits, indices);
+		}
+
+		void putMany(const Key* keys, const Value* values, size_t count, const uint32_t* indices = nullptr) override {
+			cache_.putMany(keys, values, count, indices);
+		}
+
+		Cache& cache() { return cache_; }
+	};
+
+}
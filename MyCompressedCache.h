@@ -0,0 +1,410 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MyCachePolicy.h"
+
+namespace MyCache {
+
+	// 内置的值压缩编解码：LZ4风格的字节块格式，单遍贪心匹配，没有外部依赖。
+	// 几百字节的JSON单独压缩时字段名、公共片段都只出现一次，没什么可匹配的；构造时给一段预置字典（几条典型value拼起来），
+	// 匹配就可以引用字典里的内容，小value也能压到几分之一。字典只在构造时给定，编码和解码必须用同一份。
+	// 换成zstd/lz4等库时提供同样的两个const成员函数即可：compress把压缩结果追加到out；decompress按已知的原长度解到dst，数据损坏返回false。原长度超过压缩字节数255倍的记录不交给decompress，直接按损坏处理
+	class MyLzCodec {
+	public:
+		static constexpr size_t kMinMatch = 4;
+		static constexpr size_t kMaxOffset = 65535;
+
+	private:
+		static constexpr unsigned kDictBits = 14;
+
+		std::string           dictionary_; // 超过kMaxOffset的部分只保留末尾
+		std::vector<uint32_t> dictTable_; // 字典里每个4字节序列最后出现的位置，构造后只读，多线程共用
+
+	public:
+		MyLzCodec() = default;
+
+		explicit MyLzCodec(std::string dictionary) :dictionary_(std::move(dictionary)) {
+			if (dictionary_.size() > kMaxOffset)
+				dictionary_.erase(0, dictionary_.size() - kMaxOffset);
+			if (dictionary_.size() < kMinMatch)
+				return;
+			dictTable_.assign(size_t(1) << kDictBits, UINT32_MAX);
+			const unsigned char* dict = reinterpret_cast<const unsigned char*>(dictionary_.data());
+			for (size_t i = 0; i + kMinMatch <= dictionary_.size(); i++) {
+				dictTable_[hashSeq(read32(dict + i), kDictBits)] = static_cast<uint32_t>(i);
+			}
+		}
+
+		const std::string& dictionary() const { return dictionary_; }
+
+		void compress(const char* data, size_t size, std::string& out) const {
+			const unsigned char* src = reinterpret_cast<const unsigned char*>(data);
+			const unsigned char* dict = reinterpret_cast<const unsigned char*>(dictionary_.data());
+			size_t dictSize = dictionary_.size();
+			unsigned bits = 8; // 哈希表随输入变大，小value不用清一张大表
+			while (bits < 12 && (size_t(1) << bits) < size) bits++;
+			uint32_t table[1 << 12];
+			std::memset(table, 0xff, sizeof(uint32_t) << bits);
+
+			size_t anchor = 0;
+			size_t i = 0;
+			while (i + kMinMatch <= size) {
+				uint32_t seq = read32(src + i);
+				uint32_t& slot = table[hashSeq(seq, bits)];
+				size_t candidate = slot;
+				slot = static_cast<uint32_t>(i);
+				size_t offset = 0;
+				size_t length = 0;
+				if (candidate < i && i - candidate <= kMaxOffset && read32(src + candidate) == seq) {
+					length = kMinMatch;
+					while (i + length < size && src[candidate + length] == src[i + length]) length++;
+					offset = i - candidate;
+				}
+				else if (!dictTable_.empty()) { // value自己里面没有，再到字典里找；字典里的匹配不跨过字典末尾
+					size_t from = dictTable_[hashSeq(seq, kDictBits)];
+					if (from != UINT32_MAX && i + dictSize - from <= kMaxOffset && read32(dict + from) == seq) {
+						length = kMinMatch;
+						while (i + length < size && from + length < dictSize && dict[from + length] == src[i + length]) length++;
+						offset = i + dictSize - from;
+					}
+				}
+				if (offset != 0) {
+					emitSequence(src + anchor, i - anchor, offset, length, out);
+					i += length;
+					anchor = i;
+				}
+				else {
+					i += 1 + ((i - anchor) >> 6); // 长时间找不到匹配就越跳越快，不可压的数据不至于逐字节哈希
+				}
+			}
+			emitSequence(src + anchor, size - anchor, 0, 0, out); // 最后一段只有字面量
+		}
+
+		bool decompress(const char* data, size_t size, char* dst, size_t rawSize) const {
+			const unsigned char* ip = reinterpret_cast<const unsigned char*>(data);
+			const unsigned char* end = ip + size;
+			size_t op = 0;
+			for (;;) {
+				if (ip == end)
+					return false;
+				unsigned token = *ip++;
+				size_t literals = token >> 4;
+				if (literals == 15 && !readLength(ip, end, literals))
+					return false;
+				if (literals > static_cast<size_t>(end - ip) || literals > rawSize - op)
+					return false;
+				std::memcpy(dst + op, ip, literals);
+				ip += literals;
+				op += literals;
+				if (op == rawSize)
+					return ip == end;
+				if (end - ip < 2)
+					return false;
+				size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+				ip += 2;
+				size_t length = token & 15;
+				if (length == 15 && !readLength(ip, end, length))
+					return false;
+				length += kMinMatch;
+				if (offset == 0 || length > rawSize - op)
+					return false;
+				char* out = dst + op;
+				if (offset > op) { // 引用字典，整段都要落在字典里
+					size_t back = offset - op;
+					if (back > dictionary_.size() || length > back)
+						return false;
+					std::memcpy(out, dictionary_.data() + dictionary_.size() - back, length);
+				}
+				else if (offset >= length) {
+					std::memcpy(out, out - offset, length);
+				}
+				else { // 重叠：前offset字节是一个周期，每拷一段已写出的周期长度就翻倍，offset为1的长串也只要几次memcpy
+					for (size_t k = 0, period = offset; k < length; k += period, period *= 2) {
+						std::memcpy(out + k, out + k - period, std::min(period, length - k));
+					}
+				}
+				op += length;
+			}
+		}
+
+	private:
+		static uint32_t read32(const unsigned char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+		static size_t hashSeq(uint32_t seq, unsigned bits) { return (seq * 2654435761u) >> (32 - bits); }
+
+		static void writeLength(size_t length, std::string& out) { // token里放不下的部分：若干个255加一个余数
+			while (length >= 255) {
+				out.push_back(static_cast<char>(255));
+				length -= 255;
+			}
+			out.push_back(static_cast<char>(length));
+		}
+
+		static bool readLength(const unsigned char*& ip, const unsigned char* end, size_t& length) {
+			unsigned char byte;
+			do {
+				if (ip == end)
+					return false;
+				byte = *ip++;
+				length += byte;
+			} while (byte == 255);
+			return true;
+		}
+
+		// 一个序列：token(字面量长度4位|匹配长度-4的4位)、字面量、2字节偏移、匹配长度。offset为0表示最后一段，不写偏移。
+		// 偏移大于已解出的长度时指向字典，从字典末尾往前数
+		static void emitSequence(const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength, std::string& out) {
+			size_t matchCode = offset != 0 ? matchLength - kMinMatch : 0;
+			out.push_back(static_cast<char>((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchCode, 15)));
+			if (literalLength >= 15) writeLength(literalLength - 15, out);
+			out.append(reinterpret_cast<const char*>(literals), literalLength);
+			if (offset == 0)
+				return;
+			out.push_back(static_cast<char>(offset & 0xff));
+			out.push_back(static_cast<char>(offset >> 8));
+			if (matchCode >= 15) writeLength(matchCode - 15, out);
+		}
+	};
+
+	struct MyCompressionStats {
+		uint64_t puts = 0; // 经过编码写入的value个数
+		uint64_t compressed = 0; // 其中以压缩形式存下的个数（低于阈值或压不小的原样存）
+		uint64_t rawBytes = 0; // 写入前的value总字节数
+		uint64_t storedBytes = 0; // 实际存下的总字节数，含每条1字节的格式标记和原长度
+		uint64_t corrupt = 0; // get时解压失败、按未命中处理的次数
+	};
+
+	// 值压缩前端：std::string的value不小于threshold字节时，put先用Codec压缩再交给Cache，get把Cache里的字节解压到调用方的value里。
+	// Cache是value类型为std::string的任意策略（MyLruCache<Key, std::string>、MyShardedCache……），存的是编码后的字节：
+	// 第1个字节标记原样/压缩，压缩的再跟变长编码的原长度。Cache带上bytesWeigher()时容量按编码后的字节数计，同样的预算能多放几倍条目。
+	// 压缩、解压都在Cache的锁外进行，锁内只拷贝压缩后的字节。对Cache的读写都必须经过这里，直接写cache()的值不是这个格式
+	template<typename Key, typename Cache, typename Codec = MyLzCodec>
+	class MyCompressedCache :public MyCachePolicy<Key, std::string> {
+	private:
+		enum Tag : char {
+			kRaw = 0,
+			kCompressed = 1,
+		};
+
+		// 每个压缩字节最多解出多少字节：LZ4格式的长度每多一个字节最多加255。记录的原长度超过它就是坏数据，不照着去分配内存
+		static constexpr size_t kMaxRatio = 255;
+
+		Cache                 cache_;
+		Codec                 codec_;
+		size_t                threshold_;
+		std::atomic<uint64_t> puts_{ 0 };
+		std::atomic<uint64_t> compressed_{ 0 };
+		std::atomic<uint64_t> rawBytes_{ 0 };
+		std::atomic<uint64_t> storedBytes_{ 0 };
+		std::atomic<uint64_t> corrupt_{ 0 };
+
+	public:
+		// 按编码后的字节数算权重，传给Cache的构造函数，容量就成了压缩后的字节预算
+		static MyWeigher<Key, std::string> bytesWeigher() {
+			return [](const Key&, const std::string& stored) { return stored.size(); };
+		}
+
+		// threshold以下的value不压缩（短value压缩省不了几个字节，还要多付压缩和解压的时间）；cacheArgs原样传给Cache的构造函数
+		template<typename... CacheArgs>
+		explicit MyCompressedCache(size_t threshold, CacheArgs&&... cacheArgs)
+			:cache_(std::forward<CacheArgs>(cacheArgs)...), threshold_(threshold) {}
+
+		// 带配置好的编解码器，例如MyLzCodec(dictionary)
+		template<typename... CacheArgs>
+		MyCompressedCache(Codec codec, size_t threshold, CacheArgs&&... cacheArgs)
+			:cache_(std::forward<CacheArgs>(cacheArgs)...), codec_(std::move(codec)), threshold_(threshold) {}
+
+		MyCompressedCache(const MyCompressedCache&) = delete;
+		MyCompressedCache& operator=(const MyCompressedCache&) = delete;
+
+		void put(const Key& key, const std::string& value) override {
+			cache_.put(key, encode(value));
+		}
+
+		void put(const Key& key, std::string&& value) override {
+			cache_.put(key, encode(value));
+		}
+
+		std::string get(const Key& key) override {
+			std::string value;
+			get(key, value);
+			return value;
+		}
+
+		// 压缩后的字节先读进线程局部的缓冲，节点的锁只持有一次短拷贝的时间，解压直接写进value。
+		// 缓冲先移出来用完再放回：Cache在get里触发的移除回调可能再调这里，那一层拿到的是空缓冲，不会互相覆盖
+		bool get(const Key& key, std::string& value) override {
+			std::string stored = std::move(scratch());
+			bool hit = cache_.get(key, stored) && decodeCounted(stored, value);
+			scratch() = std::move(stored);
+			return hit;
+		}
+
+		size_t getMany(const Key* keys, size_t count, std::string* values, bool* hits, const uint32_t* indices = nullptr) override {
+			if (indices != nullptr) // 分片缓存分组后的调用，下标是稀疏的，逐个读
+				return MyCachePolicy<Key, std::string>::getMany(keys, count, values, hits, indices);
+			std::vector<std::string> stored = takeBatchScratch(count);
+			size_t hitCount = cache_.getMany(keys, count, stored.data(), hits, nullptr);
+			for (size_t i = 0; i < count; i++) {
+				if (hits[i] && !decodeCounted(stored[i], values[i])) {
+					hits[i] = false;
+					hitCount--;
+				}
+			}
+			batchScratch() = std::move(stored);
+			return hitCount;
+		}
+
+		void putMany(const Key* keys, const std::string* values, size_t count, const uint32_t* indices = nullptr) override {
+			if (indices != nullptr) {
+				MyCachePolicy<Key, std::string>::putMany(keys, values, count, indices);
+				return;
+			}
+			std::vector<std::string> stored = takeBatchScratch(count);
+			for (size_t i = 0; i < count; i++) {
+				stored[i] = encode(values[i]);
+			}
+			cache_.putMany(keys, stored.data(), count, nullptr);
+			batchScratch() = std::move(stored);
+		}
+
+		bool erase(const Key& key) override { return cache_.erase(key); }
+
+		void clear() override { cache_.clear(); }
+
+		bool contains(const Key& key) override { return cache_.contains(key); }
+
+		size_t size() override { return cache_.size(); }
+
+		// 用户的移除回调收到的是解压后的value。Cache没有setEvictionListener时什么都不做
+		void setEvictionListener(MyEvictionListener<Key, std::string> listener) {
+			installListener(cache_, std::move(listener), 0);
+		}
+
+		MyCompressionStats compressionStats() const {
+			MyCompressionStats stats;
+			stats.puts = puts_.load(std::memory_order_relaxed);
+			stats.compressed = compressed_.load(std::memory_order_relaxed);
+			stats.rawBytes = rawBytes_.load(std::memory_order_relaxed);
+			stats.storedBytes = storedBytes_.load(std::memory_order_relaxed);
+			stats.corrupt = corrupt_.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		size_t threshold() const { return threshold_; }
+
+		const Codec& codec() const { return codec_; }
+
+		Cache& cache() { return cache_; }
+
+		// 编码格式的两端，单独拿出来给快照、落盘之类想直接存编码后字节的代码用
+		std::string encode(const std::string& value) {
+			std::string stored;
+			bool packed = false;
+			if (value.size() >= threshold_ && value.size() > 0) {
+				stored.reserve(value.size() / 2 + 16);
+				stored.push_back(kCompressed);
+				for (size_t n = value.size(); ; n >>= 7) { // 原长度，7位一组
+					if (n < 0x80) {
+						stored.push_back(static_cast<char>(n));
+						break;
+					}
+					stored.push_back(static_cast<char>((n & 0x7f) | 0x80));
+				}
+				codec_.compress(value.data(), value.size(), stored);
+				packed = stored.size() < value.size() + 1;
+			}
+			if (!packed) { // 没到阈值或者压不小，原样存
+				stored.clear();
+				stored.reserve(value.size() + 1);
+				stored.push_back(kRaw);
+				stored.append(value);
+			}
+			puts_.fetch_add(1, std::memory_order_relaxed);
+			if (packed) compressed_.fetch_add(1, std::memory_order_relaxed);
+			rawBytes_.fetch_add(value.size(), std::memory_order_relaxed);
+			storedBytes_.fetch_add(stored.size(), std::memory_order_relaxed);
+			return stored;
+		}
+
+		bool decode(const std::string& stored, std::string& value) const {
+			if (stored.empty())
+				return false;
+			if (stored[0] == kRaw) {
+				value.assign(stored, 1, std::string::npos);
+				return true;
+			}
+			if (stored[0] != kCompressed)
+				return false;
+			size_t rawSize = 0;
+			size_t pos = 1;
+			for (unsigned shift = 0; ; shift += 7) {
+				if (pos == stored.size() || shift > 56)
+					return false;
+				unsigned char byte = static_cast<unsigned char>(stored[pos++]);
+				rawSize |= static_cast<size_t>(byte & 0x7f) << shift;
+				if (byte < 0x80)
+					break;
+			}
+			size_t packedSize = stored.size() - pos;
+			if (rawSize / kMaxRatio > packedSize)
+				return false;
+			value.resize(rawSize);
+			if (codec_.decompress(stored.data() + pos, packedSize, &value[0], rawSize))
+				return true;
+			value.clear(); // 不把解了一半的内容留给调用方
+			return false;
+		}
+
+	private:
+		bool decodeCounted(const std::string& stored, std::string& value) {
+			if (decode(stored, value))
+				return true;
+			corrupt_.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		static std::string& scratch() {
+			thread_local std::string stored;
+			return stored;
+		}
+
+		static std::vector<std::string>& batchScratch() {
+			thread_local std::vector<std::string> stored;
+			return stored;
+		}
+
+		static std::vector<std::string> takeBatchScratch(size_t count) {
+			std::vector<std::string> stored = std::move(batchScratch());
+			if (stored.size() < count)
+				stored.resize(count);
+			return stored;
+		}
+
+		template<typename C>
+		auto installListener(C& cache, MyEvictionListener<Key, std::string> listener, int)
+			-> decltype(cache.setEvictionListener(std::declval<MyEvictionListener<Key, std::string>>()), void()) {
+			if (!listener) {
+				cache.setEvictionListener(nullptr);
+				return;
+			}
+			cache.setEvictionListener([this, listener = std::move(listener)](const Key& key, std::string&& stored, MyRemovalCause cause) {
+				std::string value;
+				if (decode(stored, value))
+					listener(key, std::move(value), cause);
+			});
+		}
+
+		template<typename C>
+		void installListener(C&, MyEvictionListener<Key, std::string>, long) {}
+	};
+
+}
@@ -0,0 +1,541 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "MyHash.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MYCACHE_FLAT_INDEX_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#include <xmmintrin.h>
+#endif
+
+namespace MyCache {
+
+	namespace detail {
+
+		constexpr size_t kGroupWidth = 16; // 一次探测16个控制字节
+		constexpr int8_t kCtrlEmpty = -128; // 0x80表示空槽，满槽只用低7位存放hash指纹
+		constexpr int8_t kCtrlDeleted = -2; // 只出现在搬迁中的旧表里：已搬走或已删除，探测到这里继续往后找
+
+		inline uint32_t lowestBitIndex(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return static_cast<uint32_t>(index);
+#else
+			return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+		}
+
+		inline void prefetchRead(const void* addr) {
+#if defined(_MSC_VER) && !defined(__clang__)
+			_mm_prefetch(static_cast<const char*>(addr), _MM_HINT_T0);
+#else
+			__builtin_prefetch(addr, 0, 3);
+#endif
+		}
+
+		// 16个控制字节组成的一组，SSE2下一次比较出所有匹配位置
+		class MyCtrlGroup {
+		public:
+			explicit MyCtrlGroup(const int8_t* pos) {
+#ifdef MYCACHE_FLAT_INDEX_SSE2
+				ctrl_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+#else
+				std::memcpy(ctrl_, pos, kGroupWidth);
+#endif
+			}
+
+			uint32_t match(int8_t h2) const { // 返回指纹等于h2的槽位掩码
+#ifdef MYCACHE_FLAT_INDEX_SSE2
+				return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_)));
+#else
+				uint32_t mask = 0;
+				for (size_t i = 0; i < kGroupWidth; i++) {
+					if (ctrl_[i] == h2) mask |= 1u << i;
+				}
+				return mask;
+#endif
+			}
+
+			uint32_t matchEmpty() const { return match(kCtrlEmpty); }
+
+		private:
+#ifdef MYCACHE_FLAT_INDEX_SSE2
+			__m128i ctrl_;
+#else
+			int8_t ctrl_[kGroupWidth];
+#endif
+		};
+
+	}
+
+	// 开放寻址的扁平哈希索引：控制字节数组 + 槽位数组，线性探测，删除时向后平移（没有墓碑，稳定状态下不需要重建）。
+	// 控制字节低7位是hash指纹，先用SIMD比较指纹再比较key，大多数查找只碰一条控制字节cache line和一个槽位。
+	// 字符串这类非标量key在槽位里另存一份完整hash，先比hash再比key，一次查找基本只做一次完整的key比较，搬迁时也不用重新算hash。
+	// Hash和KeyEqual都透明时支持异构查找（默认std::string的key可以直接用string_view查）。
+	// 插入时装满了不一次性rehash：分配两倍大的新表，旧表留着，之后每次emplace/erase顺带搬kMigrateBatch个旧槽位，
+	// 搬迁期间查找先查新表再查旧表，单次操作的代价和表的大小无关。find是const的，从不搬迁，可以在共享锁下并发调用
+	template<typename Key, typename Mapped, typename Hash = MyDefaultHash<Key>, typename KeyEqual = std::equal_to<>>
+	class MyFlatIndex {
+	public:
+		using hasher = Hash;
+
+	private:
+		static constexpr bool kStoreHash = detail::kCacheHash<Key>;
+
+		struct Slot :detail::MyStoredHash<kStoreHash> {
+			Key key;
+			Mapped mapped;
+
+			Slot(const Key& k, Mapped m, uint64_t h) :detail::MyStoredHash<kStoreHash>(h), key(k), mapped(std::move(m)) {}
+		};
+
+		struct alignas(Slot) SlotStorage {
+			unsigned char bytes[sizeof(Slot)];
+		};
+
+		std::unique_ptr<int8_t[]>      ctrl_; // capacity_ + kGroupWidth 个，末尾克隆开头的16个字节，跨越末尾的探测不需要分两段
+		std::unique_ptr<SlotStorage[]> slots_;
+		size_t                         capacity_; // 槽位数，2的幂
+		size_t                         mask_;
+		size_t                         size_; // 新旧两张表里的元素总数
+		std::unique_ptr<int8_t[]>      oldCtrl_; // 搬迁中的旧表，只删不插，搬完释放；为空表示不在搬迁
+		std::unique_ptr<SlotStorage[]> oldSlots_;
+		size_t                         oldCapacity_;
+		size_t                         oldSize_; // 旧表里还没搬走的元素数
+		size_t                         migrated_; // 旧表里[0, migrated_)的槽位已经搬完
+		Hash                           hash_;
+		KeyEqual                       equal_;
+
+	public:
+		explicit MyFlatIndex(size_t expected = 0, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual())
+			:capacity_(0), mask_(0), size_(0), oldCapacity_(0), oldSize_(0), migrated_(0), hash_(hash), equal_(equal) {
+			reserve(expected);
+		}
+
+		MyFlatIndex(const MyFlatIndex&) = delete;
+		MyFlatIndex& operator=(const MyFlatIndex&) = delete;
+
+		~MyFlatIndex() { destroyAll(); }
+
+		// 同一个key要做多次查找/插入/删除时，先算一次hash再传给带hash的重载，避免重复计算
+		uint64_t hash(const Key& key) const { return hashOf(key); }
+
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		uint64_t hash(const K& key) const {
+			if constexpr (kTransparent) return hashOf(key);
+			else return hashOf(static_cast<Key>(key));
+		}
+
+		Mapped* find(const Key& key) { return find(key, hashOf(key)); }
+		const Mapped* find(const Key& key) const { return find(key, hashOf(key)); }
+
+		Mapped* find(const Key& key, uint64_t h) {
+			return const_cast<Mapped*>(static_cast<const MyFlatIndex*>(this)->find(key, h));
+		}
+
+		const Mapped* find(const Key& key, uint64_t h) const {
+			const Slot* slot = findSlot(key, h);
+			return slot == nullptr ? nullptr : &slot->mapped;
+		}
+
+		// 异构查找；Hash/KeyEqual不透明时退化为先构造Key
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		Mapped* find(const K& key) {
+			return const_cast<Mapped*>(static_cast<const MyFlatIndex*>(this)->find(key));
+		}
+
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		const Mapped* find(const K& key) const { return find(key, hash(key)); }
+
+		// h必须是hash(key)的结果
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		Mapped* find(const K& key, uint64_t h) {
+			return const_cast<Mapped*>(static_cast<const MyFlatIndex*>(this)->find(key, h));
+		}
+
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		const Mapped* find(const K& key, uint64_t h) const {
+			if constexpr (kTransparent) {
+				const Slot* slot = findSlot(key, h);
+				return slot == nullptr ? nullptr : &slot->mapped;
+			}
+			else {
+				return find(static_cast<Key>(key), h);
+			}
+		}
+
+		// key已存在时不覆盖，返回已有的值，语义同std::unordered_map::emplace
+		std::pair<Mapped*, bool> emplace(const Key& key, Mapped mapped) { return emplace(key, std::move(mapped), hashOf(key)); }
+
+		std::pair<Mapped*, bool> emplace(const Key& key, Mapped mapped, uint64_t h) {
+			size_t idx = findIndex(key, h);
+			if (idx != kNotFound)
+				return { &slotAt(idx)->mapped, false };
+			if (oldCtrl_) {
+				size_t oldIdx = findOldIndex(key, h);
+				if (oldIdx != kNotFound)
+					return { &oldSlotAt(oldIdx)->mapped, false };
+				migrateSome();
+			}
+			if (size_ + 1 > maxLoad(capacity_)) {
+				grow();
+			}
+			idx = findEmpty(h);
+			::new (static_cast<void*>(&slots_[idx])) Slot(key, std::move(mapped), h);
+			setCtrl(idx, fingerprint(h));
+			size_++;
+			return { &slotAt(idx)->mapped, true };
+		}
+
+		bool erase(const Key& key) { return erase(key, hashOf(key)); }
+
+		bool erase(const Key& key, uint64_t h) {
+			size_t idx = findIndex(key, h);
+			if (idx != kNotFound) {
+				eraseAt(idx);
+			}
+			else {
+				if (!oldCtrl_)
+					return false;
+				idx = findOldIndex(key, h);
+				if (idx == kNotFound)
+					return false;
+				oldSlotAt(idx)->~Slot();
+				setOldCtrl(idx, detail::kCtrlDeleted);
+				oldSize_--;
+				size_--;
+			}
+			if (oldCtrl_)
+				migrateSome();
+			return true;
+		}
+
+		void clear() {
+			destroyAll();
+			releaseOld();
+			if (capacity_ > 0) {
+				std::memset(ctrl_.get(), static_cast<unsigned char>(detail::kCtrlEmpty), capacity_ + detail::kGroupWidth);
+			}
+			size_ = 0;
+		}
+
+		// 按预期元素数一次性分配好，装载因子不超过7/8，之后不会再rehash。
+		// 这里是一次性搬完的（正在进行的搬迁也先做完），只在构造或者装快照这类本来就是O(n)的地方调用
+		void reserve(size_t expected) {
+			size_t need = detail::kGroupWidth;
+			while (maxLoad(need) < expected) need *= 2;
+			if (need > capacity_ && expected > 0) {
+				finishMigration();
+				rehash(need);
+			}
+		}
+
+		size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+		bool migrating() const { return static_cast<bool>(oldCtrl_); }
+
+		// 批量查找前先预取起始探测位置的控制字节和槽位，多个key的内存访问可以重叠
+		void prefetch(uint64_t h) const {
+			if (capacity_ == 0)
+				return;
+			size_t pos = h & mask_;
+			detail::prefetchRead(ctrl_.get() + pos);
+			detail::prefetchRead(&slots_[pos]);
+		}
+
+		template<typename Func>
+		void forEach(Func&& func) { // func(const Key&, Mapped&)
+			for (size_t i = 0; i < capacity_; i++) {
+				if (ctrl_[i] != detail::kCtrlEmpty)
+					func(static_cast<const Key&>(slotAt(i)->key), slotAt(i)->mapped);
+			}
+			for (size_t i = migrated_; i < oldCapacity_ && oldCtrl_; i++) {
+				if (isFull(oldCtrl_[i]))
+					func(static_cast<const Key&>(oldSlotAt(i)->key), oldSlotAt(i)->mapped);
+			}
+		}
+
+	private:
+		static constexpr size_t kNotFound = static_cast<size_t>(-1);
+		static constexpr size_t kMigrateBatch = 64; // 每次写操作最多搬迁的旧槽位数
+		static constexpr bool kTransparent = detail::isTransparent<Hash>::value && detail::isTransparent<KeyEqual>::value;
+
+		static size_t maxLoad(size_t capacity) { return capacity - capacity / 8; }
+
+		static int8_t fingerprint(uint64_t h) { return static_cast<int8_t>(h >> 57); } // 高7位，0~127
+
+		template<typename K>
+		uint64_t hashOf(const K& key) const { return detail::hashKey(hash_, key); }
+
+		uint64_t slotHash(const Slot* slot) const { // 存了hash就直接用，否则重新算
+			if constexpr (kStoreHash) return slot->storedHash;
+			else return hashOf(slot->key);
+		}
+
+		static bool isFull(int8_t ctrl) { return ctrl >= 0; }
+
+		Slot* slotAt(size_t idx) { return std::launder(reinterpret_cast<Slot*>(&slots_[idx])); }
+		const Slot* slotAt(size_t idx) const { return std::launder(reinterpret_cast<const Slot*>(&slots_[idx])); }
+		Slot* oldSlotAt(size_t idx) { return std::launder(reinterpret_cast<Slot*>(&oldSlots_[idx])); }
+		const Slot* oldSlotAt(size_t idx) const { return std::launder(reinterpret_cast<const Slot*>(&oldSlots_[idx])); }
+
+		template<typename K>
+		const Slot* findSlot(const K& key, uint64_t h) const { // 先查新表，搬迁中再查旧表
+			size_t idx = findIndex(key, h);
+			if (idx != kNotFound)
+				return slotAt(idx);
+			if (oldCtrl_) {
+				idx = findOldIndex(key, h);
+				if (idx != kNotFound)
+					return oldSlotAt(idx);
+			}
+			return nullptr;
+		}
+
+		template<typename K>
+		size_t findIndex(const K& key, uint64_t h) const {
+			if (size_ == 0)
+				return kNotFound;
+			size_t pos = h & mask_;
+			int8_t h2 = fingerprint(h);
+			while (true) {
+				detail::MyCtrlGroup group(ctrl_.get() + pos);
+				for (uint32_t m = group.match(h2); m != 0; m &= m - 1) {
+					size_t idx = (pos + detail::lowestBitIndex(m)) & mask_;
+					const Slot* slot = slotAt(idx);
+					if (slot->hashMayEqual(h) && equal_(slot->key, key))
+						return idx;
+				}
+				if (group.matchEmpty() != 0) // 线性探测保证遇到空槽就说明key不存在
+					return kNotFound;
+				pos = (pos + detail::kGroupWidth) & mask_;
+			}
+		}
+
+		// 旧表的探测：已搬走/已删除的槽位标成kCtrlDeleted而不是置空，原来的探测链不会断
+		template<typename K>
+		size_t findOldIndex(const K& key, uint64_t h) const {
+			if (oldSize_ == 0)
+				return kNotFound;
+			size_t oldMask = oldCapacity_ - 1;
+			size_t pos = h & oldMask;
+			int8_t h2 = fingerprint(h);
+			while (true) {
+				detail::MyCtrlGroup group(oldCtrl_.get() + pos);
+				for (uint32_t m = group.match(h2); m != 0; m &= m - 1) {
+					size_t idx = (pos + detail::lowestBitIndex(m)) & oldMask;
+					const Slot* slot = oldSlotAt(idx);
+					if (slot->hashMayEqual(h) && equal_(slot->key, key))
+						return idx;
+				}
+				if (group.matchEmpty() != 0)
+					return kNotFound;
+				pos = (pos + detail::kGroupWidth) & oldMask;
+			}
+		}
+
+		void setOldCtrl(size_t idx, int8_t value) {
+			oldCtrl_[idx] = value;
+			if (idx < detail::kGroupWidth) {
+				oldCtrl_[oldCapacity_ + idx] = value;
+			}
+		}
+
+		// 当前表装满：当前表变成旧表，换一张两倍大的空表。旧表最多7/8满，按每次kMigrateBatch个槽位，
+		// 新表再装入旧容量的7/8个元素之前一定能搬完；万一没搬完（例如只插不删且批次很小）就先一次做完
+		void grow() {
+			finishMigration();
+			size_t newCapacity = capacity_ == 0 ? detail::kGroupWidth : capacity_ * 2;
+			if (size_ == 0) { // 空表直接换，不需要搬迁
+				rehash(newCapacity);
+				return;
+			}
+			oldCtrl_ = std::move(ctrl_);
+			oldSlots_ = std::move(slots_);
+			oldCapacity_ = capacity_;
+			oldSize_ = size_;
+			migrated_ = 0;
+			ctrl_.reset(new int8_t[newCapacity + detail::kGroupWidth]);
+			std::memset(ctrl_.get(), static_cast<unsigned char>(detail::kCtrlEmpty), newCapacity + detail::kGroupWidth);
+			slots_.reset(new SlotStorage[newCapacity]);
+			capacity_ = newCapacity;
+			mask_ = newCapacity - 1;
+		}
+
+		void migrateSome(size_t budget = kMigrateBatch) {
+			size_t end = std::min(oldCapacity_, migrated_ + budget);
+			for (; migrated_ < end && oldSize_ > 0; migrated_++) {
+				if (!isFull(oldCtrl_[migrated_]))
+					continue;
+				Slot* slot = oldSlotAt(migrated_);
+				uint64_t h = slotHash(slot);
+				size_t idx = findEmpty(h);
+				::new (static_cast<void*>(&slots_[idx])) Slot(std::move(*slot));
+				setCtrl(idx, fingerprint(h));
+				slot->~Slot();
+				setOldCtrl(migrated_, detail::kCtrlDeleted);
+				oldSize_--;
+			}
+			if (oldSize_ == 0)
+				releaseOld();
+		}
+
+		void finishMigration() {
+			if (oldCtrl_)
+				migrateSome(oldCapacity_);
+		}
+
+		void releaseOld() { // 旧表里的元素已经搬完或析构完
+			oldCtrl_.reset();
+			oldSlots_.reset();
+			oldCapacity_ = 0;
+			oldSize_ = 0;
+			migrated_ = 0;
+		}
+
+		void setCtrl(size_t idx, int8_t value) {
+			ctrl_[idx] = value;
+			if (idx < detail::kGroupWidth) {
+				ctrl_[capacity_ + idx] = value; // 同步末尾的克隆字节
+			}
+		}
+
+		size_t findEmpty(uint64_t h) const {
+			size_t pos = h & mask_;
+			while (true) {
+				uint32_t m = detail::MyCtrlGroup(ctrl_.get() + pos).matchEmpty();
+				if (m != 0)
+					return (pos + detail::lowestBitIndex(m)) & mask_;
+				pos = (pos + detail::kGroupWidth) & mask_;
+			}
+		}
+
+		void eraseAt(size_t hole) { // 向后平移删除：把后面不在自己起始位置的元素往前挪，保持探测链连续
+			slotAt(hole)->~Slot();
+			size_t next = (hole + 1) & mask_;
+			while (ctrl_[next] != detail::kCtrlEmpty) {
+				size_t home = slotHash(slotAt(next)) & mask_;
+				if (((next - home) & mask_) >= ((next - hole) & mask_)) {
+					::new (static_cast<void*>(&slots_[hole])) Slot(std::move(*slotAt(next)));
+					slotAt(next)->~Slot();
+					setCtrl(hole, ctrl_[next]);
+					hole = next;
+				}
+				next = (next + 1) & mask_;
+			}
+			setCtrl(hole, detail::kCtrlEmpty);
+			size_--;
+		}
+
+		void rehash(size_t newCapacity) {
+			std::unique_ptr<int8_t[]> oldCtrl = std::move(ctrl_);
+			std::unique_ptr<SlotStorage[]> oldSlots = std::move(slots_);
+			size_t oldCapacity = capacity_;
+
+			ctrl_.reset(new int8_t[newCapacity + detail::kGroupWidth]);
+			std::memset(ctrl_.get(), static_cast<unsigned char>(detail::kCtrlEmpty), newCapacity + detail::kGroupWidth);
+			slots_.reset(new SlotStorage[newCapacity]);
+			capacity_ = newCapacity;
+			mask_ = newCapacity - 1;
+
+			for (size_t i = 0; i < oldCapacity; i++) {
+				if (oldCtrl[i] == detail::kCtrlEmpty)
+					continue;
+				Slot* slot = std::launder(reinterpret_cast<Slot*>(&oldSlots[i]));
+				uint64_t h = slotHash(slot);
+				size_t idx = findEmpty(h);
+				::new (static_cast<void*>(&slots_[idx])) Slot(std::move(*slot));
+				setCtrl(idx, fingerprint(h));
+				slot->~Slot();
+			}
+		}
+
+		void destroyAll() {
+			for (size_t i = 0; i < capacity_; i++) {
+				if (ctrl_[i] != detail::kCtrlEmpty)
+					slotAt(i)->~Slot();
+			}
+			for (size_t i = migrated_; i < oldCapacity_ && oldCtrl_; i++) {
+				if (isFull(oldCtrl_[i]))
+					oldSlotAt(i)->~Slot();
+			}
+		}
+	};
+
+	// 用MyFastHash的扁平索引，直接作为缓存的Index模板参数，例如MyLruCache<std::string, V, MyFastFlatIndex>
+	template<typename Key, typename Mapped>
+	using MyFastFlatIndex = MyFlatIndex<Key, Mapped, MyFastHash<Key>>;
+
+	// 基于std::unordered_map的索引，接口与MyFlatIndex一致，可以作为Index模板参数替换进缓存
+	template<typename Key, typename Mapped, typename Hash = MyDefaultHash<Key>, typename KeyEqual = std::equal_to<>>
+	class MyStdIndex {
+	private:
+		std::unordered_map<Key, Mapped, Hash, KeyEqual> map_;
+
+	public:
+		using hasher = Hash;
+
+		explicit MyStdIndex(size_t expected = 0) { map_.reserve(expected); }
+
+		template<typename K>
+		uint64_t hash(const K&) const { return 0; } // unordered_map自己算hash，带hash的重载直接忽略这个值
+
+		template<typename K>
+		Mapped* find(const K& key, uint64_t) { return find(key); }
+		template<typename K>
+		const Mapped* find(const K& key, uint64_t) const { return find(key); }
+		std::pair<Mapped*, bool> emplace(const Key& key, Mapped mapped, uint64_t) { return emplace(key, std::move(mapped)); }
+		bool erase(const Key& key, uint64_t) { return erase(key); }
+
+		Mapped* find(const Key& key) {
+			auto it = map_.find(key);
+			return it == map_.end() ? nullptr : &it->second;
+		}
+
+		const Mapped* find(const Key& key) const {
+			auto it = map_.find(key);
+			return it == map_.end() ? nullptr : &it->second;
+		}
+
+		// C++17的unordered_map没有异构find，先构造Key
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		Mapped* find(const K& key) { return find(static_cast<Key>(key)); }
+
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		const Mapped* find(const K& key) const { return find(static_cast<Key>(key)); }
+
+		std::pair<Mapped*, bool> emplace(const Key& key, Mapped mapped) {
+			auto result = map_.emplace(key, std::move(mapped));
+			return { &result.first->second, result.second };
+		}
+
+		bool erase(const Key& key) { return map_.erase(key) > 0; }
+		void clear() { map_.clear(); }
+		void reserve(size_t expected) { map_.reserve(expected); }
+		size_t size() const { return map_.size(); }
+		bool empty() const { return map_.empty(); }
+		void prefetch(uint64_t) const {}
+
+		template<typename Func>
+		void forEach(Func&& func) {
+			for (auto& pair : map_) func(static_cast<const Key&>(pair.first), pair.second);
+		}
+	};
+
+}
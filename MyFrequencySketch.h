@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "MyHash.h"
+
+namespace MyCache {
+
+	// 访问频次的近似统计（TinyLFU用）：4-bit计数的Count-Min sketch，外加一个门卫(doorkeeper)布隆过滤器。
+	// - 每个uint64_t装16个4-bit计数器，每个key在4个位置计数，估计值取最小；计数封顶15
+	// - key第一次出现只写门卫，第二次起才进sketch，一次性访问的key不会占用计数器
+	// - 累计sampleSize_次访问后所有计数减半并清空门卫，旧的热度逐渐淡出
+	// 所有字都是原子变量，increment用CAS、frequency只做relaxed读，不需要任何锁；计数本来就是近似的，并发下少计一两次无所谓
+	class MyFrequencySketch {
+	private:
+		static constexpr int      kDepth = 4;
+		static constexpr uint64_t kResetMask = 0x7777777777777777ULL; // 减半时清掉每个4-bit计数右移进来的高位
+
+		std::unique_ptr<std::atomic<uint64_t>[]> table_;
+		size_t                                   tableMask_;
+		std::unique_ptr<std::atomic<uint64_t>[]> doorkeeper_;
+		size_t                                   doorkeeperMask_; // 位下标的掩码
+		size_t                                   sampleSize_;
+		std::atomic<size_t>                      additions_;
+
+	public:
+		// capacity为缓存能存的条目数：sketch每个条目8字节，门卫每个条目1字节
+		explicit MyFrequencySketch(size_t capacity)
+			:tableMask_(roundUpPow2(std::max<size_t>(capacity, 16)) - 1),
+			doorkeeperMask_(roundUpPow2(std::max<size_t>(capacity, 16) * 8) - 1),
+			sampleSize_(std::max<size_t>(capacity, 16) * 10), additions_(0) {
+			table_.reset(new std::atomic<uint64_t>[tableMask_ + 1]);
+			doorkeeper_.reset(new std::atomic<uint64_t>[(doorkeeperMask_ + 1) / 64]);
+			for (size_t i = 0; i <= tableMask_; i++) table_[i].store(0, std::memory_order_relaxed);
+			for (size_t i = 0; i < (doorkeeperMask_ + 1) / 64; i++) doorkeeper_[i].store(0, std::memory_order_relaxed);
+		}
+
+		MyFrequencySketch(const MyFrequencySketch&) = delete;
+		MyFrequencySketch& operator=(const MyFrequencySketch&) = delete;
+
+		// h是key的hash。记录一次访问
+		void increment(uint64_t h) {
+			uint64_t x = mixHash(h);
+			if (doorkeeperInsert(x)) {
+				// 保守更新：只加当前等于最小值的那几个计数器，高估更少
+				int minCount = countMin(x);
+				if (minCount < 15) {
+					for (int i = 0; i < kDepth; i++) {
+						incrementAt(x, i, minCount);
+					}
+				}
+			}
+			if (additions_.fetch_add(1, std::memory_order_relaxed) + 1 == sampleSize_) { // 恰好跨过阈值的那个线程负责减半
+				reset();
+			}
+		}
+
+		// 估计访问频次，门卫里有算1次
+		int frequency(uint64_t h) const {
+			uint64_t x = mixHash(h);
+			if (!doorkeeperContains(x))
+				return 0;
+			return countMin(x) + 1;
+		}
+
+	private:
+		static size_t roundUpPow2(size_t n) {
+			size_t p = 1;
+			while (p < n) p <<= 1;
+			return p;
+		}
+
+		// 双重hash：第i个位置用 x低32位 + i * x高32位，低4位选字内的计数器，其余位选字
+		static uint64_t probe(uint64_t x, int i) {
+			return (x & 0xffffffffULL) + static_cast<uint64_t>(i) * ((x >> 32) | 1);
+		}
+
+		int countAt(uint64_t x, int i) const {
+			uint64_t g = probe(x, i);
+			uint64_t word = table_[(g >> 4) & tableMask_].load(std::memory_order_relaxed);
+			return static_cast<int>((word >> ((g & 15) << 2)) & 0xf);
+		}
+
+		int countMin(uint64_t x) const {
+			int minCount = 15;
+			for (int i = 0; i < kDepth; i++) {
+				minCount = std::min(minCount, countAt(x, i));
+			}
+			return minCount;
+		}
+
+		void incrementAt(uint64_t x, int i, int minCount) {
+			uint64_t g = probe(x, i);
+			std::atomic<uint64_t>& slot = table_[(g >> 4) & tableMask_];
+			int shift = static_cast<int>((g & 15) << 2);
+			uint64_t word = slot.load(std::memory_order_relaxed);
+			while (static_cast<int>((word >> shift) & 0xf) == minCount) {
+				if (slot.compare_exchange_weak(word, word + (1ULL << shift), std::memory_order_relaxed))
+					return;
+			}
+		}
+
+		// 门卫用两个位；返回插入前是否已经存在
+		bool doorkeeperInsert(uint64_t x) {
+			bool present = true;
+			for (uint64_t bit : { x & doorkeeperMask_, (x >> 32) & doorkeeperMask_ }) {
+				uint64_t mask = 1ULL << (bit & 63);
+				std::atomic<uint64_t>& word = doorkeeper_[bit >> 6];
+				if ((word.load(std::memory_order_relaxed) & mask) == 0) {
+					present = false;
+					word.fetch_or(mask, std::memory_order_relaxed);
+				}
+			}
+			return present;
+		}
+
+		bool doorkeeperContains(uint64_t x) const {
+			for (uint64_t bit : { x & doorkeeperMask_, (x >> 32) & doorkeeperMask_ }) {
+				if ((doorkeeper_[bit >> 6].load(std::memory_order_relaxed) & (1ULL << (bit & 63))) == 0)
+					return false;
+			}
+			return true;
+		}
+
+		void reset() { // 所有计数减半，门卫清空，累计次数也减半
+			for (size_t i = 0; i <= tableMask_; i++) {
+				uint64_t word = table_[i].load(std::memory_order_relaxed);
+				while (!table_[i].compare_exchange_weak(word, (word >> 1) & kResetMask, std::memory_order_relaxed)) {}
+			}
+			for (size_t i = 0; i < (doorkeeperMask_ + 1) / 64; i++) {
+				doorkeeper_[i].store(0, std::memory_order_relaxed);
+			}
+			additions_.fetch_sub(sampleSize_ / 2, std::memory_order_relaxed);
+		}
+	};
+
+}
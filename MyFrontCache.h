@@ -0,0 +1,245 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "MyCachePolicy.h"
+#include "MyCacheStats.h"
+#include "MyHash.h"
+
+namespace MyCache {
+
+	struct MyFrontStats {
+		uint64_t l0Hits = 0; // 各线程按批上报，落后每个线程最多kFeedbackBatch次
+		uint64_t admissions = 0; // 被放进某个线程L0的次数
+	};
+
+	// 线程局部的L0前端：每个线程一个很小的直接映射数组，挡在任意策略Cache前面。
+	// 同一个槽位连续两次在Cache里命中的key才放进L0，之后这个线程读它不加锁、不写任何共享cache line，只读一次所属条带的版本号。
+	// put/erase/clear以及Cache自己的淘汰、过期都会把key所在条带的版本号加一，各线程L0里版本号对不上的副本随之作废。
+	// L0里的条目每命中kFeedbackBatch次回Cache真正读一次：Cache借此看到这个key的访问（LRU提升、LFU频次+1），L0副本也顺带重新校验。
+	// 只在Cache提供setEvictionListener时能感知淘汰和过期，否则被动作废的副本最多还会被命中kFeedbackBatch次；
+	// 对Cache的写入都必须经过这里，绕过前端直接写cache()不会作废L0
+	template<typename Key, typename Value, typename Cache, typename Hash = MyDefaultHash<Key>>
+	class MyFrontCache :public MyCachePolicy<Key, Value> {
+	private:
+		static constexpr size_t   kStripeNum = 4096; // 版本号条带数，2的幂；条带越多，一次写入误伤的其他key越少
+		static constexpr uint32_t kFeedbackBatch = 32;
+
+		struct Stripe { // 不按cache line对齐：8个版本号共用一条，写入只让读相邻条带的线程多一次cache miss，不会作废它们的副本
+			std::atomic<uint64_t> version{ 0 };
+		};
+
+		struct Entry {
+			uint64_t hash = 0;
+			uint64_t version = 0;
+			uint32_t hits = 0;
+			bool     valid = false;
+			Key      key{};
+			Value    value{};
+		};
+
+		struct Table { // 一个线程在一个前端实例上的L0
+			uint64_t                    serial = 0; // 所属实例的序号，实例析构后编号被复用时靠它识别旧表
+			size_t                      mask = 0;
+			std::unique_ptr<Entry[]>    entries;
+			std::unique_ptr<uint64_t[]> candidates; // 每个槽位上次在Cache里命中的key的hash，再命中一次才放进L0
+			uint64_t                    pendingHits = 0; // 还没上报的L0命中数
+		};
+
+		struct Registry { // 实例编号分配：编号用作线程局部表的下标，析构后回收
+			std::mutex          mutex;
+			std::vector<size_t> freeIds;
+			size_t              nextId = 0;
+			uint64_t            nextSerial = 1;
+		};
+
+		Cache                     cache_;
+		size_t                    frontSize_;
+		size_t                    id_;
+		uint64_t                  serial_;
+		std::unique_ptr<Stripe[]> stripes_;
+		Hash                      hash_;
+		std::atomic<uint64_t>     l0Hits_{ 0 };
+		std::atomic<uint64_t>     admissions_{ 0 };
+
+	public:
+		// frontSize是每个线程L0的槽位数，向上取2的幂；cacheArgs原样传给Cache的构造函数
+		template<typename... CacheArgs>
+		explicit MyFrontCache(size_t frontSize, CacheArgs&&... cacheArgs)
+			:cache_(std::forward<CacheArgs>(cacheArgs)...), frontSize_(roundUpPow2(frontSize > 0 ? frontSize : 1)), stripes_(new Stripe[kStripeNum]) {
+			{
+				Registry& registry = this->registry();
+				std::lock_guard<std::mutex> lock(registry.mutex);
+				if (!registry.freeIds.empty()) {
+					id_ = registry.freeIds.back();
+					registry.freeIds.pop_back();
+				}
+				else {
+					id_ = registry.nextId++;
+				}
+				serial_ = registry.nextSerial++;
+			}
+			setEvictionListener(nullptr);
+		}
+
+		// 其他线程的L0里可能还留着本实例的副本，等该线程退出或编号被复用时释放
+		~MyFrontCache() override {
+			Registry& registry = this->registry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			registry.freeIds.push_back(id_);
+		}
+
+		MyFrontCache(const MyFrontCache&) = delete;
+		MyFrontCache& operator=(const MyFrontCache&) = delete;
+
+		void put(const Key& key, const Value& value) override {
+			cache_.put(key, value);
+			bump(hashOf(key)); // 写入完成后再作废，读到新版本号的线程一定能从Cache读到新值
+		}
+
+		void put(const Key& key, Value&& value) override {
+			cache_.put(key, std::move(value));
+			bump(hashOf(key));
+		}
+
+		Value get(const Key& key) override {
+			Value value{};
+			get(key, value);
+			return value;
+		}
+
+		bool get(const Key& key, Value& value) override {
+			uint64_t h = hashOf(key);
+			Table& table = localTable();
+			size_t slot = static_cast<size_t>(h) & table.mask;
+			Entry& entry = table.entries[slot];
+			uint64_t version = stripeFor(h).version.load(std::memory_order_acquire); // 先读版本号再读Cache
+			bool cached = entry.valid && entry.hash == h && entry.key == key;
+			if (cached && entry.version == version) {
+				table.pendingHits++;
+				if (++entry.hits < kFeedbackBatch) {
+					value = entry.value;
+					return true;
+				}
+				entry.hits = 0; // 攒够一批，回Cache读一次
+				l0Hits_.fetch_add(table.pendingHits, std::memory_order_relaxed);
+				table.pendingHits = 0;
+			}
+			if (!cache_.get(key, value)) {
+				if (cached) entry.valid = false;
+				return false;
+			}
+			if (cached) { // 刷新副本
+				entry.version = version;
+				entry.value = value;
+			}
+			else if (table.candidates[slot] == h) { // 第二次命中，顶掉槽位里原来的条目
+				entry.hash = h;
+				entry.version = version;
+				entry.hits = 0;
+				entry.valid = true;
+				entry.key = key;
+				entry.value = value;
+				admissions_.fetch_add(1, std::memory_order_relaxed);
+			}
+			else {
+				table.candidates[slot] = h;
+			}
+			return true;
+		}
+
+		void putMany(const Key* keys, const Value* values, size_t count, const uint32_t* indices = nullptr) override {
+			cache_.putMany(keys, values, count, indices);
+			for (size_t i = 0; i < count; i++) {
+				bump(hashOf(keys[detail::batchIndex(indices, i)]));
+			}
+		}
+
+		bool erase(const Key& key) override {
+			bool erased = cache_.erase(key);
+			bump(hashOf(key));
+			return erased;
+		}
+
+		void clear() override {
+			cache_.clear();
+			for (size_t i = 0; i < kStripeNum; i++) {
+				stripes_[i].version.fetch_add(1, std::memory_order_release);
+			}
+		}
+
+		bool contains(const Key& key) override { return cache_.contains(key); }
+
+		size_t size() override { return cache_.size(); }
+
+		// 用户的移除回调包在前端自己的回调里：先作废L0，再转给listener。Cache没有setEvictionListener时什么都不做
+		void setEvictionListener(MyEvictionListener<Key, Value> listener) {
+			installListener(cache_, std::move(listener), 0);
+		}
+
+		MyFrontStats frontStats() const {
+			MyFrontStats stats;
+			stats.l0Hits = l0Hits_.load(std::memory_order_relaxed);
+			stats.admissions = admissions_.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		size_t frontSize() const { return frontSize_; }
+
+		Cache& cache() { return cache_; }
+
+	private:
+		template<typename C>
+		auto installListener(C& cache, MyEvictionListener<Key, Value> listener, int)
+			-> decltype(cache.setEvictionListener(std::declval<MyEvictionListener<Key, Value>>()), void()) {
+			cache.setEvictionListener([this, listener = std::move(listener)](const Key& key, Value&& value, MyRemovalCause cause) {
+				bump(hashOf(key));
+				if (listener) listener(key, std::move(value), cause);
+			});
+		}
+
+		template<typename C>
+		void installListener(C&, MyEvictionListener<Key, Value>, long) {}
+
+		uint64_t hashOf(const Key& key) const { return detail::hashKey(hash_, key); }
+
+		Stripe& stripeFor(uint64_t h) const { return stripes_[static_cast<size_t>(h >> 52) & (kStripeNum - 1)]; } // 高位选条带，低位选槽位
+
+		void bump(uint64_t h) { stripeFor(h).version.fetch_add(1, std::memory_order_release); }
+
+		Table& localTable() {
+			thread_local std::vector<std::unique_ptr<Table>> tables;
+			if (tables.size() <= id_)
+				tables.resize(id_ + 1);
+			std::unique_ptr<Table>& table = tables[id_];
+			if (!table)
+				table = std::make_unique<Table>();
+			if (table->serial != serial_) { // 第一次用，或者编号原来的主人已经析构
+				table->serial = serial_;
+				table->mask = frontSize_ - 1;
+				table->entries.reset(new Entry[frontSize_]);
+				table->candidates.reset(new uint64_t[frontSize_]());
+				table->pendingHits = 0;
+			}
+			return *table;
+		}
+
+		static Registry& registry() {
+			static Registry registry;
+			return registry;
+		}
+
+		static size_t roundUpPow2(size_t n) {
+			size_t p = 1;
+			while (p < n) p <<= 1;
+			return p;
+		}
+	};
+
+}
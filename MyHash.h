@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace MyCache {
+
+	// 对std::hash的结果再做一次雪崩混合（murmur3 fmix64）。
+	// libstdc++/MSVC里整数的std::hash基本是恒等映射，不混合的话连续int key的高位全是0，指纹和分片都会退化
+	inline uint64_t mixHash(uint64_t h) {
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// 缓存默认使用的hash。std::string的版本是透明的(is_transparent)，
+	// 可以直接拿std::string_view/const char*查找，不用先构造临时string；std::hash<string_view>和std::hash<string>结果相同
+	template<typename Key>
+	struct MyDefaultHash :std::hash<Key> {};
+
+	template<>
+	struct MyDefaultHash<std::string> {
+		using is_transparent = void;
+
+		size_t operator()(std::string_view key) const { return std::hash<std::string_view>()(key); }
+	};
+
+	namespace detail {
+
+		template<typename T, typename = void>
+		struct isTransparent :std::false_type {};
+
+		template<typename T>
+		struct isTransparent<T, std::void_t<typename T::is_transparent>> :std::true_type {};
+
+		// Hash声明了is_avalanching表示输出的每一位都已经充分混合，可以直接拿来选分片、选槽位、做指纹，不用再mixHash
+		template<typename T, typename = void>
+		struct isAvalanching :std::false_type {};
+
+		template<typename T>
+		struct isAvalanching<T, std::void_t<typename T::is_avalanching>> :std::true_type {};
+
+		// 64x64->128位乘法，a、b分别换成积的低、高64位（wyhash的mum）
+		inline void mulWide(uint64_t& a, uint64_t& b) {
+#if defined(__SIZEOF_INT128__)
+			__uint128_t r = static_cast<__uint128_t>(a) * b;
+			a = static_cast<uint64_t>(r);
+			b = static_cast<uint64_t>(r >> 64);
+#elif defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+			a = _umul128(a, b, &b);
+#else
+			uint64_t ha = a >> 32, la = static_cast<uint32_t>(a), hb = b >> 32, lb = static_cast<uint32_t>(b);
+			uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+			uint64_t t = rl + (rm0 << 32);
+			uint64_t carry = t < rl;
+			uint64_t low = t + (rm1 << 32);
+			carry += low < t;
+			a = low;
+			b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+		}
+
+		inline uint64_t mulFold(uint64_t a, uint64_t b) { // 积的高低64位异或
+			mulWide(a, b);
+			return a ^ b;
+		}
+
+		inline uint64_t read64(const unsigned char* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+		inline uint64_t read32(const unsigned char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+		// wyhash风格的字节串hash：每16字节一次128位乘法，48字节以上三路并行，40~100字节的key大约十几纳秒
+		inline uint64_t hashBytes(const void* data, size_t len, uint64_t seed = 0) {
+			constexpr uint64_t kSecret[4] = { 0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL, 0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL };
+			const unsigned char* p = static_cast<const unsigned char*>(data);
+			seed ^= mulFold(seed ^ kSecret[0], kSecret[1]);
+			uint64_t a, b;
+			if (len <= 16) {
+				if (len >= 4) {
+					size_t mid = (len >> 3) << 2;
+					a = (read32(p) << 32) | read32(p + mid);
+					b = (read32(p + len - 4) << 32) | read32(p + len - 4 - mid);
+				}
+				else if (len > 0) {
+					a = (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[len >> 1]) << 8) | p[len - 1];
+					b = 0;
+				}
+				else {
+					a = b = 0;
+				}
+			}
+			else {
+				size_t i = len;
+				if (i > 48) {
+					uint64_t see1 = seed, see2 = seed;
+					do {
+						seed = mulFold(read64(p) ^ kSecret[1], read64(p + 8) ^ seed);
+						see1 = mulFold(read64(p + 16) ^ kSecret[2], read64(p + 24) ^ see1);
+						see2 = mulFold(read64(p + 32) ^ kSecret[3], read64(p + 40) ^ see2);
+						p += 48;
+						i -= 48;
+					} while (i > 48);
+					seed ^= see1 ^ see2;
+				}
+				while (i > 16) {
+					seed = mulFold(read64(p) ^ kSecret[1], read64(p + 8) ^ seed);
+					p += 16;
+					i -= 16;
+				}
+				a = read64(p + i - 16); // 最后16字节，和前面的块可能重叠
+				b = read64(p + i - 8);
+			}
+			a ^= kSecret[1];
+			b ^= seed;
+			mulWide(a, b);
+			return mulFold(a ^ kSecret[0] ^ len, b ^ kSecret[1]);
+		}
+
+		// K是否是Key以外的查找类型（异构查找）
+		template<typename K, typename Key>
+		constexpr bool isOtherKey = !std::is_same<std::decay_t<K>, Key>::value;
+
+		// 缓存内部统一用的64位hash：Hash的结果不够混合时再过一遍mixHash。分片、索引、指纹都从同一个值里取不同的位
+		template<typename Hash, typename K>
+		uint64_t hashKey(const Hash& hash, const K& key) {
+			if constexpr (isAvalanching<Hash>::value) return static_cast<uint64_t>(hash(key));
+			else return mixHash(static_cast<uint64_t>(hash(key)));
+		}
+
+		// 非标量的key（字符串等）比较和重新hash都贵，在槽位/节点里存一份完整hash：
+		// 探测时先比hash再比key，搬迁和删除时不用重新算。整数/指针这类key不存，空基类不占空间
+		template<typename Key>
+		constexpr bool kCacheHash = !std::is_scalar<Key>::value;
+
+		template<bool Enabled>
+		struct MyStoredHash {
+			uint64_t storedHash = 0;
+
+			explicit MyStoredHash(uint64_t h = 0) :storedHash(h) {}
+			void storeHash(uint64_t h) { storedHash = h; }
+			bool hashMayEqual(uint64_t h) const { return storedHash == h; }
+		};
+
+		template<>
+		struct MyStoredHash<false> {
+			explicit MyStoredHash(uint64_t = 0) {}
+			void storeHash(uint64_t) {}
+			bool hashMayEqual(uint64_t) const { return true; }
+		};
+
+	}
+
+	// 快速hash，作为Hash模板参数替换MyDefaultHash。字符串用wyhash风格的hashBytes，输出已经充分混合(is_avalanching)，
+	// 索引和分片直接使用，不再mixHash；和MyDefaultHash一样对std::string透明。其他类型沿用MyDefaultHash
+	template<typename Key>
+	struct MyFastHash :MyDefaultHash<Key> {};
+
+	template<>
+	struct MyFastHash<std::string> {
+		using is_transparent = void;
+		using is_avalanching = void;
+
+		size_t operator()(std::string_view key) const { return static_cast<size_t>(detail::hashBytes(key.data(), key.size())); }
+	};
+
+}
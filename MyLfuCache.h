@@ -1,155 +1,833 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
 #include <cmath>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <thread>
-#include <unordered_map>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "MyCachePolicy.h"
+#include "MyCacheSnapshot.h"
+#include "MyCacheStats.h"
+#include "MyFlatIndex.h"
+#include "MyNodePool.h"
+#include "MyReadBuffer.h"
+#include "MyRemovalQueue.h"
+#include "MyTimingWheel.h"
 
 namespace MyCache {
 
 
-	template<typename Key, typename Value> class MyLfuCache;
+	template<typename Key, typename Value, template<typename...> class Index> class MyLfuCache;
 
+	// 同一访问频次的节点组成一个Freqlist（频次桶），所有非空的桶再按频次从小到大串成双向链表。
+	// 节点直接指向自己所在的桶，访问时只需看下一个桶是不是freq+1，不需要任何哈希查找
 	template<typename Key, typename Value>
 	class Freqlist {
 	private: // 类似于LRU但少了map，所以需要定义节点、头尾节点、频率
-		typedef struct Node {
-			int freq;
+		struct Node :MyTimerHook, detail::MyStoredHash<detail::kCacheHash<Key>> { // 继承定时钩子，带ttl的节点直接挂进时间轮；字符串这类key另存一份hash，淘汰时不用重算
 			Key key;
 			Value value;
-			std::shared_ptr<Node> prev;
-			std::shared_ptr<Node> next;
-
-			Node() :freq(1), prev(nullptr), next(nullptr) {};
-			Node(Key key,Value value) :freq(1),key(key),value(value), prev(nullptr), next(nullptr) {};
+			Node* prev;
+			Node* next;
+			Freqlist* freqList; // 节点所在的频次桶，节点频次由freqList->freq_和缓存的老化基准算出
+			size_t weight; // 插入或更新时由weigher算好
+
+			Node() :prev(nullptr), next(nullptr), freqList(nullptr), weight(1) {};
+			template<typename... Args>
+			explicit Node(const Key& key, Args&&... args) :key(key), value(std::forward<Args>(args)...), prev(nullptr), next(nullptr), freqList(nullptr), weight(1) {}; // value原地构造
 		};
 
-		using NodePtr = std::shared_ptr<Node>;
-		int freq_;
-		NodePtr head_;
-		NodePtr tail_;
+		using NodePtr = Node*;
+		int       freq_; // 未扣除老化基准的原始频次，桶链表按它有序
+		size_t    size_; // 桶内节点数
+		Node      head_; // 哨兵节点直接放在桶里，桶从池里分配，地址稳定
+		Node      tail_;
+		Freqlist* prevList_; // 频次更小的相邻桶
+		Freqlist* nextList_; // 频次更大的相邻桶
 
 	public: // 提供给外部的方法：构造、加入、移除头部节点、判空
-		explicit Freqlist(int n) :freq_(n) {  // explicit避免隐式转换，例如：vecotr<Freqlist> a; a.push_back(42)不会隐式调用构造方法，必须用 a.push_back(new Freqlist(42))
-			head_ = std::make_shared<Node>(); // 调用Node的空参构造
-			tail_ = std::make_shared<Node>();
-			head_->next = tail_;
-			tail_->prev = head_;
+		explicit Freqlist(int n) :freq_(n), size_(0), prevList_(nullptr), nextList_(nullptr) {  // explicit避免隐式转换，例如：vecotr<Freqlist> a; a.push_back(42)不会隐式调用构造方法，必须用 a.push_back(new Freqlist(42))
+			head_.next = &tail_;
+			tail_.prev = &head_;
 		}
 
+		Freqlist(const Freqlist&) = delete; // 节点里存的是哨兵地址，不能拷贝
+		Freqlist& operator=(const Freqlist&) = delete;
+
 		void addNode(NodePtr node) {
-			if (!node || !head_ || !tail_)
+			if (!node)
 				return;
-			node->prev = tail_->prev;
-			node->next = tail_;
-			tail_->prev->next = node;
-			tail_->prev = node;
+			node->prev = tail_.prev;
+			node->next = &tail_;
+			tail_.prev->next = node;
+			tail_.prev = node;
+			node->freqList = this;
+			size_++;
+		}
+
+		void addFirstNode(NodePtr node) { // 放到最久未访问端，加载快照时按从新到旧的顺序依次放
+			node->prev = &head_;
+			node->next = head_.next;
+			head_.next->prev = node;
+			head_.next = node;
+			node->freqList = this;
+			size_++;
 		}
 
 		void remove(NodePtr node) {
-			if (!node || !head_ || !tail_)return;
+			if (!node)return;
 			if (!node->prev || !node->next)return;
 
 			node->prev->next = node->next;
 			node->next->prev = node->prev;
 			node->prev = nullptr;
 			node->next = nullptr;
+			size_--;
 		}
 
 		bool isEmpty() const{
-			return head_->next == tail_;
+			return head_.next == &tail_;
 		}
 
-		NodePtr getFirstNode() const { return head_->next; }
+		NodePtr getFirstNode() const { return head_.next; }
 
-		friend class MyLfuCache<Key, Value>;
+		template<typename K, typename V, template<typename...> class I> friend class MyLfuCache;
 	};
 
 
-	template<typename Key, typename Value> 
+	template<typename Key, typename Value, template<typename...> class Index = MyFlatIndex>
 	class MyLfuCache:public MyCachePolicy<Key,Value> {
-		// 一个map保存lfu节点，一个map保存visCount对应的LRU
+		// 一个索引保存lfu节点（默认开放寻址的MyFlatIndex），一条按频次有序的桶链表保存各频次对应的LRU
+		// 给了weigher时容量是总权重预算：插入时连续kickOut直到放得下，单个权重超过容量的条目直接拒绝
+		// 带ttl的put写入会过期的条目：get时检查过期时间，另外每次操作顺带推进时间轮回收最多kExpireBatch个已过期的条目
 	public:
-		using Node = typename Freqlist<Key, Value>::Node; // typename告诉编译器 依赖于模板的嵌套成员Node是一个类型，而不是变量或常量
-		using NodePtr = std::shared_ptr<Node>;
-		using NodeMap = std::unordered_map<Key, NodePtr>;
+		using FreqListType = Freqlist<Key, Value>;
+		using Node = typename FreqListType::Node; // typename告诉编译器 依赖于模板的嵌套成员Node是一个类型，而不是变量或常量
+		using NodePtr = Node*;
+		using NodeMap = Index<Key, NodePtr>;
+		using Weigher = MyWeigher<Key, Value>;
+		using EvictionListener = MyEvictionListener<Key, Value>;
 	private:
-		int                                            capacity_; // 缓存容量
-		int                                            minFreq_; // 最小访问频次(用于找到最小访问频次结点)
+		std::atomic<int>                               capacity_; // 缓存容量（条目数或总权重），setCapacity()在锁内修改
+		Weigher                                        weigher_; // 为空时每个条目权重为1
+		size_t                                         weightedSize_; // 当前总权重
 		int                                            maxAverageNum_; // 最大平均访问频次 !!!!!!
 		int                                            curAverageNum_; // 当前平均访问频次
-		int                                            curTotalNum_; // 当前访问所有缓存次数总数 
-		std::mutex                                     mutex_; // 互斥锁
+		long long                                      curTotalNum_; // 当前所有缓存节点的访问频次总和
+		int                                            ageBase_; // 老化基准：节点实际频次 = max(1, 原始频次 - ageBase_)
+		std::shared_mutex                              mutex_; // 不开读缓冲时所有操作都拿独占锁；开了之后get命中只拿共享锁
+		MyStatsCounter                                 stats_; // 命中、淘汰等计数，stats()不加锁读
 		NodeMap                                        nodeMap_; // key 到 缓存节点的映射
-		std::unordered_map<int, Freqlist<Key, Value>*> freqToFreqList_;// 访问频次到该频次链表的映射
+		MyNodePool<Node>                               nodePool_; // 节点池，按容量预留
+		MyNodePool<FreqListType>                       freqListPool_; // 频次桶池，空桶立即回收复用
+		FreqListType*                                  freqHead_; // 桶链表的头尾哨兵，freqHead_->nextList_就是最小频次桶
+		FreqListType*                                  freqTail_;
+		std::unique_ptr<MyTimingWheel>                 timerWheel_; // 第一次带ttl写入时才创建，不用ttl没有任何开销
+		std::chrono::steady_clock::time_point          epoch_; // tick为从epoch_起的毫秒数+1，0留给“永不过期”
+		MyRemovalQueue<Key, Value>                     removals_; // 锁内排队的移除通知
+		std::unique_ptr<MyReadBuffer<Node>>            readBuffer_; // enableReadBuffer()之后才有
 
 	public:
-		MyLfuCache(int capacity, int maxAverageNum = 10) :capacity_(capacity), maxAverageNum_(maxAverageNum), minFreq_(INT8_MAX), curAverageNum_(0) {} // INT8_MAX?
-		~MyLfuCache() override = default;
+		MyLfuCache(int capacity, int maxAverageNum = 10, Weigher weigher = nullptr)
+			:capacity_(capacity), weigher_(std::move(weigher)), weightedSize_(0),
+			maxAverageNum_(maxAverageNum), curAverageNum_(0), curTotalNum_(0), ageBase_(0),
+			nodeMap_(capacity > 0 && !weigher_ ? capacity : 0),
+			nodePool_(capacity > 0 && !weigher_ ? static_cast<size_t>(capacity) + 1 : 0), freqListPool_(16),
+			epoch_(std::chrono::steady_clock::now()) { // 条目数模式按容量预留索引，不会rehash；权重模式不预留
+			freqHead_ = freqListPool_.allocate(0);
+			freqTail_ = freqListPool_.allocate(INT_MAX);
+			freqHead_->nextList_ = freqTail_;
+			freqTail_->prevList_ = freqHead_;
+		}
 
-		void put(Key key,Value value) {
-			if (capacity_ <= 0)return;
-			std::lock_guard<std::mutex>lock(mutex_);
-			auto it = nodeMap_.find(key);
-			if (it != nodeMap_.end()) {
-				it->second->value = value;
-				getInternal(it->second, value); // 相当于访问一次,那为什么要把value传进去？
-				return;
-			}
-			putInternal(key, value);
+		~MyLfuCache() override {
+			releaseAll(false); // 析构不发移除通知
+			freqListPool_.deallocate(freqHead_);
+			freqListPool_.deallocate(freqTail_);
 		}
 
-		Value get(Key key) {
-			Value value;
+		void put(const Key& key, const Value& value) override {
+			emplace(key, value);
+		}
+
+		void put(const Key& key, Value&& value) override { // value直接移进节点
+			emplace(key, std::move(value));
+		}
+
+		// 写入ttl后过期的条目；ttl<=0等于删除。不带ttl的put会把已有条目改回永不过期
+		void put(const Key& key, const Value& value, std::chrono::milliseconds ttl) {
+			putWithTtl(key, nodeMap_.hash(key), value, ttl);
+		}
+
+		void put(const Key& key, Value&& value, std::chrono::milliseconds ttl) {
+			putWithTtl(key, nodeMap_.hash(key), std::move(value), ttl);
+		}
+
+		template<typename... Args>
+		void emplace(const Key& key, Args&&... args) { // 新key在节点里原地构造value；已存在则赋值并算一次访问
+			emplaceHashed(key, nodeMap_.hash(key), std::forward<Args>(args)...);
+		}
+
+		Value get(const Key& key) override {
+			Value value{};
 			get(key, value);
 			return value;
 		}
 
-		bool get(Key key, Value& value) {
-			std::lock_guard<std::mutex>lock(mutex_);
-			auto it = nodeMap_.find(key);
-			if (it != nodeMap_.end()) {
-				value = it->second->value; // 直接改不就得了
-				getInternal(it->second, value);
-				return true;
+		bool get(const Key& key, Value& value) override {
+			return getValue(key, nodeMap_.hash(key), value);
+		}
+
+		// 异构查找，例如key为std::string时直接传std::string_view/const char*
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		bool get(const K& key, Value& value) {
+			return getValue(key, nodeMap_.hash(key), value);
+		}
+
+		// 以下是带预先算好的hash的版本：调用方已经用KeyHasher算过一次（例如MyShardedCache选分片时），h必须等于keyHash(key)
+		using KeyHasher = typename NodeMap::hasher;
+
+		template<typename K>
+		uint64_t keyHash(const K& key) const { return nodeMap_.hash(key); }
+
+		template<typename K>
+		bool getHashed(const K& key, uint64_t h, Value& value) { return getValue(key, h, value); }
+
+		void putHashed(const Key& key, uint64_t h, const Value& value) { emplaceHashed(key, h, value); }
+		void putHashed(const Key& key, uint64_t h, Value&& value) { emplaceHashed(key, h, std::move(value)); }
+		void putHashed(const Key& key, uint64_t h, const Value& value, std::chrono::milliseconds ttl) { putWithTtl(key, h, value, ttl); }
+		void putHashed(const Key& key, uint64_t h, Value&& value, std::chrono::milliseconds ttl) { putWithTtl(key, h, std::move(value), ttl); }
+
+		template<typename... Args>
+		void emplaceHashed(const Key& key, uint64_t h, Args&&... args) {
+			if (capacity_ <= 0)return;
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			expireSome();
+			shrinkSome();
+			emplaceLocked(key, h, 0, std::forward<Args>(args)...); // 查找和插入共用一次hash
+		}
+
+		template<typename K>
+		bool containsHashed(const K& key, uint64_t h) {
+			Lock lock(mutex_, stats_, removals_);
+			NodePtr* it = nodeMap_.find(key, h);
+			return it != nullptr && !isExpired(*it);
+		}
+
+		// 非阻塞版本：锁被占用时返回kBusy/false，什么也不做（value也不会被移走），调用线程不等锁。给MyAsyncCache用
+		template<typename K>
+		MyTryResult tryGetHashed(const K& key, uint64_t h, Value& value) {
+			if (readBuffer_) {
+				bool expired = false;
+				bool busy = false;
+				if (getShared(key, h, value, expired, &busy))
+					return MyTryResult::kHit;
+				if (busy)
+					return MyTryResult::kBusy;
+				if (!expired)
+					return MyTryResult::kMiss;
 			}
-			return false;
+
+			Lock lock(mutex_, removals_, std::try_to_lock);
+			if (!lock.ownsLock())
+				return MyTryResult::kBusy;
+			return getLocked(key, h, value) ? MyTryResult::kHit : MyTryResult::kMiss;
+		}
+
+		bool tryPutHashed(const Key& key, uint64_t h, const Value& value) { return tryPutInternal(key, h, value); }
+		bool tryPutHashed(const Key& key, uint64_t h, Value&& value) { return tryPutInternal(key, h, std::move(value)); }
+
+		MyTryResult tryEraseHashed(const Key& key, uint64_t h) {
+			Lock lock(mutex_, removals_, std::try_to_lock);
+			if (!lock.ownsLock())
+				return MyTryResult::kBusy;
+			return eraseLocked(key, h) ? MyTryResult::kHit : MyTryResult::kMiss;
+		}
+
+		// 批量读：整批只加一次锁，每kBatchChunk个key先算hash并预取索引，再依次探测
+		size_t getMany(const Key* keys, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) override {
+			return getManyHashed(keys, nullptr, count, values, hits, indices);
+		}
+
+		// 带预先算好的hash的批量读写：keyHashes[i]是keys[batchIndex(indices, i)]的hash，和indices一一对应；为nullptr时自己算
+		size_t getManyHashed(const Key* keys, const uint64_t* keyHashes, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) {
+			size_t hitCount = 0;
+			uint64_t hashes[detail::kBatchChunk];
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			expireSome();
+			shrinkSome();
+			for (size_t base = 0; base < count; base += detail::kBatchChunk) {
+				size_t n = std::min(detail::kBatchChunk, count - base);
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = keyHashes != nullptr ? keyHashes[base + i] : nodeMap_.hash(keys[detail::batchIndex(indices, base + i)]);
+					nodeMap_.prefetch(hashes[i]);
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t idx = detail::batchIndex(indices, base + i);
+					NodePtr* it = nodeMap_.find(keys[idx], hashes[i]);
+					if (it != nullptr && isExpired(*it)) {
+						notifyRemoval(*it, MyRemovalCause::kExpired);
+						removeNode(*it);
+						stats_.expiration();
+						it = nullptr;
+					}
+					hits[idx] = it != nullptr;
+					if (it != nullptr) {
+						values[idx] = (*it)->value;
+						getInternal(*it);
+						hitCount++;
+					}
+				}
+			}
+			stats_.hit(hitCount);
+			stats_.miss(count - hitCount);
+			return hitCount;
+		}
+
+		void putMany(const Key* keys, const Value* values, size_t count, const uint32_t* indices = nullptr) override {
+			putManyHashed(keys, nullptr, values, count, indices);
 		}
 
-		// 清空缓存,回收资源 ??????????
+		void putManyHashed(const Key* keys, const uint64_t* keyHashes, const Value* values, size_t count, const uint32_t* indices = nullptr) {
+			if (capacity_ <= 0)return;
+			uint64_t hashes[detail::kBatchChunk];
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			expireSome();
+			shrinkSome();
+			for (size_t base = 0; base < count; base += detail::kBatchChunk) {
+				size_t n = std::min(detail::kBatchChunk, count - base);
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = keyHashes != nullptr ? keyHashes[base + i] : nodeMap_.hash(keys[detail::batchIndex(indices, base + i)]);
+					nodeMap_.prefetch(hashes[i]);
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t idx = detail::batchIndex(indices, base + i);
+					emplaceLocked(keys[idx], hashes[i], 0, values[idx]);
+				}
+			}
+		}
+
+		size_t weightedSize() { // 当前总权重；没有weigher时等于条目数
+			Lock lock(mutex_, stats_, removals_);
+			return weightedSize_;
+		}
+
+		size_t purgeExpired() { // 立即回收所有已过期的条目，返回回收个数
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			return expireSome(SIZE_MAX);
+		}
+
+		MyCacheStats stats() const { // 不加锁
+			return stats_.snapshot();
+		}
+
+		MyCacheProfile profile() const { // 同样不加锁；没开MYCACHE_PROFILE时enabled为false
+			return stats_.profile().snapshot();
+		}
+
+		// 条目被淘汰、过期或删除时的回调，在解锁后调用
+		void setEvictionListener(EvictionListener listener) {
+			Lock lock(mutex_, stats_, removals_);
+			removals_.setListener(std::move(listener));
+		}
+
+		// 运行时调整容量（条目数或总权重）。调大立即生效；调小时这次调用和之后的每次操作各淘汰最多kShrinkBatch个条目，
+		// 直到降到新容量以内；调到0或负数时立即全部淘汰（原因是kEvicted）。收缩期间插入新条目只腾出和它等量的位置，总量只降不升
+		void setCapacity(int capacity) {
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			capacity_.store(capacity, std::memory_order_relaxed);
+			shrinkSome(capacity > 0 ? kShrinkBatch : SIZE_MAX); // 容量<=0时put直接返回、不会再分批收缩，这里一次淘汰干净
+		}
+
+		int capacity() const { return capacity_.load(std::memory_order_relaxed); }
+
+		// 打开读缓冲：之后get命中只拿共享锁查索引、拷贝value，把节点记进条带化的读缓冲就返回，
+		// 换桶、频次+1和老化攒成一批，由try_lock成功的读线程、下一个独占操作或者cleanUp()统一回放。
+		// 缓冲满时丢掉的访问不计频次，频次会略微偏低。在开始并发使用之前调用；stripeNum为0时按hardware_concurrency()取
+		void enableReadBuffer(size_t stripeNum = 0) {
+			Lock lock(mutex_, stats_, removals_);
+			if (!readBuffer_)
+				readBuffer_ = std::make_unique<MyReadBuffer<Node>>(stripeNum);
+		}
+
+		// 回放读缓冲里攒下的访问，顺带回收最多kExpireBatch个过期条目；给维护线程定期调用
+		void cleanUp() {
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			expireSome();
+			shrinkSome();
+		}
+
+		bool erase(const Key& key) override {
+			return eraseHashed(key, nodeMap_.hash(key));
+		}
+
+		bool eraseHashed(const Key& key, uint64_t h) {
+			Lock lock(mutex_, stats_, removals_);
+			return eraseLocked(key, h);
+		}
+
+		void clear() override {
+			purge();
+		}
+
+		bool contains(const Key& key) override { // 只查不算一次访问
+			return containsHashed(key, nodeMap_.hash(key));
+		}
+
+		size_t size() override {
+			Lock lock(mutex_, stats_, removals_);
+			return nodeMap_.size();
+		}
+
+		// 按频次从高到低、同频次内从新到旧把条目和实际频次写进快照文件，带ttl的条目记下剩余时间，返回是否写成功。
+		// 锁内只把条目编码进内存缓冲，得到一致的快照，写文件在锁外进行
+		template<typename KeySerializer = MySerializer<Key>, typename ValueSerializer = MySerializer<Value>>
+		bool saveSnapshot(const std::string& path) {
+			MySnapshotWriter writer(MySnapshotKind::kLfu);
+			{
+				Lock lock(mutex_, stats_, removals_);
+				drainReads();
+				uint64_t now = timerWheel_ ? nowTick() : 0;
+				for (FreqListType* list = freqTail_->prevList_; list != freqHead_; list = list->prevList_) {
+					uint32_t freq = static_cast<uint32_t>(getFreq(list));
+					for (NodePtr node = list->tail_.prev; node != &list->head_; node = node->prev) {
+						if (node->expireTick != 0 && node->expireTick <= now)
+							continue;
+						KeySerializer::write(writer, node->key);
+						ValueSerializer::write(writer, node->value);
+						writer.write(freq);
+						writer.write<uint64_t>(node->expireTick != 0 ? node->expireTick - now : 0);
+						writer.endRecord();
+					}
+				}
+			}
+			return writer.saveTo(path);
+		}
+
+		// 从saveSnapshot写的文件热启动，返回装入的条目数。文件整个映射进来，先在锁外完整解码校验一遍，再在一次加锁内顺序解码，
+		// 节点按快照里的频次直接放进对应的桶，不走put，也不计入put统计；记录按频次降序，找桶的位置只会单向移动。
+		// 已有的key保留现值；放不下时不装，不会为了快照淘汰现有条目；文件截断或损坏时一条都不装，返回0
+		template<typename KeySerializer = MySerializer<Key>, typename ValueSerializer = MySerializer<Value>>
+		size_t loadSnapshot(const std::string& path) {
+			if (capacity_ <= 0)return 0;
+
+			MyMappedFile file(path);
+			MySnapshotReader reader(file, MySnapshotKind::kLfu, sizeof(uint32_t) + sizeof(uint64_t)); // 每条记录至少有频次和ttl
+			Key key{};
+			Value value{};
+			bool intact = reader.verify([&key, &value](MySnapshotReader& in) {
+				uint32_t freq = 0;
+				uint64_t ttl = 0;
+				return KeySerializer::read(in, key) && ValueSerializer::read(in, value) && in.read(freq) && in.read(ttl);
+			});
+			if (!intact)
+				return 0;
+
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			if (weigher_) { // 条目数模式构造时已经按容量预留过
+				nodeMap_.reserve(nodeMap_.size() + static_cast<size_t>(reader.count()));
+				nodePool_.reserve(nodePool_.size() + static_cast<size_t>(reader.count()));
+			}
+			uint64_t now = 0;
+			size_t loaded = 0;
+			FreqListType* cursor = freqTail_; // 第一个原始频次大于当前记录的桶
+			for (uint64_t i = 0; i < reader.count(); i++) {
+				uint32_t freq = 0;
+				uint64_t ttl = 0;
+				if (!KeySerializer::read(reader, key) || !ValueSerializer::read(reader, value) || !reader.read(freq) || !reader.read(ttl))
+					break;
+				if (!weigher_ && nodeMap_.size() >= static_cast<size_t>(capacity_))
+					break; // 后面的记录频次更低
+				uint64_t h = nodeMap_.hash(key);
+				if (nodeMap_.find(key, h) != nullptr)
+					continue;
+
+				NodePtr node = nodePool_.allocate(key, std::move(value));
+				node->storeHash(h);
+				if (weigher_) {
+					node->weight = weigher_(node->key, node->value);
+					if (weightedSize_ + node->weight > static_cast<size_t>(capacity_)) {
+						nodePool_.deallocate(node);
+						continue;
+					}
+				}
+				int count = static_cast<int>(std::min<uint32_t>(std::max<uint32_t>(freq, 1), kMaxLoadedFreq));
+				int raw = ageBase_ + count;
+				while (cursor->prevList_ != freqHead_ && cursor->prevList_->freq_ > raw) cursor = cursor->prevList_;
+				while (cursor != freqTail_ && cursor->freq_ <= raw) cursor = cursor->nextList_;
+				FreqListType* list = cursor->prevList_;
+				if (list == freqHead_ || list->freq_ != raw)
+					list = acquireFreqList(list, raw);
+				list->addFirstNode(node);
+				nodeMap_.emplace(key, node, h);
+				weightedSize_ += node->weight;
+				curTotalNum_ += count;
+				if (ttl != 0) {
+					if (now == 0) now = nowTick();
+					if (!timerWheel_) timerWheel_ = std::make_unique<MyTimingWheel>(now);
+					timerWheel_->schedule(node, now + ttl);
+				}
+				loaded++;
+			}
+			if (loaded > 0) {
+				curAverageNum_ = static_cast<int>(curTotalNum_ / static_cast<long long>(nodeMap_.size()));
+				while (curAverageNum_ > maxAverageNum_ && maxAverageNum_ / 2 > 0) { // 快照的频次整体偏高时照常老化
+					handleOverMaxAverageNum();
+				}
+			}
+			return loaded;
+		}
+
+		// 清空缓存,回收资源：节点和频次桶全部还给各自的池
 		void purge()
 		{
-			nodeMap_.clear();
-			freqToFreqList_.clear();
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			releaseAll(true);
 		}
 
 	private:
-		void putInternal(Key key, Value value){ // 添加缓存
-			// 新建一个节点，先判断是否大于capacity,加入到对应的Freqlist
-			NodePtr node = std::make_shared<Node>(key,value);
-			if (nodeMap_.size() >= capacity_) { kickOut(); }
-			nodeMap_[key] = node;
-			addToFreqList(node);
-		}
-		void getInternal(NodePtr node, Value& value) { // 获取缓存
+		static constexpr size_t kAgingBatch = 16; // 每次操作最多合并多少个老化后频次归1的节点
+		static constexpr size_t kExpireBatch = 16; // 每次操作顺带回收的过期条目上限
+		static constexpr size_t kShrinkBatch = 64; // 容量调小后每次操作最多淘汰的条目数
+		static constexpr uint32_t kMaxLoadedFreq = 1u << 16; // 加载快照时频次的上限，防止损坏的文件把频次总和撑爆
+
+		using Lock = MyNotifyingLock<std::shared_mutex, Key, Value>;
+
+		void releaseAll(bool notify) { // 调用方持有mutex_（析构时除外）
+			FreqListType* list = freqHead_->nextList_;
+			while (list != freqTail_) {
+				FreqListType* nextList = list->nextList_;
+				NodePtr node = list->getFirstNode();
+				while (node != &list->tail_) {
+					NodePtr next = node->next;
+					if (notify) notifyRemoval(node, MyRemovalCause::kExplicit);
+					if (timerWheel_) timerWheel_->cancel(node);
+					nodePool_.deallocate(node);
+					node = next;
+				}
+				freqListPool_.deallocate(list);
+				list = nextList;
+			}
+			freqHead_->nextList_ = freqTail_;
+			freqTail_->prevList_ = freqHead_;
+			nodeMap_.clear();
+			weightedSize_ = 0;
+			curTotalNum_ = 0;
+			curAverageNum_ = 0;
+			ageBase_ = 0;
+		}
+
+		template<typename V>
+		bool tryPutInternal(const Key& key, uint64_t h, V&& value) {
+			if (capacity_ <= 0)return true;
+			Lock lock(mutex_, removals_, std::try_to_lock);
+			if (!lock.ownsLock())
+				return false;
+			drainReads();
+			expireSome();
+			shrinkSome();
+			emplaceLocked(key, h, 0, std::forward<V>(value));
+			return true;
+		}
+
+		bool eraseLocked(const Key& key, uint64_t h) { // 调用方持有mutex_
+			drainReads();
+			NodePtr* it = nodeMap_.find(key, h);
+			if (it == nullptr)
+				return false;
+			NodePtr node = *it;
+			bool expired = isExpired(node);
+			if (expired) stats_.expiration();
+			notifyRemoval(node, expired ? MyRemovalCause::kExpired : MyRemovalCause::kExplicit);
+			removeNode(node);
+			return !expired;
+		}
+
+		template<typename K>
+		bool getValue(const K& key, uint64_t h, Value& value) {
+			if (readBuffer_) {
+				bool expired = false;
+				if (getShared(key, h, value, expired))
+					return true;
+				if (!expired)
+					return false;
+			}
+
+			Lock lock(mutex_, stats_, removals_);
+			return getLocked(key, h, value);
+		}
+
+		template<typename K>
+		bool getLocked(const K& key, uint64_t h, Value& value) { // 调用方持有mutex_
+			drainReads();
+			expireSome();
+			shrinkSome();
+			NodePtr* it = nodeMap_.find(key, h);
+			if (it != nullptr && isExpired(*it)) {
+				notifyRemoval(*it, MyRemovalCause::kExpired);
+				removeNode(*it);
+				stats_.expiration();
+				it = nullptr;
+			}
+			if (it != nullptr) {
+				value = (*it)->value; // 拷贝赋值，value原有的缓冲区够大时不会重新分配
+				getInternal(*it);
+				stats_.hit();
+				return true;
+			}
+			stats_.miss();
+			return false;
+		}
+
+		// 读缓冲模式的命中路径：共享锁下查索引、拷贝value、记一笔访问。
+		// 命中了过期条目时返回false并置expired，调用方接着走独占路径把它回收掉。
+		// busy不为空时只尝试一次共享锁，拿不到就置*busy返回false
+		template<typename K>
+		bool getShared(const K& key, uint64_t h, Value& value, bool& expired, bool* busy = nullptr) {
+			bool drain = false;
+			{
+				std::shared_lock<std::shared_mutex> lock(mutex_, std::defer_lock);
+				if (busy == nullptr) {
+					lock.lock();
+				}
+				else if (!lock.try_lock()) {
+					*busy = true;
+					return false;
+				}
+				const NodePtr* it = nodeMap_.find(key, h);
+				if (it == nullptr) {
+					stats_.sharedMiss();
+					return false;
+				}
+				if (isExpired(*it)) {
+					expired = true;
+					return false;
+				}
+				value = (*it)->value;
+				drain = readBuffer_->record(*it);
+				stats_.sharedHit();
+			}
+			if (drain)
+				tryDrainReads();
+			return true;
+		}
+
+		void drainReads() { // 调用方持有独占锁
+			if (readBuffer_)
+				readBuffer_->drain([this](NodePtr node) { getInternal(node); });
+		}
+
+		void tryDrainReads() { // 读缓冲攒到一半时由读线程顺手回放；拿不到锁就留给下一个拿独占锁的线程
+			if (!mutex_.try_lock())
+				return;
+			std::lock_guard<std::shared_mutex> lock(mutex_, std::adopt_lock);
+			drainReads();
+		}
+
+		template<typename V>
+		void putWithTtl(const Key& key, uint64_t h, V&& value, std::chrono::milliseconds ttl) {
+			if (capacity_ <= 0)return;
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			if (ttl.count() <= 0) {
+				NodePtr* it = nodeMap_.find(key, h);
+				if (it != nullptr) {
+					notifyRemoval(*it, MyRemovalCause::kExplicit);
+					removeNode(*it);
+				}
+				return;
+			}
+			uint64_t now = nowTick();
+			if (!timerWheel_) timerWheel_ = std::make_unique<MyTimingWheel>(now);
+			expireSome(kExpireBatch, now);
+			shrinkSome();
+			emplaceLocked(key, h, now + static_cast<uint64_t>(ttl.count()), std::forward<V>(value));
+		}
+
+		template<typename... Args>
+		void emplaceLocked(const Key& key, uint64_t h, uint64_t expireTick, Args&&... args) { // 调用方持有mutex_；expireTick为0表示永不过期
+			stats_.put();
+			NodePtr* it = nodeMap_.find(key, h);
+			NodePtr node = nullptr;
+			if (it != nullptr) {
+				node = *it;
+				assignValue(node->value, std::forward<Args>(args)...);
+				if (weigher_ && !reweigh(node))
+					return;
+				getInternal(node); // 相当于访问一次
+			}
+			else {
+				node = putInternal(key, h, std::forward<Args>(args)...);
+				if (node == nullptr)
+					return;
+			}
+			if (expireTick != 0) {
+				timerWheel_->schedule(node, expireTick);
+			}
+			else if (node->expireTick != 0) {
+				timerWheel_->cancel(node);
+				node->expireTick = 0;
+			}
+		}
+
+		uint64_t nowTick() const {
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch_);
+			return static_cast<uint64_t>(elapsed.count()) + 1;
+		}
+
+		bool isExpired(NodePtr node) const { // 只有带ttl的节点才读时钟
+			return node->expireTick != 0 && node->expireTick <= nowTick();
+		}
+
+		// 推进时间轮，回收最多budget个已过期的条目；没有带ttl的条目时直接返回，不读时钟
+		size_t expireSome(size_t budget = kExpireBatch, uint64_t now = 0) {
+			if (!timerWheel_ || (timerWheel_->empty() && now == 0))
+				return 0;
+			return timerWheel_->advance(now != 0 ? now : nowTick(), [this](MyTimerHook* hook) {
+				NodePtr node = static_cast<NodePtr>(hook);
+				notifyRemoval(node, MyRemovalCause::kExpired);
+				removeNode(node);
+				stats_.expiration();
+			}, budget);
+		}
+
+		// 值更新后重算权重，超出预算时淘汰其他节点；新值本身放不下就连节点一起删掉并返回false
+		bool reweigh(NodePtr node) {
+			size_t weight = weigher_(node->key, node->value);
+			if (weight > static_cast<size_t>(capacity_)) {
+				notifyRemoval(node, MyRemovalCause::kEvicted);
+				removeNode(node);
+				return false;
+			}
+			size_t limit = std::max(static_cast<size_t>(capacity_), weightedSize_); // 收缩期间不让总量再涨
+			weightedSize_ = weightedSize_ - node->weight + weight;
+			node->weight = weight;
+			while (weightedSize_ > limit) {
+				kickOut(node);
+			}
+			return true;
+		}
+
+		template<typename V>
+		static void assignValue(Value& target, V&& value) { target = std::forward<V>(value); }
+
+		template<typename... Args>
+		static void assignValue(Value& target, Args&&... args) { target = Value(std::forward<Args>(args)...); }
+
+		template<typename... Args>
+		NodePtr putInternal(const Key& key, uint64_t h, Args&&... args){ // 添加缓存，返回新节点；权重超过容量被拒绝时返回nullptr
+			// 先构造节点算出权重，淘汰到放得下，再加入频次为1的桶
+			NodePtr node = nodePool_.allocate(key, std::forward<Args>(args)...);
+			node->storeHash(h);
+			if (weigher_) {
+				node->weight = weigher_(node->key, node->value);
+				if (node->weight > static_cast<size_t>(capacity_)) { // 单个条目超过总容量，拒绝
+					nodePool_.deallocate(node);
+					return nullptr;
+				}
+			}
+			// 收缩期间总量已经超过容量，这里只腾出和新条目等量的位置，积压的部分留给shrinkSome分批淘汰
+			size_t limit = std::max(static_cast<size_t>(capacity_), weightedSize_);
+			while (weightedSize_ + node->weight > limit && !nodeMap_.empty()) { kickOut(); }
+			nodeMap_.emplace(key, node, h);
+			weightedSize_ += node->weight;
+			stats_.profile().listInsert();
+			FreqListType* first = freqHead_->nextList_;
+			if (first != freqTail_ && getFreq(first) == 1) { // 频次为1的桶都在最前面，直接放进第一个
+				first->addNode(node);
+			}
+			else {
+				addToFreqList(node, freqHead_, ageBase_ + 1);
+			}
+			mergeAgedFreqList();
+			addFreqNum();
+			return node;
+		}
+		void getInternal(NodePtr node) { // 获取缓存：移到freq+1的桶，原桶空了就回收
+			FreqListType* list = node->freqList;
+			int target = ageBase_ + getFreq(list) + 1;
+			FreqListType* prevList = list;
+			while (prevList->nextList_->freq_ < target) { // 只有老化后被截断到1的桶才需要往后找，合并后最多跨过几个桶
+				prevList = prevList->nextList_;
+			}
+			stats_.profile().listMove();
 			removeFromFreqList(node);
-			node->freq++;
-			addToFreqList(node);
-			if (node->freq == minFreq_ + 1 && freqToFreqList_[minFreq_]->isEmpty()) {
-				minFreq_++;
+			addToFreqList(node, prevList, target);
+			if (list->isEmpty()) {
+				releaseFreqList(list);
 			}
+			mergeAgedFreqList();
 			addFreqNum();
 		}
 
-		void kickOut() { // 移除缓存中的过期数据
-			NodePtr node = freqToFreqList_[minFreq_]->getFirstNode();
-			nodeMap_.erase(node->key);
+		int getFreq(const FreqListType* list) const { // 桶的实际频次
+			int freq = list->freq_ - ageBase_;
+			return freq < 1 ? 1 : freq;
+		}
+
+		void kickOut(NodePtr keep = nullptr) { // 移除缓存中的过期数据：最小频次桶里最久未访问的节点，跳过keep（刚更新、正在腾地方的节点）
+			FreqListType* list = freqHead_->nextList_;
+			NodePtr node = list->getFirstNode();
+			if (node == keep) {
+				node = node->next;
+				if (node == &list->tail_) {
+					list = list->nextList_;
+					node = list->getFirstNode();
+				}
+			}
+			notifyRemoval(node, MyRemovalCause::kEvicted);
+			removeNode(node);
+			stats_.eviction();
+		}
+
+		void shrinkSome(size_t batch = kShrinkBatch) { // 容量调小后分批淘汰超出的部分，没有超出时只多一次比较
+			int capacity = capacity_.load(std::memory_order_relaxed);
+			size_t limit = capacity > 0 ? static_cast<size_t>(capacity) : 0;
+			for (size_t n = 0; n < batch && (weightedSize_ > limit || capacity <= 0) && !nodeMap_.empty(); n++) { // 容量为0时权重为0的条目也要清掉
+				kickOut();
+			}
+		}
+
+		uint64_t nodeHash(NodePtr node) const { // 节点里存了hash就直接用
+			if constexpr (detail::kCacheHash<Key>) return node->storedHash;
+			else return nodeMap_.hash(node->key);
+		}
+
+		void notifyRemoval(NodePtr node, MyRemovalCause cause) { // 节点随后就被删掉，value直接移进通知队列
+			if (removals_.active())
+				removals_.push(node->key, std::move(node->value), cause);
+		}
+
+		void removeNode(NodePtr node) { // 从索引和桶里删掉节点，空桶回收，槽位还给节点池
+			FreqListType* list = node->freqList;
+			int freq = getFreq(list);
+			nodeMap_.erase(node->key, nodeHash(node));
 			removeFromFreqList(node);
-			decreaseFreqNum(node->freq);
+			stats_.profile().listRemove();
+			if (list->isEmpty()) {
+				releaseFreqList(list);
+			}
+			weightedSize_ -= node->weight;
+			if (node->expireTick != 0)
+				timerWheel_->cancel(node);
+			nodePool_.deallocate(node);
+			decreaseFreqNum(freq);
 		}
 
 		void removeFromFreqList(NodePtr node) { // 从频率列表中移除节点
@@ -157,23 +835,35 @@ namespace MyCache {
 			if (!node)
 				return;
 
-			auto freq = node->freq;
-			freqToFreqList_[freq]->remove(node);
+			node->freqList->remove(node);
 		}
-		void addToFreqList(NodePtr node) { // 添加到频率列表
+		void addToFreqList(NodePtr node, FreqListType* prevList, int freq) { // 添加到prevList之后频次为freq的桶，桶不存在就紧跟着prevList新建一个
 			// 检查结点是否为空
 			if (!node)
 				return;
 
-			// 添加进入相应的频次链表前需要判断该频次链表是否存在
-			auto freq = node->freq;
-			if (freqToFreqList_.find(node->freq) == freqToFreqList_.end())
+			FreqListType* list = prevList->nextList_;
+			if (list->freq_ != freq)
 			{
-				// 不存在则创建
-				freqToFreqList_[node->freq] = new Freqlist<Key, Value>(node->freq);
+				list = acquireFreqList(prevList, freq);
 			}
 
-			freqToFreqList_[freq]->addNode(node);
+			list->addNode(node);
+		}
+
+		FreqListType* acquireFreqList(FreqListType* prevList, int freq) { // 从池里取一个桶并链到prevList之后
+			FreqListType* list = freqListPool_.allocate(freq);
+			list->prevList_ = prevList;
+			list->nextList_ = prevList->nextList_;
+			prevList->nextList_->prevList_ = list;
+			prevList->nextList_ = list;
+			return list;
+		}
+
+		void releaseFreqList(FreqListType* list) { // 把空桶摘下来还给池
+			list->prevList_->nextList_ = list->nextList_;
+			list->nextList_->prevList_ = list->prevList_;
+			freqListPool_.deallocate(list);
 		}
 
 		void addFreqNum() { // 增加平均访问等频率
@@ -181,7 +871,7 @@ namespace MyCache {
 			if (nodeMap_.empty())
 				curAverageNum_ = 0;
 			else
-				curAverageNum_ = curTotalNum_ / nodeMap_.size();
+				curAverageNum_ = static_cast<int>(curTotalNum_ / static_cast<long long>(nodeMap_.size()));
 
 			if (curAverageNum_ > maxAverageNum_)
 			{
@@ -193,46 +883,61 @@ namespace MyCache {
 			if (nodeMap_.empty())
 				curAverageNum_ = 0;
 			else
-				curAverageNum_ = curTotalNum_ / nodeMap_.size();
+				curAverageNum_ = static_cast<int>(curTotalNum_ / static_cast<long long>(nodeMap_.size()));
 		}
-		void handleOverMaxAverageNum() { // 处理当前平均访问频率超过上限的情况 把所以不为空的节点都取出来，使其freq_ = min(1,freq_ - maxAverageNum_ / 2);
+		void handleOverMaxAverageNum() { // 处理当前平均访问频率超过上限的情况 所有节点freq = max(1,freq - maxAverageNum_ / 2);
 			if (nodeMap_.empty())
 				return;
 
-			// 当前平均访问频次已经超过了最大平均访问频次，所有结点的访问频次- (maxAverageNum_ / 2)
-			for (auto it = nodeMap_.begin(); it != nodeMap_.end(); ++it)
-			{
-				// 检查结点是否为空
-				if (!it->second)
-					continue;
-
-				NodePtr node = it->second;
-
-				// 先从当前频率列表中移除
-				removeFromFreqList(node);
-
-				// 减少频率
-				node->freq -= maxAverageNum_ / 2;
-				if (node->freq < 1) node->freq = 1;
-
-				// 添加到新的频率列表
-				addToFreqList(node);
+			// 不逐个改节点：抬高老化基准，所有桶的实际频次同时减少decrease且顺序不变。
+			// 只需要看原始频次落在(旧基准+1, 新基准+1)内的桶（最多decrease个）把频次总和算准，
+			// 实际频次变成1的桶留给mergeAgedFreqList在后续操作里合并
+			int decrease = maxAverageNum_ / 2;
+			if (decrease <= 0)
+				return;
+			uint64_t begin = MyProfileCounter::now();
+			int oldBase = ageBase_;
+			ageBase_ += decrease;
+			stats_.agingRun();
+
+			long long loss = 0;
+			size_t partial = 0; // 减少量不足decrease的节点数
+			for (FreqListType* list = freqHead_->nextList_; list != freqTail_ && list->freq_ < ageBase_ + 1; list = list->nextList_) {
+				if (list->freq_ > oldBase + 1) {
+					loss += static_cast<long long>(list->freq_ - oldBase - 1) * static_cast<long long>(list->size_);
+				}
+				partial += list->size_;
 			}
+			loss += static_cast<long long>(decrease) * static_cast<long long>(nodeMap_.size() - partial);
+			curTotalNum_ -= loss;
+			curAverageNum_ = static_cast<int>(curTotalNum_ / static_cast<long long>(nodeMap_.size()));
 
-			// 更新最小频率
-			updateMinFreq();
+			if (ageBase_ > INT_MAX / 2) { // 基准快溢出时把原始频次整体换算成实际频次，极少发生，只遍历桶
+				for (FreqListType* list = freqHead_->nextList_; list != freqTail_; list = list->nextList_) {
+					list->freq_ = getFreq(list);
+				}
+				ageBase_ = 0;
+			}
+			stats_.profile().agingPause(MyProfileCounter::now() - begin);
 		}
-		void updateMinFreq() {
-			minFreq_ = INT8_MAX;
-			for (const auto& pair : freqToFreqList_) // ?? 为什么这样遍历？const是为了不让修改。 for(auto& [x,y] : freqToFreqList_)等同于for(auto& pair : freqToFreqList_)
-			{
-				if (pair.second && !pair.second->isEmpty())
-				{
-					minFreq_ = std::min(minFreq_, pair.first);
+
+		void mergeAgedFreqList() { // 把实际频次同为1的相邻桶合并到第一个桶，每次最多挪kAgingBatch个节点
+			FreqListType* floorList = freqHead_->nextList_;
+			size_t budget = kAgingBatch;
+			while (budget > 0 && floorList != freqTail_) {
+				FreqListType* list = floorList->nextList_;
+				if (list == freqTail_ || list->freq_ > ageBase_ + 1)
+					return;
+				while (budget > 0 && !list->isEmpty()) {
+					NodePtr node = list->getFirstNode();
+					list->remove(node);
+					floorList->addNode(node);
+					budget--;
+				}
+				if (list->isEmpty()) {
+					releaseFreqList(list);
 				}
 			}
-			if (minFreq_ == INT8_MAX)
-				minFreq_ = 1;
 		}
 	};
 }
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "MyCachePolicy.h"
+#include "MyCacheStats.h"
+#include "MyHash.h"
+
+namespace MyCache {
+
+	namespace detail {
+
+		template<typename Cache, typename Key, typename Value, typename = void>
+		constexpr bool hasTtlPut = false;
+
+		template<typename Cache, typename Key, typename Value>
+		constexpr bool hasTtlPut<Cache, Key, Value, std::void_t<decltype(std::declval<Cache&>().put(
+			std::declval<const Key&>(), std::declval<const Value&>(), std::declval<std::chrono::milliseconds>()))>> = true;
+
+	}
+
+	// 加载统计
+	struct MyLoadingStats {
+		uint64_t loads = 0; // 调用loader的次数（含预刷新）
+		uint64_t loadFailures = 0; // loader抛异常的次数
+		uint64_t coalesced = 0; // 未命中时等在别人的加载上、自己没有回源的次数
+		uint64_t refreshes = 0; // 过期前发起的后台预刷新次数
+	};
+
+	// 回源加载的前端：getOrLoad未命中时，同一个key只有第一个请求调用loader，并发的其它请求等同一个shared_future，值只写入缓存一次。
+	// 热点key冷启动或被淘汰后，回源次数从“并发请求数”降到1。
+	// 不持有缓存，Cache可以是任意策略或MyShardedCache，只要求get(key, value&)和put(key, value)，带ttl的版本（以及预刷新）还要求put(key, value, ttl)：
+	// MyLruCache、MyLfuCache和以它们为分片的MyShardedCache都有，默认的Cache = MyCachePolicy接口里没有，要用ttl就把Cache写成具体类型。
+	// 正在加载的key按hash分散到多个条带，每个条带一把锁，不同key的加载互不影响
+	template<typename Key, typename Value, typename Cache = MyCachePolicy<Key, Value>, typename Hash = MyDefaultHash<Key>>
+	class MyLoadingCache {
+	private:
+		using Loader = std::function<Value(const Key&)>;
+
+		struct Deadline { // 带ttl加载的key：到refreshTick就在后台预刷新，过了expireTick条目已经过期，记录可以丢掉
+			uint64_t refreshTick;
+			uint64_t expireTick;
+		};
+
+		struct alignas(kCacheLineSize) Stripe {
+			std::mutex                                           mutex;
+			std::unordered_map<Key, std::shared_future<Value>, Hash> inflight; // 正在加载的key
+			std::unordered_map<Key, Deadline, Hash>              deadlines; // 只在开启预刷新时记录
+			size_t                                               pruneAt = kPruneThreshold;
+		};
+
+		static constexpr size_t kPruneThreshold = 64; // deadlines超过这个数（之后是上次清理后的两倍）时清掉已过期的记录
+
+		Cache&                                    cache_;
+		std::chrono::milliseconds                 refreshAhead_;
+		size_t                                    stripeMask_;
+		std::unique_ptr<Stripe[]>                 stripes_;
+		Hash                                      hash_;
+		std::chrono::steady_clock::time_point     epoch_;
+
+		std::atomic<uint64_t>                     loads_{ 0 };
+		std::atomic<uint64_t>                     loadFailures_{ 0 };
+		std::atomic<uint64_t>                     coalesced_{ 0 };
+		std::atomic<uint64_t>                     refreshes_{ 0 };
+
+		std::mutex                                refreshMutex_; // 保护refreshTasks_和refreshStop_
+		std::condition_variable                   refreshWake_;
+		std::deque<std::function<void()>>         refreshTasks_;
+		bool                                      refreshStop_ = false;
+		std::thread                               refresher_; // 第一次预刷新时才启动，析构时跑完剩下的刷新再join
+
+	public:
+		// refreshAhead>0时开启预刷新：带ttl加载的条目在过期前refreshAhead时间内被命中，就在后台重新加载，请求本身立刻返回旧值，
+		// 热点key不会在过期那一刻集体回源。stripeNum向上取2的幂
+		explicit MyLoadingCache(Cache& cache, std::chrono::milliseconds refreshAhead = std::chrono::milliseconds(0), size_t stripeNum = 16)
+			:cache_(cache), refreshAhead_(refreshAhead), stripeMask_(roundUpPow2(std::max<size_t>(stripeNum, 1)) - 1),
+			stripes_(new Stripe[stripeMask_ + 1]), epoch_(std::chrono::steady_clock::now()) {}
+
+		~MyLoadingCache() {
+			{
+				std::lock_guard<std::mutex> lock(refreshMutex_);
+				refreshStop_ = true;
+			}
+			refreshWake_.notify_one();
+			if (refresher_.joinable())
+				refresher_.join();
+		}
+
+		MyLoadingCache(const MyLoadingCache&) = delete;
+		MyLoadingCache& operator=(const MyLoadingCache&) = delete;
+
+		// 命中直接返回；未命中由loader(key)加载并写入缓存。loader抛出的异常原样抛给这一轮所有等待的请求，不写缓存，下一次请求重新加载
+		template<typename F>
+		Value getOrLoad(const Key& key, F&& loader) {
+			Value value{};
+			if (cache_.get(key, value))
+				return value;
+			return loadOnce(key, loader, [this, &key](const Value& loaded) { cache_.put(key, loaded); });
+		}
+
+		// 带ttl的版本，加载来的值ttl后过期
+		template<typename F>
+		Value getOrLoad(const Key& key, F&& loader, std::chrono::milliseconds ttl) {
+			static_assert(detail::hasTtlPut<Cache, Key, Value>, "带ttl的getOrLoad要求Cache提供put(key, value, ttl)");
+			Value value{};
+			if (cache_.get(key, value)) {
+				if (refreshAhead_.count() > 0)
+					maybeRefresh(key, loader, ttl);
+				return value;
+			}
+			return loadOnce(key, loader, [this, &key, ttl](const Value& loaded) { storeWithTtl(key, loaded, ttl); });
+		}
+
+		MyLoadingStats stats() const {
+			MyLoadingStats stats;
+			stats.loads = loads_.load(std::memory_order_relaxed);
+			stats.loadFailures = loadFailures_.load(std::memory_order_relaxed);
+			stats.coalesced = coalesced_.load(std::memory_order_relaxed);
+			stats.refreshes = refreshes_.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		Cache& cache() { return cache_; }
+
+	private:
+		static size_t roundUpPow2(size_t n) {
+			size_t p = 1;
+			while (p < n) p <<= 1;
+			return p;
+		}
+
+		Stripe& stripeFor(const Key& key) { // 取mixHash的高位，和分片、索引用的位错开
+			return stripes_[static_cast<size_t>(detail::hashKey(hash_, key) >> 40) & stripeMask_];
+		}
+
+		uint64_t nowTick() const {
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch_).count());
+		}
+
+		template<typename F, typename Store>
+		Value loadOnce(const Key& key, F& loader, Store&& store) {
+			Stripe& stripe = stripeFor(key);
+			std::promise<Value> promise;
+			{
+				std::unique_lock<std::mutex> lock(stripe.mutex);
+				auto it = stripe.inflight.find(key);
+				if (it != stripe.inflight.end()) { // 已经有人在加载，等它的结果
+					std::shared_future<Value> future = it->second;
+					lock.unlock();
+					coalesced_.fetch_add(1, std::memory_order_relaxed);
+					return future.get();
+				}
+				Value value{};
+				if (cache_.get(key, value)) // 锁外未命中之后上一轮加载刚好写完缓存
+					return value;
+				stripe.inflight.emplace(key, promise.get_future().share());
+			}
+			return runLoad(stripe, key, loader, promise, store);
+		}
+
+		// 先写缓存再撤掉inflight，中间到来的请求要么等在future上、要么直接命中缓存，不会再回源一次
+		template<typename F, typename Store>
+		Value runLoad(Stripe& stripe, const Key& key, F& loader, std::promise<Value>& promise, Store& store) {
+			loads_.fetch_add(1, std::memory_order_relaxed);
+			try {
+				Value value = loader(key);
+				store(value);
+				finishLoad(stripe, key);
+				promise.set_value(value);
+				return value;
+			}
+			catch (...) {
+				loadFailures_.fetch_add(1, std::memory_order_relaxed);
+				finishLoad(stripe, key);
+				promise.set_exception(std::current_exception());
+				throw;
+			}
+		}
+
+		void finishLoad(Stripe& stripe, const Key& key) {
+			std::lock_guard<std::mutex> lock(stripe.mutex);
+			stripe.inflight.erase(key);
+		}
+
+		void storeWithTtl(const Key& key, const Value& value, std::chrono::milliseconds ttl) {
+			cache_.put(key, value, ttl);
+			if (refreshAhead_.count() <= 0 || ttl.count() <= 0)
+				return;
+			uint64_t now = nowTick();
+			uint64_t expire = now + static_cast<uint64_t>(ttl.count());
+			uint64_t ahead = std::min<uint64_t>(static_cast<uint64_t>(refreshAhead_.count()), static_cast<uint64_t>(ttl.count()));
+			Stripe& stripe = stripeFor(key);
+			std::lock_guard<std::mutex> lock(stripe.mutex);
+			stripe.deadlines[key] = Deadline{ expire - ahead, expire };
+			if (stripe.deadlines.size() >= stripe.pruneAt)
+				pruneDeadlines(stripe, now);
+		}
+
+		// 已经过期的记录对应的条目要么已被回收要么下次get就会失效，丢掉它们让deadlines只保留最近一个ttl内加载过的key
+		void pruneDeadlines(Stripe& stripe, uint64_t now) {
+			for (auto it = stripe.deadlines.begin(); it != stripe.deadlines.end();) {
+				if (it->second.expireTick <= now)
+					it = stripe.deadlines.erase(it);
+				else
+					++it;
+			}
+			stripe.pruneAt = std::max(kPruneThreshold, stripe.deadlines.size() * 2);
+		}
+
+		// 命中的条目进入了预刷新窗口且没有正在进行的加载，就登记一次加载、交给后台的刷新线程做。
+		// 每个key每个ttl周期最多刷新一次，刷新频率低，一个线程按顺序做就够了
+		template<typename F>
+		void maybeRefresh(const Key& key, F& loader, std::chrono::milliseconds ttl) {
+			Stripe& stripe = stripeFor(key);
+			auto promise = std::make_shared<std::promise<Value>>();
+			{
+				std::lock_guard<std::mutex> lock(stripe.mutex);
+				auto it = stripe.deadlines.find(key);
+				if (it == stripe.deadlines.end() || nowTick() < it->second.refreshTick)
+					return;
+				stripe.deadlines.erase(it);
+				if (stripe.inflight.find(key) != stripe.inflight.end())
+					return;
+				stripe.inflight.emplace(key, promise->get_future().share());
+			}
+			refreshes_.fetch_add(1, std::memory_order_relaxed);
+			Loader task(loader); // loader可能是调用方栈上的lambda，复制一份带到后台
+			{
+				std::lock_guard<std::mutex> lock(refreshMutex_);
+				refreshTasks_.emplace_back([this, &stripe, key, task = std::move(task), promise, ttl]() mutable {
+					auto store = [this, &key, ttl](const Value& loaded) { storeWithTtl(key, loaded, ttl); };
+					try {
+						runLoad(stripe, key, task, *promise, store);
+					}
+					catch (...) {} // 刷新失败时旧值留到过期，下次未命中在前台重新加载
+				});
+				if (!refresher_.joinable())
+					refresher_ = std::thread([this] { refreshLoop(); });
+			}
+			refreshWake_.notify_one();
+		}
+
+		void refreshLoop() { // 停止前把已登记的刷新都做完，它们占着inflight，可能有请求在等结果
+			std::unique_lock<std::mutex> lock(refreshMutex_);
+			while (true) {
+				refreshWake_.wait(lock, [this] { return refreshStop_ || !refreshTasks_.empty(); });
+				if (refreshTasks_.empty())
+					return;
+				std::function<void()> task = std::move(refreshTasks_.front());
+				refreshTasks_.pop_front();
+				lock.unlock();
+				task();
+				lock.lock();
+			}
+		}
+	};
+
+}
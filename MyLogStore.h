@@ -0,0 +1,405 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "MyCacheSnapshot.h"
+#include "MyHash.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace MyCache {
+
+	// 只追加写、按偏移读的文件。只有一个线程追加，读可以多个线程并发（pread / 带偏移的ReadFile），析构时关闭并删除
+	class MyLogFile {
+	private:
+		std::string path_;
+		uint64_t    size_;
+#if defined(_WIN32)
+		HANDLE      file_;
+#else
+		int         fd_;
+#endif
+
+	public:
+		explicit MyLogFile(std::string path) :path_(std::move(path)), size_(0) {
+#if defined(_WIN32)
+			file_ = ::CreateFileA(path_.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+			fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+#endif
+		}
+
+		~MyLogFile() {
+#if defined(_WIN32)
+			if (file_ != INVALID_HANDLE_VALUE) ::CloseHandle(file_);
+#else
+			if (fd_ >= 0) ::close(fd_);
+#endif
+			std::remove(path_.c_str());
+		}
+
+		MyLogFile(const MyLogFile&) = delete;
+		MyLogFile& operator=(const MyLogFile&) = delete;
+
+		bool isOpen() const {
+#if defined(_WIN32)
+			return file_ != INVALID_HANDLE_VALUE;
+#else
+			return fd_ >= 0;
+#endif
+		}
+
+		uint64_t size() const { return size_; }
+
+		bool append(const char* data, size_t size) { // 只由写线程调用
+			uint64_t offset = size_;
+			while (size > 0) {
+				size_t written = 0;
+#if defined(_WIN32)
+				OVERLAPPED ov{};
+				ov.Offset = static_cast<DWORD>(offset);
+				ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+				DWORD n = 0;
+				DWORD chunk = size > (1u << 30) ? (1u << 30) : static_cast<DWORD>(size);
+				if (!::WriteFile(file_, data, chunk, &n, &ov))
+					return false;
+				written = n;
+#else
+				ssize_t n = ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+				if (n <= 0)
+					return false;
+				written = static_cast<size_t>(n);
+#endif
+				data += written;
+				size -= written;
+				offset += written;
+			}
+			size_ = offset;
+			return true;
+		}
+
+		bool readAt(uint64_t offset, char* out, size_t size) const {
+			while (size > 0) {
+				size_t got = 0;
+#if defined(_WIN32)
+				OVERLAPPED ov{};
+				ov.Offset = static_cast<DWORD>(offset);
+				ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+				DWORD n = 0;
+				DWORD chunk = size > (1u << 30) ? (1u << 30) : static_cast<DWORD>(size);
+				if (!::ReadFile(file_, out, chunk, &n, &ov) || n == 0)
+					return false;
+				got = n;
+#else
+				ssize_t n = ::pread(fd_, out, size, static_cast<off_t>(offset));
+				if (n <= 0)
+					return false;
+				got = static_cast<size_t>(n);
+#endif
+				out += got;
+				size -= got;
+				offset += got;
+			}
+			return true;
+		}
+	};
+
+	struct MyLogStoreStats {
+		uint64_t demoted = 0; // 写进日志的条目数
+		uint64_t demoteDropped = 0; // 写线程跟不上、待写队列满了被丢弃的条目数
+		uint64_t bytesWritten = 0;
+		uint64_t reads = 0; // 读盘次数（待写队列里命中的不算）
+		uint64_t segmentsDropped = 0; // 因为总段数超限被整段丢弃的段数
+	};
+
+	// 日志结构的二级存储：条目追加写进固定大小的段文件，内存里的索引记住每个key所在的段、偏移和长度，查一次只读一次盘。
+	// demote只把条目放进内存里的待写队列，后台线程攒够一批（或者等flushInterval）后编码成一块连续写进当前段；
+	// 段写满就开新段，段数超过maxSegments时整段丢弃最老的段，相当于按写入顺序做FIFO淘汰，不需要做碎片整理。
+	// 被覆盖或删除的旧记录只是不再被索引引用，随所在的段一起回收
+	template<typename Key, typename Value, typename KeySerializer = MySerializer<Key>, typename ValueSerializer = MySerializer<Value>,
+		typename Hash = MyDefaultHash<Key>>
+	class MyLogStore {
+	public:
+		struct Options {
+			std::string               path; // 段文件名为path.0、path.1……
+			uint64_t                  segmentBytes = 64ull << 20;
+			size_t                    maxSegments = 16;
+			size_t                    maxPending = 1 << 16; // 待写队列上限，超过就丢弃新的demote，不让二级存储拖慢一级缓存
+			size_t                    writeBatch = 256; // 攒够这么多条立即写
+			std::chrono::milliseconds flushInterval = std::chrono::milliseconds(10); // 不够一批时最多等这么久
+		};
+
+	private:
+		struct Location {
+			uint32_t segment;
+			uint32_t size;
+			uint64_t offset;
+		};
+
+		struct Segment {
+			uint32_t         id;
+			MyLogFile        file;
+			std::vector<Key> keys; // 写进这个段的key，丢弃整段时只需要检查这些key的索引，不用扫整个索引
+
+			Segment(uint32_t segmentId, const std::string& path) :id(segmentId), file(path + "." + std::to_string(segmentId)) {}
+		};
+
+		using SegmentPtr = std::shared_ptr<Segment>; // 读盘在锁外进行，读的线程持有引用，段被丢弃后文件等最后一个读者完成才删除
+
+		Options                                     options_;
+		std::mutex                                  mutex_;
+		std::condition_variable                     wake_;
+		std::unordered_map<Key, Value, Hash>        pending_; // 等待写盘
+		std::unordered_map<Key, Value, Hash>        writing_; // 写线程正在编码和写盘的一批，只有写线程能修改
+		std::unordered_set<Key, Hash>               cancelled_; // writing_里已经被erase的key，写完后不进索引
+		std::unordered_map<Key, Location, Hash>     index_;
+		std::deque<SegmentPtr>                      segments_; // 按id递增，front最老
+		bool                                        stop_;
+
+		std::atomic<uint64_t>                       demoted_{ 0 };
+		std::atomic<uint64_t>                       demoteDropped_{ 0 };
+		std::atomic<uint64_t>                       bytesWritten_{ 0 };
+		std::atomic<uint64_t>                       reads_{ 0 };
+		std::atomic<uint64_t>                       segmentsDropped_{ 0 };
+
+		std::thread                                 writer_; // 最后构造，其它成员都已就绪
+
+	public:
+		explicit MyLogStore(Options options) :options_(std::move(options)), stop_(false) {
+			if (options_.maxSegments == 0) options_.maxSegments = 1;
+			segments_.push_back(std::make_shared<Segment>(0, options_.path));
+			writer_ = std::thread([this] { writeLoop(); });
+		}
+
+		~MyLogStore() { // 还没写盘的条目直接丢掉，二级存储本来就是可以丢的缓存
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+				pending_.clear();
+			}
+			wake_.notify_one();
+			writer_.join();
+		}
+
+		MyLogStore(const MyLogStore&) = delete;
+		MyLogStore& operator=(const MyLogStore&) = delete;
+
+		// 放进待写队列，同一个key还没写盘的旧值直接被新值覆盖。通常在一级缓存的锁内调用，只做一次哈希表插入
+		void demote(const Key& key, Value&& value) {
+			bool wake = false;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				auto it = pending_.find(key);
+				if (it != pending_.end()) {
+					it->second = std::move(value);
+					return;
+				}
+				if (pending_.size() >= options_.maxPending) {
+					demoteDropped_.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				pending_.emplace(key, std::move(value));
+				wake = pending_.size() == options_.writeBatch;
+			}
+			if (wake)
+				wake_.notify_one();
+		}
+
+		bool get(const Key& key, Value& value) {
+			return lookup(key, value, false);
+		}
+
+		// 读出并删除，用于提升回一级缓存
+		bool take(const Key& key, Value& value) {
+			return lookup(key, value, true);
+		}
+
+		bool erase(const Key& key) { // 返回删除前是否存在
+			std::lock_guard<std::mutex> lock(mutex_);
+			return eraseLocked(key);
+		}
+
+		bool contains(const Key& key) { // 只查内存里的索引和待写队列，不读盘
+			std::lock_guard<std::mutex> lock(mutex_);
+			return containsLocked(key);
+		}
+
+		// 清空索引和待写队列；写线程手上的那一批全部作废，写完后不进索引。段文件留着，随段轮转回收
+		void clear() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			pending_.clear();
+			index_.clear();
+			for (const auto& entry : writing_) {
+				cancelled_.insert(entry.first);
+			}
+		}
+
+		size_t size() { // 索引里的条目加上还没写盘的条目，同一个key可能同时在两边，是近似值
+			std::lock_guard<std::mutex> lock(mutex_);
+			return index_.size() + pending_.size() + writing_.size() - cancelled_.size();
+		}
+
+		MyLogStoreStats stats() const {
+			MyLogStoreStats stats;
+			stats.demoted = demoted_.load(std::memory_order_relaxed);
+			stats.demoteDropped = demoteDropped_.load(std::memory_order_relaxed);
+			stats.bytesWritten = bytesWritten_.load(std::memory_order_relaxed);
+			stats.reads = reads_.load(std::memory_order_relaxed);
+			stats.segmentsDropped = segmentsDropped_.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+	private:
+		bool containsLocked(const Key& key) const {
+			if (pending_.find(key) != pending_.end() || index_.find(key) != index_.end())
+				return true;
+			return writing_.find(key) != writing_.end() && cancelled_.find(key) == cancelled_.end();
+		}
+
+		bool eraseLocked(const Key& key) {
+			bool existed = containsLocked(key);
+			pending_.erase(key);
+			index_.erase(key);
+			if (writing_.find(key) != writing_.end())
+				cancelled_.insert(key);
+			return existed;
+		}
+
+		bool lookup(const Key& key, Value& value, bool remove) {
+			SegmentPtr segment;
+			Location location;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				auto pit = pending_.find(key);
+				if (pit != pending_.end()) {
+					if (remove) {
+						value = std::move(pit->second);
+						eraseLocked(key);
+					}
+					else {
+						value = pit->second;
+					}
+					return true;
+				}
+				auto wit = writing_.find(key);
+				if (wit != writing_.end() && cancelled_.find(key) == cancelled_.end()) { // 写线程只读它，这里也只读，不冲突
+					value = wit->second;
+					if (remove) eraseLocked(key);
+					return true;
+				}
+				auto it = index_.find(key);
+				if (it == index_.end())
+					return false;
+				location = it->second;
+				segment = segments_[location.segment - segments_.front()->id];
+			}
+
+			reads_.fetch_add(1, std::memory_order_relaxed);
+			thread_local std::vector<char> buffer;
+			buffer.resize(location.size);
+			if (!segment->file.readAt(location.offset, buffer.data(), location.size))
+				return false;
+			MySnapshotReader reader(buffer.data(), buffer.size());
+			Key stored{};
+			if (!KeySerializer::read(reader, stored) || !(stored == key) || !ValueSerializer::read(reader, value))
+				return false;
+			if (remove) {
+				std::lock_guard<std::mutex> lock(mutex_);
+				auto it = index_.find(key);
+				if (it != index_.end() && it->second.segment == location.segment && it->second.offset == location.offset) // 读盘期间没有被新值覆盖
+					index_.erase(it);
+			}
+			return true;
+		}
+
+		void writeLoop() {
+			MySnapshotWriter encoder(MySnapshotKind::kLog);
+			std::vector<std::pair<const Key*, Location>> placed;
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (true) {
+				wake_.wait_for(lock, options_.flushInterval, [this] { return stop_ || pending_.size() >= options_.writeBatch; });
+				if (stop_)
+					return;
+				if (pending_.empty())
+					continue;
+				writing_.swap(pending_); // writing_此时为空，交换后pending_也为空
+				SegmentPtr segment = segments_.back();
+				lock.unlock();
+
+				encoder.clear();
+				placed.clear();
+				for (const auto& entry : writing_) { // writing_只有本线程修改，锁外遍历安全
+					size_t begin = encoder.size();
+					KeySerializer::write(encoder, entry.first);
+					ValueSerializer::write(encoder, entry.second);
+					placed.emplace_back(&entry.first, Location{ 0, static_cast<uint32_t>(encoder.size() - begin), begin });
+				}
+				if (segment->file.size() > 0 && segment->file.size() + encoder.size() > options_.segmentBytes) {
+					segment = rotate();
+				}
+				uint64_t base = segment->file.size();
+				bool ok = segment->file.isOpen() && segment->file.append(encoder.data(), encoder.size());
+
+				lock.lock();
+				if (ok) {
+					for (auto& item : placed) {
+						const Key& key = *item.first;
+						if (cancelled_.find(key) != cancelled_.end() || pending_.find(key) != pending_.end())
+							continue; // 写盘期间被删掉，或者又有了更新的值
+						Location location = item.second;
+						location.segment = segment->id;
+						location.offset += base;
+						index_[key] = location;
+						segment->keys.push_back(key);
+					}
+					demoted_.fetch_add(placed.size(), std::memory_order_relaxed);
+					bytesWritten_.fetch_add(encoder.size(), std::memory_order_relaxed);
+				}
+				writing_.clear();
+				cancelled_.clear();
+			}
+		}
+
+		// 开一个新段；段数超限时丢弃最老的段，只摘掉仍然指向它的索引项
+		SegmentPtr rotate() {
+			SegmentPtr fresh = std::make_shared<Segment>(segments_.back()->id + 1, options_.path);
+			std::lock_guard<std::mutex> lock(mutex_);
+			segments_.push_back(fresh);
+			while (segments_.size() > options_.maxSegments) {
+				const SegmentPtr& oldest = segments_.front();
+				for (const Key& key : oldest->keys) {
+					auto it = index_.find(key);
+					if (it != index_.end() && it->second.segment == oldest->id)
+						index_.erase(it);
+				}
+				segments_.pop_front();
+				segmentsDropped_.fetch_add(1, std::memory_order_relaxed);
+			}
+			return fresh;
+		}
+	};
+
+}
@@ -1,42 +1,62 @@
 #pragma once // 防止头文件被重复包含
 
+#include <chrono>
 #include <cstring>
 #include <list> // 双向链表
 #include <memory> // 提供智能指针
+#include <algorithm>
+#include <atomic>
 #include <mutex> // 互斥量
-#include <unordered_map> // 无序map
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
 #include "MyCachePolicy.h"
+#include "MyCacheSnapshot.h"
+#include "MyCacheStats.h"
+#include "MyFlatIndex.h" // 开放寻址索引
+#include "MyNodePool.h"
+#include "MyReadBuffer.h"
+#include "MyRemovalQueue.h"
+#include "MyShardedCache.h"
+#include "MyTimingWheel.h"
 
 namespace MyCache {
 
-	template<typename Key, typename Value> class MyLruCache;
+	template<typename Key, typename Value, template<typename...> class Index> class MyLruCache;
+	template<typename Key, typename Value, template<typename...> class Index> class MyKLruCache;
 
 	template <typename Key, typename Value>
-	class MyLruNode {
+	class MyLruNode :public MyTimerHook, public detail::MyStoredHash<detail::kCacheHash<Key>> { // 继承定时钩子，带ttl的节点直接挂进时间轮；字符串这类key另存一份hash，淘汰时不用重算
 
 	private:
 		Key key_;
 		Value value_;
 		size_t visCount_;
-		std::shared_ptr<MyLruNode<Key, Value>> prev_;
-		std::shared_ptr<MyLruNode<Key, Value>> next_;
+		size_t weight_; // 插入或更新时由weigher算好，淘汰时直接减
+		MyLruNode<Key, Value>* prev_; // 节点由MyNodePool统一管理，链表指针用裸指针，没有引用计数开销
+		MyLruNode<Key, Value>* next_;
 
 
 	public:
-		MyLruNode(Key key, Value value) : key_(key), value_(value), visCount_(0), prev_(nullptr), next_(nullptr) {}
+		template<typename... Args>
+		explicit MyLruNode(const Key& key, Args&&... args) : key_(key), value_(std::forward<Args>(args)...), visCount_(0), weight_(1), prev_(nullptr), next_(nullptr) {} // value原地构造
 
-		Key getKey() {
+		const Key& getKey() const {
 			return key_;
 		}
 
-		Value getValue() {
+		const Value& getValue() const { // 返回引用，调用方决定要不要拷贝
 			return value_;
 		}
 
-		void setValue(Value value) {
+		void setValue(const Value& value) {
 			value_ = value;
 		}
 
+		void setValue(Value&& value) {
+			value_ = std::move(value);
+		}
+
 		size_t getVisCount() {
 			return visCount_;
 		}
@@ -45,78 +65,660 @@ namespace MyCache {
 			this->visCount_++;
 		}
 
-		friend class MyLruCache<Key, Value>;
+		template<typename K, typename V, template<typename...> class I> friend class MyLruCache;
 	};
 
 
 	// LRU缓存策略: 容量、一个链表、一个哈希表、一个头节点、一个尾节点、一个互斥量
-	template<typename Key, typename Value> 
+	// Index是key到节点的索引，默认开放寻址的MyFlatIndex，也可以换成MyStdIndex(std::unordered_map)
+	// 给了weigher时容量是总权重预算：插入时从最久未使用端一直淘汰到放得下，单个权重超过容量的条目直接拒绝
+	// 带ttl的put写入会过期的条目：get时检查过期时间，另外每次操作顺带推进时间轮回收最多kExpireBatch个已过期的条目
+	template<typename Key, typename Value, template<typename...> class Index = MyFlatIndex>
 	class MyLruCache: public MyCachePolicy<Key,Value> {
 
 	public:
 		using NodeType = MyLruNode<Key, Value>;
-		using NodePtr = std::shared_ptr<NodeType>;
-		using NodeMap = std::unordered_map<Key, NodePtr>;
+		using NodePtr = NodeType*;
+		using NodeMap = Index<Key, NodePtr>;
+		using Weigher = MyWeigher<Key, Value>;
+		using EvictionListener = MyEvictionListener<Key, Value>;
 
 	public: // 提供的外部方法：构造方法、put、get
-		MyLruCache(int capacity): capacity_(capacity) {
+		// 条目数模式按容量一次性预留索引和槽位（含两个哨兵和淘汰前暂存的新节点），稳定状态下不再rehash；
+		// 权重模式下容量和条目数无关，不预留
+		MyLruCache(int capacity, Weigher weigher = nullptr)
+			: capacity_(capacity), weigher_(std::move(weigher)), weightedSize_(0),
+			nodeMap_(capacity > 0 && !weigher_ ? capacity : 0),
+			nodePool_(capacity > 0 && !weigher_ ? static_cast<size_t>(capacity) + 3 : 3),
+			epoch_(std::chrono::steady_clock::now()) {
 			initialzeList();
 		}
 
-		~MyLruCache() override = default;
+		~MyLruCache() override { // 池不负责析构节点，这里沿链表逐个归还（包括哨兵）
+			NodePtr node = dummyHead_;
+			while (node != nullptr) {
+				NodePtr next = node->next_;
+				nodePool_.deallocate(node);
+				node = next;
+			}
+		}
+
+		void put(const Key& key, const Value& value) override{ // 判断key在不在链表中？在，则移到队头；否则先插入队头，size>capacity?是则弹出队尾。
+			putInternal(key, nodeMap_.hash(key), value);
+		}
 
-		void put(Key key, Value value) override{ // 判断key在不在链表中？在，则移到队头；否则先插入队头，size>capacity?是则弹出队尾。
-			if (capacity_ < 0)return;
+		void put(const Key& key, Value&& value) override{ // value直接移进节点
+			putInternal(key, nodeMap_.hash(key), std::move(value));
+		}
 
-			std::lock_guard<std::mutex> lock(mutex_); // 
-			auto it = nodeMap_.find(key);
-			if (it != nodeMap_.end()) {
-				updateExistNode(it->second, value);
-				return;
-			}
+		// 写入ttl后过期的条目；ttl<=0等于删除。不带ttl的put会把已有条目改回永不过期
+		void put(const Key& key, const Value& value, std::chrono::milliseconds ttl) {
+			putWithTtl(key, nodeMap_.hash(key), value, ttl);
+		}
 
-			addNode(key, value);
+		void put(const Key& key, Value&& value, std::chrono::milliseconds ttl) {
+			putWithTtl(key, nodeMap_.hash(key), std::move(value), ttl);
+		}
 
+		template<typename... Args>
+		void emplace(const Key& key, Args&&... args) { // 新key在节点里原地构造value；已存在则构造后移动赋值
+			emplaceHashed(key, nodeMap_.hash(key), std::forward<Args>(args)...);
 		}
 
-		Value get(Key key) override{
+		Value get(const Key& key) override{
 			Value value{}; // 这是在做什么？可以对template空参构造？
 			get(key, value);
 			return value;
 		}
 
-		bool get(Key key, Value& value) override{ // 上锁，map中找，找到先把节点移到最前，然后返回true
-			std::lock_guard<std::mutex> lock(mutex_);
-			auto it = nodeMap_.find(key);
-			if (it != nodeMap_.end()) {
-				moveToMostRecent(it->second);
-				value = it->second->getValue();
-				return true;
+		bool get(const Key& key, Value& value) override{ // 上锁，map中找，找到先把节点移到最前，然后返回true
+			return getInternal(key, nodeMap_.hash(key), value);
+		}
+
+		// 异构查找，例如key为std::string时直接传std::string_view/const char*，不构造临时key
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		bool get(const K& key, Value& value) {
+			return getInternal(key, nodeMap_.hash(key), value);
+		}
+
+		// 以下是带预先算好的hash的版本：调用方已经用KeyHasher算过一次（例如MyShardedCache选分片时），h必须等于keyHash(key)
+		using KeyHasher = typename NodeMap::hasher;
+
+		template<typename K>
+		uint64_t keyHash(const K& key) const { return nodeMap_.hash(key); }
+
+		template<typename K>
+		bool getHashed(const K& key, uint64_t h, Value& value) { return getInternal(key, h, value); }
+
+		void putHashed(const Key& key, uint64_t h, const Value& value) { putInternal(key, h, value); }
+		void putHashed(const Key& key, uint64_t h, Value&& value) { putInternal(key, h, std::move(value)); }
+		void putHashed(const Key& key, uint64_t h, const Value& value, std::chrono::milliseconds ttl) { putWithTtl(key, h, value, ttl); }
+		void putHashed(const Key& key, uint64_t h, Value&& value, std::chrono::milliseconds ttl) { putWithTtl(key, h, std::move(value), ttl); }
+
+		template<typename... Args>
+		void emplaceHashed(const Key& key, uint64_t h, Args&&... args) {
+			if (capacity_ <= 0)return;
+
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			expireSome();
+			shrinkSome();
+			stats_.put();
+			NodePtr* it = nodeMap_.find(key, h);
+			if (it != nullptr) {
+				NodePtr node = updateExistNode(*it, h, Value(std::forward<Args>(args)...));
+				if (node != nullptr)
+					setExpire(node, 0);
+				return;
 			}
-			return false;
+
+			if (hasHooks_ && !admitLocked(key, h))
+				return;
+			addNode(key, h, std::forward<Args>(args)...);
+		}
+
+		template<typename K>
+		bool containsHashed(const K& key, uint64_t h) {
+			Lock lock(mutex_, stats_, removals_);
+			NodePtr* it = nodeMap_.find(key, h);
+			return it != nullptr && !isExpired(*it);
+		}
+
+		// 非阻塞版本：锁被占用时返回kBusy/false，什么也不做（value也不会被移走），调用线程不等锁。给MyAsyncCache用
+		template<typename K>
+		MyTryResult tryGetHashed(const K& key, uint64_t h, Value& value) {
+			if (readBuffer_) {
+				bool retry = false;
+				bool busy = false;
+				if (getShared(key, h, value, retry, &busy))
+					return MyTryResult::kHit;
+				if (busy)
+					return MyTryResult::kBusy;
+				if (!retry)
+					return MyTryResult::kMiss;
+			}
+
+			Lock lock(mutex_, removals_, std::try_to_lock);
+			if (!lock.ownsLock())
+				return MyTryResult::kBusy;
+			return getLocked(key, h, value) ? MyTryResult::kHit : MyTryResult::kMiss;
+		}
+
+		bool tryPutHashed(const Key& key, uint64_t h, const Value& value) { return tryPutInternal(key, h, value); }
+		bool tryPutHashed(const Key& key, uint64_t h, Value&& value) { return tryPutInternal(key, h, std::move(value)); }
+
+		MyTryResult tryEraseHashed(const Key& key, uint64_t h) {
+			Lock lock(mutex_, removals_, std::try_to_lock);
+			if (!lock.ownsLock())
+				return MyTryResult::kBusy;
+			return eraseLocked(key, h) ? MyTryResult::kHit : MyTryResult::kMiss;
+		}
+
+		// 批量读：整批只加一次锁，每kBatchChunk个key先算hash并预取索引，再依次探测
+		size_t getMany(const Key* keys, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) override {
+			return getManyHashed(keys, nullptr, count, values, hits, indices);
+		}
+
+		// 带预先算好的hash的批量读写：keyHashes[i]是keys[batchIndex(indices, i)]的hash，和indices一一对应；为nullptr时自己算
+		size_t getManyHashed(const Key* keys, const uint64_t* keyHashes, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) {
+			size_t hitCount = 0;
+			uint64_t hashes[detail::kBatchChunk];
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			expireSome();
+			shrinkSome();
+			for (size_t base = 0; base < count; base += detail::kBatchChunk) {
+				size_t n = std::min(detail::kBatchChunk, count - base);
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = keyHashes != nullptr ? keyHashes[base + i] : nodeMap_.hash(keys[detail::batchIndex(indices, base + i)]);
+					nodeMap_.prefetch(hashes[i]);
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t idx = detail::batchIndex(indices, base + i);
+					NodePtr* it = nodeMap_.find(keys[idx], hashes[i]);
+					if (it != nullptr && isExpired(*it)) {
+						notifyRemoval(*it, MyRemovalCause::kExpired);
+						removeExistNode(*it, hashes[i]);
+						stats_.expiration();
+						it = nullptr;
+					}
+					hits[idx] = it != nullptr;
+					if (it != nullptr) {
+						moveToMostRecent(*it);
+						values[idx] = (*it)->value_;
+						hitCount++;
+					}
+					else if (hasHooks_) {
+						missLocked(keys[idx], hashes[i]);
+					}
+				}
+			}
+			stats_.hit(hitCount);
+			stats_.miss(count - hitCount);
+			return hitCount;
+		}
+
+		void putMany(const Key* keys, const Value* values, size_t count, const uint32_t* indices = nullptr) override {
+			putManyHashed(keys, nullptr, values, count, indices);
+		}
+
+		void putManyHashed(const Key* keys, const uint64_t* keyHashes, const Value* values, size_t count, const uint32_t* indices = nullptr) {
+			if (capacity_ <= 0)return;
+
+			uint64_t hashes[detail::kBatchChunk];
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			expireSome();
+			shrinkSome();
+			for (size_t base = 0; base < count; base += detail::kBatchChunk) {
+				size_t n = std::min(detail::kBatchChunk, count - base);
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = keyHashes != nullptr ? keyHashes[base + i] : nodeMap_.hash(keys[detail::batchIndex(indices, base + i)]);
+					nodeMap_.prefetch(hashes[i]);
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t idx = detail::batchIndex(indices, base + i);
+					putLocked(keys[idx], hashes[i], values[idx], 0);
+				}
+			}
+		}
+
+		bool contains(const Key& key) override { // 只查不动链表，不算一次访问
+			return containsHashed(key, nodeMap_.hash(key));
+		}
+
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		bool contains(const K& key) {
+			return containsHashed(key, nodeMap_.hash(key));
+		}
+
+		bool peek(const Key& key, Value& value) { // 读值但不提升到最近使用
+			Lock lock(mutex_, stats_, removals_);
+			NodePtr* it = nodeMap_.find(key);
+			if (it == nullptr || isExpired(*it))
+				return false;
+			value = (*it)->getValue();
+			return true;
+		}
+
+		bool erase(const Key& key) override {
+			return eraseHashed(key, nodeMap_.hash(key));
+		}
+
+		bool eraseHashed(const Key& key, uint64_t h) {
+			Lock lock(mutex_, stats_, removals_);
+			return eraseLocked(key, h);
+		}
+
+		void clear() override {
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			NodePtr node = dummyHead_->next_;
+			while (node != dummyTail_) {
+				NodePtr next = node->next_;
+				notifyRemoval(node, MyRemovalCause::kExplicit);
+				releaseNode(node);
+				node = next;
+			}
+			dummyHead_->next_ = dummyTail_;
+			dummyTail_->prev_ = dummyHead_;
+			nodeMap_.clear();
+		}
+
+		size_t size() override {
+			Lock lock(mutex_, stats_, removals_);
+			return nodeMap_.size();
+		}
+
+		size_t weightedSize() { // 当前总权重；没有weigher时等于条目数
+			Lock lock(mutex_, stats_, removals_);
+			return weightedSize_;
+		}
+
+		size_t purgeExpired() { // 立即回收所有已过期的条目，返回回收个数
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			return expireSome(SIZE_MAX);
+		}
+
+		MyCacheStats stats() const { // 不加锁
+			return stats_.snapshot();
+		}
+
+		MyCacheProfile profile() const { // 同样不加锁；没开MYCACHE_PROFILE时enabled为false
+			return stats_.profile().snapshot();
+		}
+
+		// 条目被淘汰、过期或删除时的回调，在解锁后调用
+		void setEvictionListener(EvictionListener listener) {
+			Lock lock(mutex_, stats_, removals_);
+			removals_.setListener(std::move(listener));
+		}
+
+		// 运行时调整容量（条目数或总权重），例如内存吃紧时调小。调大立即生效；
+		// 调小时这次调用和之后的每次操作各淘汰最多kShrinkBatch个条目，直到降到新容量以内，不会一次淘汰成千上万个；调到0或负数时立即全部淘汰（原因是kEvicted）。
+		// 收缩期间插入新条目只腾出和它等量的位置，总量只降不升
+		void setCapacity(int capacity) {
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			capacity_.store(capacity, std::memory_order_relaxed);
+			shrinkSome(capacity > 0 ? kShrinkBatch : SIZE_MAX); // 容量<=0时put直接返回、不会再分批收缩，这里一次淘汰干净
+		}
+
+		int capacity() const { return capacity_.load(std::memory_order_relaxed); }
+
+		// 打开读缓冲：之后get命中只拿共享锁查索引、拷贝value，把节点记进条带化的读缓冲就返回，
+		// 移到最近端的链表操作攒成一批，由try_lock成功的读线程、下一个独占操作或者cleanUp()统一回放。
+		// 淘汰顺序因此会稍有滞后，缓冲满时丢掉的访问不会回放。在开始并发使用之前调用；stripeNum为0时按hardware_concurrency()取。
+		// MyKLruCache的get要在未命中时记历史，始终走独占锁，不受影响
+		void enableReadBuffer(size_t stripeNum = 0) {
+			Lock lock(mutex_, stats_, removals_);
+			if (!readBuffer_)
+				readBuffer_ = std::make_unique<MyReadBuffer<NodeType>>(stripeNum);
+		}
+
+		// 回放读缓冲里攒下的访问，顺带回收最多kExpireBatch个过期条目；给维护线程定期调用，读多写少时缓冲不会一直积着
+		void cleanUp() {
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			expireSome();
+			shrinkSome();
+		}
+
+		// 按最近使用到最久未使用的顺序把条目写进快照文件，带ttl的条目记下剩余时间，返回是否写成功。
+		// 锁内只把条目编码进内存缓冲，得到一致的快照，写文件在锁外进行
+		template<typename KeySerializer = MySerializer<Key>, typename ValueSerializer = MySerializer<Value>>
+		bool saveSnapshot(const std::string& path) {
+			MySnapshotWriter writer(MySnapshotKind::kLru);
+			{
+				Lock lock(mutex_, stats_, removals_);
+				drainReads();
+				uint64_t now = timerWheel_ ? nowTick() : 0;
+				for (NodePtr node = dummyTail_->prev_; node != dummyHead_; node = node->prev_) {
+					if (node->expireTick != 0 && node->expireTick <= now)
+						continue;
+					KeySerializer::write(writer, node->key_);
+					ValueSerializer::write(writer, node->value_);
+					writer.write<uint64_t>(node->expireTick != 0 ? node->expireTick - now : 0);
+					writer.endRecord();
+				}
+			}
+			return writer.saveTo(path);
+		}
+
+		// 从saveSnapshot写的文件热启动，返回装入的条目数。文件整个映射进来，先在锁外完整解码校验一遍，再在一次加锁内顺序解码，
+		// 节点直接按原来的先后顺序接到最久未使用端，不走put，也不计入put统计。
+		// 已有的key保留现值（比快照新）；放不下时不装，不会为了快照淘汰现有条目；文件截断或损坏时一条都不装，返回0
+		template<typename KeySerializer = MySerializer<Key>, typename ValueSerializer = MySerializer<Value>>
+		size_t loadSnapshot(const std::string& path) {
+			if (capacity_ <= 0)return 0;
+
+			MyMappedFile file(path);
+			MySnapshotReader reader(file, MySnapshotKind::kLru, sizeof(uint64_t)); // 每条记录至少有ttl
+			Key key{};
+			Value value{};
+			bool intact = reader.verify([&key, &value](MySnapshotReader& in) {
+				uint64_t ttl = 0;
+				return KeySerializer::read(in, key) && ValueSerializer::read(in, value) && in.read(ttl);
+			});
+			if (!intact)
+				return 0;
+
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			if (weigher_) { // 条目数模式构造时已经按容量预留过
+				nodeMap_.reserve(nodeMap_.size() + static_cast<size_t>(reader.count()));
+				nodePool_.reserve(nodePool_.size() + static_cast<size_t>(reader.count()));
+			}
+			uint64_t now = 0;
+			size_t loaded = 0;
+			for (uint64_t i = 0; i < reader.count(); i++) {
+				uint64_t ttl = 0;
+				if (!KeySerializer::read(reader, key) || !ValueSerializer::read(reader, value) || !reader.read(ttl))
+					break;
+				if (!weigher_ && nodeMap_.size() >= static_cast<size_t>(capacity_))
+					break; // 后面的记录更旧
+				uint64_t h = nodeMap_.hash(key);
+				if (nodeMap_.find(key, h) != nullptr)
+					continue;
+
+				NodePtr node = nodePool_.allocate(key, std::move(value));
+				node->storeHash(h);
+				if (weigher_) {
+					node->weight_ = weigher_(node->key_, node->value_);
+					if (weightedSize_ + node->weight_ > static_cast<size_t>(capacity_)) {
+						nodePool_.deallocate(node);
+						continue;
+					}
+				}
+				node->prev_ = dummyHead_; // 后读到的比先读到的旧，依次接在最久未使用端
+				node->next_ = dummyHead_->next_;
+				dummyHead_->next_->prev_ = node;
+				dummyHead_->next_ = node;
+				nodeMap_.emplace(key, node, h);
+				weightedSize_ += node->weight_;
+				if (ttl != 0) {
+					if (now == 0) now = nowTick();
+					if (!timerWheel_) timerWheel_ = std::make_unique<MyTimingWheel>(now);
+					timerWheel_->schedule(node, now + ttl);
+				}
+				loaded++;
+			}
+			return loaded;
 		}
 
 	private:
-		int capacity_;
+		template<typename K, typename V, template<typename...> class I> friend class MyKLruCache; // LRU-K在一把锁内直接操作主缓存和历史队列的内部结构
+
+		// 子类的准入钩子，调用方持有独占锁：新key插入前调用admitLocked，返回false就不插入；未命中时调用missLocked。
+		// put/emplace/带ttl的put/批量接口/异构查找/读缓冲都走这两个钩子，通过基类指针或引用调用也不会绕过子类的逻辑
+		virtual bool admitLocked(const Key&, uint64_t) { return true; }
+		virtual void missLocked(const Key&, uint64_t) {}
+
+		std::atomic<int> capacity_; // setCapacity()在锁内修改，put在加锁前读一次判断是否为0
+		Weigher weigher_;
+		size_t weightedSize_;
 		NodeMap nodeMap_;
+		MyNodePool<NodeType> nodePool_;
 		NodePtr dummyHead_;
 		NodePtr dummyTail_;
-		std::mutex	mutex_;
+		std::shared_mutex mutex_; // 不开读缓冲时所有操作都拿独占锁；开了之后get命中只拿共享锁
+		MyStatsCounter stats_;
+		std::unique_ptr<MyTimingWheel> timerWheel_; // 第一次带ttl写入时才创建，不用ttl没有任何开销
+		std::chrono::steady_clock::time_point epoch_; // tick为从epoch_起的毫秒数+1，0留给“永不过期”
+		MyRemovalQueue<Key, Value> removals_; // 锁内排队的移除通知
+		std::unique_ptr<MyReadBuffer<NodeType>> readBuffer_; // enableReadBuffer()之后才有
+		bool hasHooks_ = false; // 子类重写了准入钩子时置true，普通LRU不付虚调用的开销
+
+		static constexpr size_t kExpireBatch = 16; // 每次操作顺带回收的过期条目上限
+		static constexpr size_t kShrinkBatch = 64; // 容量调小后每次操作最多淘汰的条目数
+
+		using Lock = MyNotifyingLock<std::shared_mutex, Key, Value>;
 
 	private:
+		template<typename V>
+		void putInternal(const Key& key, uint64_t h, V&& value) { // 查找和插入共用一次hash
+			if (capacity_ <= 0)return;
+
+			Lock lock(mutex_, stats_, removals_); // 
+			drainReads();
+			expireSome();
+			shrinkSome();
+			putLocked(key, h, std::forward<V>(value), 0);
+		}
+
+		template<typename V>
+		bool tryPutInternal(const Key& key, uint64_t h, V&& value) {
+			if (capacity_ <= 0)return true;
+
+			Lock lock(mutex_, removals_, std::try_to_lock);
+			if (!lock.ownsLock())
+				return false;
+			drainReads();
+			expireSome();
+			shrinkSome();
+			putLocked(key, h, std::forward<V>(value), 0);
+			return true;
+		}
+
+		bool eraseLocked(const Key& key, uint64_t h) { // 调用方持有mutex_
+			drainReads();
+			NodePtr* it = nodeMap_.find(key, h);
+			if (it == nullptr)
+				return false;
+			NodePtr node = *it;
+			bool expired = isExpired(node);
+			if (expired) stats_.expiration();
+			notifyRemoval(node, expired ? MyRemovalCause::kExpired : MyRemovalCause::kExplicit);
+			removeExistNode(node, h);
+			return !expired;
+		}
+
+		template<typename V>
+		void putWithTtl(const Key& key, uint64_t h, V&& value, std::chrono::milliseconds ttl) {
+			if (capacity_ <= 0)return;
+
+			Lock lock(mutex_, stats_, removals_);
+			drainReads();
+			if (ttl.count() <= 0) {
+				NodePtr* it = nodeMap_.find(key, h);
+				if (it != nullptr) {
+					notifyRemoval(*it, MyRemovalCause::kExplicit);
+					removeExistNode(*it, h);
+				}
+				return;
+			}
+			uint64_t now = nowTick();
+			if (!timerWheel_) timerWheel_ = std::make_unique<MyTimingWheel>(now);
+			expireSome(kExpireBatch, now);
+			shrinkSome();
+			putLocked(key, h, std::forward<V>(value), now + static_cast<uint64_t>(ttl.count()));
+		}
+
+		template<typename V>
+		void putLocked(const Key& key, uint64_t h, V&& value, uint64_t expireTick) { // 调用方持有mutex_；expireTick为0表示永不过期
+			stats_.put();
+			NodePtr* it = nodeMap_.find(key, h);
+			NodePtr node = nullptr;
+			if (it != nullptr)
+				node = updateExistNode(*it, h, std::forward<V>(value));
+			else if (!hasHooks_ || admitLocked(key, h))
+				node = addNode(key, h, std::forward<V>(value));
+			if (node != nullptr)
+				setExpire(node, expireTick);
+		}
+
+		uint64_t nowTick() const {
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch_);
+			return static_cast<uint64_t>(elapsed.count()) + 1;
+		}
+
+		bool isExpired(NodePtr node) const { // 只有带ttl的节点才读时钟
+			return node->expireTick != 0 && node->expireTick <= nowTick();
+		}
+
+		void setExpire(NodePtr node, uint64_t expireTick) {
+			if (expireTick != 0) {
+				timerWheel_->schedule(node, expireTick);
+			}
+			else if (node->expireTick != 0) {
+				timerWheel_->cancel(node);
+				node->expireTick = 0;
+			}
+		}
+
+		// 推进时间轮，回收最多budget个已过期的条目；没有带ttl的条目时直接返回，不读时钟
+		size_t expireSome(size_t budget = kExpireBatch, uint64_t now = 0) {
+			if (!timerWheel_ || (timerWheel_->empty() && now == 0))
+				return 0;
+			return timerWheel_->advance(now != 0 ? now : nowTick(), [this](MyTimerHook* hook) {
+				NodePtr node = static_cast<NodePtr>(hook);
+				notifyRemoval(node, MyRemovalCause::kExpired);
+				dropNode(node);
+				stats_.expiration();
+			}, budget);
+		}
+
+		template<typename K>
+		bool getInternal(const K& key, uint64_t h, Value& value) {
+			if (readBuffer_) {
+				bool retry = false;
+				if (getShared(key, h, value, retry))
+					return true;
+				if (!retry)
+					return false;
+			}
+
+			Lock lock(mutex_, stats_, removals_);
+			return getLocked(key, h, value);
+		}
+
+		template<typename K>
+		bool getLocked(const K& key, uint64_t h, Value& value) { // 调用方持有mutex_
+			drainReads();
+			expireSome();
+			shrinkSome();
+			NodePtr* it = nodeMap_.find(key, h);
+			if (it != nullptr && isExpired(*it)) {
+				notifyRemoval(*it, MyRemovalCause::kExpired);
+				dropNode(*it);
+				stats_.expiration();
+				it = nullptr;
+			}
+			if (it != nullptr) {
+				moveToMostRecent(*it);
+				value = (*it)->value_; // 拷贝赋值，value原有的缓冲区够大时不会重新分配
+				stats_.hit();
+				return true;
+			}
+			if (hasHooks_) {
+				if constexpr (std::is_same<K, Key>::value) missLocked(key, h);
+				else missLocked(Key(key), h); // 异构查找未命中，只有装了钩子才构造Key
+			}
+			stats_.miss();
+			return false;
+		}
+
+		// 读缓冲模式的命中路径：共享锁下查索引、拷贝value、记一笔访问。
+		// 命中了过期条目、或者未命中但子类要在独占锁下记录这次未命中时，返回false并置retry，调用方接着走独占路径。
+		// busy不为空时只尝试一次共享锁，拿不到就置*busy返回false
+		template<typename K>
+		bool getShared(const K& key, uint64_t h, Value& value, bool& retry, bool* busy = nullptr) {
+			bool drain = false;
+			{
+				std::shared_lock<std::shared_mutex> lock(mutex_, std::defer_lock);
+				if (busy == nullptr) {
+					lock.lock();
+				}
+				else if (!lock.try_lock()) {
+					*busy = true;
+					return false;
+				}
+				const NodePtr* it = nodeMap_.find(key, h);
+				if (it == nullptr) {
+					if (hasHooks_) {
+						retry = true;
+						return false;
+					}
+					stats_.sharedMiss();
+					return false;
+				}
+				if (isExpired(*it)) {
+					retry = true;
+					return false;
+				}
+				value = (*it)->value_;
+				drain = readBuffer_->record(*it);
+				stats_.sharedHit();
+			}
+			if (drain)
+				tryDrainReads();
+			return true;
+		}
+
+		void drainReads() { // 调用方持有独占锁
+			if (readBuffer_)
+				readBuffer_->drain([this](NodePtr node) { moveToMostRecent(node); });
+		}
+
+		void tryDrainReads() { // 读缓冲攒到一半时由读线程顺手回放；拿不到锁就留给下一个拿独占锁的线程
+			if (!mutex_.try_lock())
+				return;
+			std::lock_guard<std::shared_mutex> lock(mutex_, std::adopt_lock);
+			drainReads();
+		}
+
 		void initialzeList() { // 初始化头尾节点
-			dummyHead_ = std::make_shared<NodeType>(Key(), Value()); // 因为MyLruNode的构造方法只有一个所以必须传入默认值。
-			dummyTail_ = std::make_shared<NodeType>(Key(), Value());
+			dummyHead_ = nodePool_.allocate(Key()); // 哨兵的value默认构造
+			dummyTail_ = nodePool_.allocate(Key());
 			dummyHead_->next_ = dummyTail_;
 			dummyTail_->prev_ = dummyHead_;
 		}
 
-		void updateExistNode(NodePtr node,const Value& value) {
-			node->setValue(value);
+		template<typename V>
+		NodePtr updateExistNode(NodePtr node, uint64_t h, V&& value) { // 返回更新后的节点，新值放不下被删掉时返回nullptr
+			node->setValue(std::forward<V>(value));
 			moveToMostRecent(node);
+			if (!weigher_)
+				return node; // 条目数模式权重恒为1
+
+			size_t weight = weigher_(node->key_, node->value_);
+			if (weight > static_cast<size_t>(capacity_)) { // 新值放不下，旧值也不能留着
+				notifyRemoval(node, MyRemovalCause::kEvicted);
+				removeExistNode(node, h);
+				return nullptr;
+			}
+			size_t limit = std::max(static_cast<size_t>(capacity_), weightedSize_); // 收缩期间不让总量再涨
+			weightedSize_ = weightedSize_ - node->weight_ + weight;
+			node->weight_ = weight;
+			while (weightedSize_ > limit) { // node已在最近端且自身放得下，不会被淘汰到
+				evictLeastRecent();
+			}
+			return node;
 		}
 
 		void moveToMostRecent(NodePtr node) {
+			stats_.profile().listMove();
 			removeNode(node);
 			insertNode(node);
 		}
@@ -133,99 +735,137 @@ namespace MyCache {
 			dummyTail_ -> prev_ = node;
 		}
 
-		void addNode(const Key& key,const Value& value) { // 先直接插入到尾节点，如果capacity<0弹出最后一个
-			NodePtr node = std::make_shared<NodeType>(key, value);
-			insertNode(node);
-			nodeMap_[key] = node;
+		// 先构造节点算出权重，再从最久未使用端淘汰到放得下，最后插入尾节点；权重超过容量时拒绝并返回nullptr
+		template<typename... Args>
+		NodePtr addNode(const Key& key, uint64_t h, Args&&... args) {
+			NodePtr node = nodePool_.allocate(key, std::forward<Args>(args)...);
+			node->storeHash(h);
+			if (weigher_) {
+				node->weight_ = weigher_(node->key_, node->value_);
+				if (node->weight_ > static_cast<size_t>(capacity_)) {
+					nodePool_.deallocate(node);
+					return nullptr;
+				}
+			}
+			// 收缩期间总量已经超过容量，这里只腾出和新条目等量的位置，积压的部分留给shrinkSome分批淘汰
+			size_t limit = std::max(static_cast<size_t>(capacity_), weightedSize_);
+			while (weightedSize_ + node->weight_ > limit && dummyHead_->next_ != dummyTail_) {
+				evictLeastRecent();
+			}
 
-			if (nodeMap_.size() > capacity_) { evictLeastRecent(); }
+			insertNode(node);
+			stats_.profile().listInsert();
+			nodeMap_.emplace(key, node, h);
+			weightedSize_ += node->weight_;
+			return node;
 		}
 
-		void evictLeastRecent() { // 弹出dummyHead_->next,并在nodeMap_中erase
-			NodePtr& node = dummyHead_->next_;
+		void removeExistNode(NodePtr node, uint64_t h) { // 从链表和索引中删掉节点并归还槽位
 			removeNode(node);
-			nodeMap_.erase(node->getKey());
+			nodeMap_.erase(node->key_, h);
+			releaseNode(node);
 		}
-	};
-
-	template<typename Key,typename Value>
-	class MyKLruCache :public MyLruCache<Key,Value> { // 在LRU基础上实现，维护一个历史访问队列，
-	private:
-		int k_;
-		std::unique_ptr< MyLruCache<Key, size_t>> historyList_;
-
-	public:
-		MyKLruCache(int capactity, int historyCapactiy, int k)  // 倒数第k次访问时间最久的淘汰，维护一个历史队列，这个队列在这里也是根据LRU策略淘汰的
-			:MyLruCache<Key,Value>(capactity), 
-			historyList_(std::make_unique<MyLruCache<Key, size_t>>(historyCapactiy)), 
-			k_(k) {};
 
-		void put(Key key, Value value) { // 先判断是否在缓存中？在则直接put；否则先对历史队列操作是否需要弹出，在入队。
-			if (MyLruCache<Key, Value>::get(key) != "")MyLruCache<Key, Value>::put(key, value); 
-
-			int historyCount = historyList_->get(key);
-			historyList_->put(key, ++historyCount); 
+		void evictLeastRecent() { // 弹出dummyHead_->next,并在nodeMap_中erase，槽位还给节点池
+			NodePtr node = dummyHead_->next_;
+			notifyRemoval(node, MyRemovalCause::kEvicted);
+			dropNode(node);
+			stats_.eviction();
+		}
 
-			if (historyCount >= k_) {
-				historyList_->removeNode(key);
-				MyLruCache<Key, Value>::put(key, value);
+		void shrinkSome(size_t batch = kShrinkBatch) { // 容量调小后分批淘汰超出的部分，没有超出时只多一次比较
+			int capacity = capacity_.load(std::memory_order_relaxed);
+			size_t limit = capacity > 0 ? static_cast<size_t>(capacity) : 0;
+			for (size_t n = 0; n < batch && (weightedSize_ > limit || capacity <= 0) && dummyHead_->next_ != dummyTail_; n++) { // 容量为0时权重为0的条目也要清掉
+				evictLeastRecent();
 			}
 		}
 
-		Value get(Key key) { // 先到历史队列中更新次数，在去访问缓存。
-			int historyCount = historyList_->get(key);
-			historyList_->put(key, ++historyCount); // 假设此处historyCount == k如何处理？
+		void notifyRemoval(NodePtr node, MyRemovalCause cause) { // 节点随后就被删掉，value直接移进通知队列
+			if (removals_.active())
+				removals_.push(node->key_, std::move(node->value_), cause);
+		}
 
-			return MyLruCache<Key, Value>::get(key);// 上面会不会存在问题？不会有问题，想一想假如k=4，刚刚好第四次访问，此时不应该加入缓存应该是下一次
+		void dropNode(NodePtr node) { // 没有现成hash时删节点
+			removeNode(node);
+			nodeMap_.erase(node->getKey(), nodeHash(node));
+			releaseNode(node);
 		}
 
+		uint64_t nodeHash(NodePtr node) const { // 节点里存了hash就直接用
+			if constexpr (detail::kCacheHash<Key>) return node->storedHash;
+			else return nodeMap_.hash(node->key_);
+		}
+
+		void releaseNode(NodePtr node) { // 节点已从链表和索引摘下：扣权重、摘定时器、归还槽位
+			stats_.profile().listRemove();
+			weightedSize_ -= node->weight_;
+			if (node->expireTick != 0)
+				timerWheel_->cancel(node);
+			nodePool_.deallocate(node);
+		}
 	};
 
-	template<typename Key,typename Value>
-	class MyHashLru {
+	template<typename Key, typename Value, template<typename...> class Index = MyFlatIndex>
+	class MyKLruCache :public MyLruCache<Key, Value, Index> { // 在LRU基础上实现，维护一个历史访问队列，
 	private:
-		size_t capacity_;
-		int sliceNum_;
-		std::vector<std::unique_ptr<MyKLruCache<Key, Value>>> lruSliceCaches_;
+		using Base = MyLruCache<Key, Value, Index>;
+		using History = MyLruCache<Key, size_t, Index>;
+
+		int k_;
+		std::unique_ptr<History> historyList_; // 只借用它的链表和索引，统一由主缓存的mutex_保护
 
 	public:
-		MyHashLru(size_t capacity, int slice) :capacity_(capacity), sliceNum_(slice > 0 ? sliceNum_ : std::thread::hardware_concurrency()) {
-			size_t size = std::ceil(capacity_ / static_cast<double>(sliceNum_));
-			for (int i = 0; i < sliceNum_; i++) {
-				lruSliceCaches_.emplace_back(std::make_unique<MyKLruCache<Key, Value>>(size));
-			}
-		}
-		void put(Key key, Value value)
-		{
-			// 获取key的hash值，并计算出对应的分片索引
-			size_t sliceIndex = Hash(key) % sliceNum_;
-			return lruSliceCaches_[sliceIndex]->put(key, value);
+		// weigher只作用于主缓存，历史队列始终按条目数计。
+		// 命中、更新已有key和LRU一样；新key每次put/未命中的get在历史队列里记一次，第k次put才真正进入缓存。
+		// 这些都在基类的准入钩子里完成，基类的所有入口（包括通过基类指针调用）都遵守LRU-K的准入
+		MyKLruCache(int capactity, int historyCapactiy, int k, typename Base::Weigher weigher = nullptr)  // 倒数第k次访问时间最久的淘汰，维护一个历史队列，这个队列在这里也是根据LRU策略淘汰的
+			:Base(capactity, std::move(weigher)), 
+			k_(k),
+			historyList_(std::make_unique<History>(historyCapactiy)) {
+			this->hasHooks_ = true;
 		}
 
-		bool get(Key key, Value& value)
-		{
-			// 获取key的hash值，并计算出对应的分片索引
-			size_t sliceIndex = Hash(key) % sliceNum_;
-			return lruSliceCaches_[sliceIndex]->get(key, value);
+	private:
+		bool admitLocked(const Key& key, uint64_t h) override { // 历史次数+1，达到k次时从历史队列移入缓存
+			typename History::NodePtr record = recordAccess(key, h);
+			if (record != nullptr && record->getValue() < static_cast<size_t>(k_))
+				return false;
+			if (record != nullptr) historyList_->removeExistNode(record, h);
+			return true;
 		}
 
-		Value get(Key key)
-		{
-			Value value;
-			memset(&value, 0, sizeof(value));
-			get(key, value);
-			return value;
+		void missLocked(const Key& key, uint64_t h) override { // 未命中只在历史队列中记一次访问，真正入缓存要等put
+			recordAccess(key, h);
 		}
-	private:
-		// 将key转换为对应hash值
-		size_t Hash(Key key)
-		{
-			std::hash<Key> hashFunc;
-			return hashFunc(key);
+
+		// 历史次数+1（不存在则以1插入），返回历史节点；历史队列容量为0时返回nullptr，相当于直接放行。
+		// 主缓存和历史队列的索引类型相同，hash只算一次
+		typename History::NodePtr recordAccess(const Key& key, uint64_t h) {
+			if (historyList_->capacity_ <= 0)
+				return nullptr;
+			typename History::NodePtr* it = historyList_->nodeMap_.find(key, h);
+			if (it != nullptr) {
+				(*it)->setValue((*it)->getValue() + 1);
+				historyList_->moveToMostRecent(*it);
+				return *it;
+			}
+			return historyList_->addNode(key, h, 1);
 		}
-	};
 
+	};
 
+	// 分片LRU：每个分片是一个独立加锁的MyLruCache，分片逻辑在MyShardedCache里。slice<=0时分片数取hardware_concurrency()
+	template<typename Key, typename Value, template<typename...> class Index = MyFlatIndex>
+	class MyHashLru :public MyShardedCache<Key, Value, MyLruCache<Key, Value, Index>> {
+	public:
+		// 给了weigher时capacity是总权重预算，平均分到每个分片
+		MyHashLru(size_t capacity, int slice, MyWeigher<Key, Value> weigher = nullptr)
+			:MyShardedCache<Key, Value, MyLruCache<Key, Value, Index>>(capacity, slice > 0 ? static_cast<size_t>(slice) : 0, std::move(weigher)) {}
 
+		// NUMA布局见MyNumaLayout
+		MyHashLru(MyNumaLayout layout, size_t capacity, int slice, MyWeigher<Key, Value> weigher = nullptr)
+			:MyShardedCache<Key, Value, MyLruCache<Key, Value, Index>>(layout, capacity, slice > 0 ? static_cast<size_t>(slice) : 0, std::move(weigher)) {}
+	};
 
 }
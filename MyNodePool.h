@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace MyCache {
+
+	// 节点池：按块预分配定长槽位，节点被淘汰后槽位挂回空闲链表，新节点直接复用，热身后不再调用全局分配器
+	template<typename Node>
+	class MyNodePool {
+	private:
+		union Slot {
+			Slot* nextFree; // 空闲时复用这块内存串成空闲链表
+			alignas(Node) unsigned char storage[sizeof(Node)];
+		};
+
+		static constexpr size_t kMinChunk = 16;
+		static constexpr size_t kMaxChunk = 4096;
+
+		std::vector<std::unique_ptr<Slot[]>> chunks_;
+		Slot*                                freeList_;
+		size_t                               capacity_; // 已分配的槽位总数
+		size_t                               size_; // 正在使用的槽位数
+
+	public:
+		explicit MyNodePool(size_t initialCapacity = 0) :freeList_(nullptr), capacity_(0), size_(0) {
+			reserve(initialCapacity);
+		}
+
+		MyNodePool(const MyNodePool&) = delete;
+		MyNodePool& operator=(const MyNodePool&) = delete;
+
+		// 注意：池不知道哪些槽位还活着，析构前由使用者负责把所有节点deallocate
+		~MyNodePool() = default;
+
+		template<typename... Args>
+		Node* allocate(Args&&... args) {
+			if (freeList_ == nullptr) {
+				// 池耗尽时按当前容量翻倍，只在容量变大时发生；每块最多kMaxChunk个槽位，单次分配不会随容量线性变慢
+				grow(std::min(std::max(capacity_, kMinChunk), kMaxChunk));
+			}
+			Slot* slot = freeList_;
+			freeList_ = slot->nextFree; // placement new 之前先取next，避免被构造覆盖
+			Node* node = nullptr;
+			try {
+				node = ::new (static_cast<void*>(slot->storage)) Node(std::forward<Args>(args)...);
+			}
+			catch (...) { // 构造失败把槽位还回去
+				slot->nextFree = freeList_;
+				freeList_ = slot;
+				throw;
+			}
+			size_++;
+			return node;
+		}
+
+		void deallocate(Node* node) {
+			if (node == nullptr)
+				return;
+			node->~Node();
+			Slot* slot = reinterpret_cast<Slot*>(node);
+			slot->nextFree = freeList_;
+			freeList_ = slot;
+			size_--;
+		}
+
+		// 保证至少有n个槽位可用，不会触发后续分配
+		void reserve(size_t n) {
+			if (n > capacity_) {
+				grow(n - capacity_);
+			}
+		}
+
+		size_t size() const { return size_; }
+		size_t capacity() const { return capacity_; }
+
+	private:
+		void grow(size_t count) {
+			if (count == 0)
+				return;
+			std::unique_ptr<Slot[]> chunk(new Slot[count]);
+			for (size_t i = 0; i < count; i++) { // 倒序串起来，分配时按地址顺序取出
+				chunk[count - 1 - i].nextFree = freeList_;
+				freeList_ = &chunk[count - 1 - i];
+			}
+			chunks_.push_back(std::move(chunk));
+			capacity_ += count;
+		}
+	};
+
+	// 直接用全局分配器的节点存储，接口同MyNodePool；节点大小差别很大或者想让内存随淘汰立即归还时代替节点池
+	template<typename Node>
+	class MyHeapStorage {
+	private:
+		size_t size_ = 0;
+
+	public:
+		explicit MyHeapStorage(size_t = 0) {}
+
+		MyHeapStorage(const MyHeapStorage&) = delete;
+		MyHeapStorage& operator=(const MyHeapStorage&) = delete;
+
+		template<typename... Args>
+		Node* allocate(Args&&... args) {
+			Node* node = new Node(std::forward<Args>(args)...);
+			size_++;
+			return node;
+		}
+
+		void deallocate(Node* node) {
+			if (node == nullptr)
+				return;
+			delete node;
+			size_--;
+		}
+
+		void reserve(size_t) {}
+
+		size_t size() const { return size_; }
+		size_t capacity() const { return size_; }
+	};
+
+}
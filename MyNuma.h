@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace MyCache {
+
+	// NUMA拓扑与绑定：直接读/sys/devices/system/node、调系统调用，不依赖libnuma。
+	// 节点按编号从小到大重新编成0..nodeCount()-1；非Linux或读不到拓扑时当作只有一个节点，绑定全部是空操作
+	class MyNuma {
+	private:
+		struct Topology {
+			std::vector<int>              nodeIds; // 第i个节点在系统里的编号，编号可能不连续
+			std::vector<std::vector<int>> nodeCpus;
+			std::vector<size_t>           cpuNode; // cpu编号 -> 节点下标
+		};
+
+		static constexpr uint32_t kRefreshMask = 63; // 每64次查询重新读一次当前cpu，线程被迁移后很快跟上
+
+	public:
+		static size_t nodeCount() { return topology().nodeIds.size(); }
+
+		// 当前线程所在的节点下标。结果按线程缓存，每kRefreshMask+1次才真正读一次cpu
+		static size_t currentNode() {
+			const Topology& topo = topology();
+			if (topo.nodeIds.size() <= 1)
+				return 0;
+			thread_local uint32_t calls = 0;
+			thread_local size_t node = 0;
+			if ((calls++ & kRefreshMask) == 0) {
+#if defined(__linux__)
+				int cpu = ::sched_getcpu();
+				if (cpu >= 0 && static_cast<size_t>(cpu) < topo.cpuNode.size())
+					node = topo.cpuNode[static_cast<size_t>(cpu)];
+#endif
+			}
+			return node;
+		}
+
+		// 把当前线程钉在node的cpu上，并让它之后首次访问的内存优先从node分配(MPOL_PREFERRED)；失败或单节点时返回false
+		static bool bindThread(size_t node) {
+			const Topology& topo = topology();
+			if (topo.nodeIds.size() <= 1 || node >= topo.nodeIds.size())
+				return false;
+#if defined(__linux__)
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			for (int cpu : topo.nodeCpus[node]) {
+				if (cpu < CPU_SETSIZE) CPU_SET(cpu, &cpus);
+			}
+			bool ok = ::sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#if defined(SYS_set_mempolicy)
+			constexpr int kMpolPreferred = 1;
+			constexpr size_t kMaskBits = sizeof(unsigned long) * 8;
+			int id = topo.nodeIds[node];
+			std::vector<unsigned long> mask(static_cast<size_t>(id) / kMaskBits + 1, 0);
+			mask[static_cast<size_t>(id) / kMaskBits] = 1ul << (static_cast<size_t>(id) % kMaskBits);
+			ok = ::syscall(SYS_set_mempolicy, kMpolPreferred, mask.data(), mask.size() * kMaskBits + 1) == 0 && ok;
+#endif
+			return ok;
+#else
+			return false;
+#endif
+		}
+
+		// 在一个绑定到node的临时线程里执行fn并等它结束，fn里分配并首次写入的内存落在node上（first-touch）；
+		// 单节点时直接在当前线程执行。fn抛出的异常在调用线程重新抛出
+		template<typename Fn>
+		static void runOn(size_t node, Fn&& fn) {
+			if (nodeCount() <= 1) {
+				fn();
+				return;
+			}
+			std::exception_ptr error;
+			std::thread worker([&] {
+				bindThread(node);
+				try { fn(); }
+				catch (...) { error = std::current_exception(); }
+			});
+			worker.join();
+			if (error)
+				std::rethrow_exception(error);
+		}
+
+	private:
+		static const Topology& topology() {
+			static const Topology topo = loadTopology();
+			return topo;
+		}
+
+		static Topology loadTopology() {
+			Topology topo;
+#if defined(__linux__)
+			for (int id : readList("/sys/devices/system/node/online")) {
+				std::vector<int> cpus = readList("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+				if (cpus.empty())
+					continue; // 只有内存没有cpu的节点不参与分片
+				for (int cpu : cpus) {
+					if (topo.cpuNode.size() <= static_cast<size_t>(cpu)) topo.cpuNode.resize(static_cast<size_t>(cpu) + 1, 0);
+					topo.cpuNode[static_cast<size_t>(cpu)] = topo.nodeIds.size();
+				}
+				topo.nodeIds.push_back(id);
+				topo.nodeCpus.push_back(std::move(cpus));
+			}
+#endif
+			if (topo.nodeIds.empty()) {
+				topo.nodeIds.push_back(0);
+				topo.nodeCpus.emplace_back();
+				topo.cpuNode.clear();
+			}
+			return topo;
+		}
+
+		static std::vector<int> readList(const std::string& path) { // 解析"0-3,8-11"这样的列表
+			std::vector<int> result;
+			std::ifstream in(path);
+			std::string text;
+			if (!std::getline(in, text))
+				return result;
+			size_t pos = 0;
+			while (pos < text.size()) {
+				size_t end = text.find(',', pos);
+				if (end == std::string::npos) end = text.size();
+				std::string item = text.substr(pos, end - pos);
+				size_t dash = item.find('-');
+				try {
+					int first = std::stoi(item.substr(0, dash));
+					int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+					for (int i = first; i <= last; i++) result.push_back(i);
+				}
+				catch (...) {} // 空项或格式不对就跳过
+				pos = end + 1;
+			}
+			return result;
+		}
+	};
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "MyCacheStats.h"
+
+namespace MyCache {
+
+	// 条带化、有损的读缓冲：命中时在共享锁下把节点指针记进当前线程所在条带的环形缓冲，
+	// 之后由拿到独占锁的线程一次性回放给淘汰策略（移到最近端、频次+1），链表操作分摊到几十上百次访问上。
+	// 条带满了或者抢槽位失败就直接丢掉这次记录，只损失一点淘汰精度，命中路径永远不等待。
+	// 使用约定：record在共享锁下调用，drain在独占锁下调用，删除节点的独占临界区开头必须先drain，
+	// 这样缓冲里的指针在回放时一定还指向活着的节点
+	template<typename T>
+	class MyReadBuffer {
+	private:
+		static constexpr uint32_t kSlots = 32; // 每个条带的槽位数，2的幂
+		static constexpr size_t   kMaxStripes = 64;
+
+		struct alignas(kCacheLineSize) Stripe { // 每个条带独占cache line，不同线程的写入不伪共享
+			std::atomic<uint32_t> writes{ 0 }; // 累计写入位置，只增不减
+			uint32_t              reads = 0; // 已回放到的位置，只在独占锁下读写
+			std::atomic<T*>       slots[kSlots];
+
+			Stripe() {
+				for (std::atomic<T*>& slot : slots) slot.store(nullptr, std::memory_order_relaxed);
+			}
+		};
+
+		std::unique_ptr<Stripe[]> stripes_;
+		size_t                    mask_;
+
+	public:
+		// stripeNum为0时取不小于hardware_concurrency()的2的幂，最多kMaxStripes个
+		explicit MyReadBuffer(size_t stripeNum = 0) {
+			size_t want = stripeNum > 0 ? stripeNum : std::thread::hardware_concurrency();
+			size_t n = 1;
+			while (n < want && n < kMaxStripes) n <<= 1;
+			stripes_.reset(new Stripe[n]);
+			mask_ = n - 1;
+		}
+
+		// 调用方持有共享锁。返回true表示这个条带已经攒到一半，调用方应该try_lock之后drain
+		bool record(T* item) {
+			Stripe& stripe = stripes_[probe() & mask_];
+			uint32_t writes = stripe.writes.load(std::memory_order_relaxed);
+			uint32_t pending = writes - stripe.reads; // reads只在独占锁下修改，共享锁保证这里读到的是最新值
+			if (pending >= kSlots)
+				return true; // 满了，丢弃
+			if (!stripe.writes.compare_exchange_strong(writes, writes + 1, std::memory_order_relaxed))
+				return false; // 同一条带上别的线程抢先了，丢弃
+			stripe.slots[writes & (kSlots - 1)].store(item, std::memory_order_relaxed);
+			return pending + 1 >= kSlots / 2;
+		}
+
+		// 调用方持有独占锁：所有记录都发生在之前的共享锁内，这里按条带顺序回放并清空，返回回放的条数
+		template<typename Apply>
+		size_t drain(Apply&& apply) {
+			size_t drained = 0;
+			for (size_t i = 0; i <= mask_; i++) {
+				Stripe& stripe = stripes_[i];
+				uint32_t writes = stripe.writes.load(std::memory_order_relaxed);
+				for (uint32_t pos = stripe.reads; pos != writes; pos++) {
+					std::atomic<T*>& slot = stripe.slots[pos & (kSlots - 1)];
+					T* item = slot.load(std::memory_order_relaxed);
+					if (item != nullptr) {
+						slot.store(nullptr, std::memory_order_relaxed);
+						apply(item);
+						drained++;
+					}
+				}
+				stripe.reads = writes;
+			}
+			return drained;
+		}
+
+		size_t stripeNum() const { return mask_ + 1; }
+
+	private:
+		static size_t probe() { // 每个线程第一次用时领一个编号，线程按编号轮流落到各个条带
+			static std::atomic<size_t> next{ 0 };
+			thread_local size_t id = next.fetch_add(1, std::memory_order_relaxed);
+			return id;
+		}
+	};
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "MyCachePolicy.h"
+#include "MyCacheStats.h"
+
+namespace MyCache {
+
+	// 锁内排队、锁外投递的移除通知：策略在自己的锁内push，MyNotifyingLock解锁后在同一个线程里依次调用回调，
+	// 回调再慢也不会拉长临界区。没有设置回调时push什么都不做，value照常随节点销毁
+	template<typename Key, typename Value>
+	class MyRemovalQueue {
+	public:
+		using Listener = MyEvictionListener<Key, Value>;
+
+	private:
+		struct Removal {
+			Key            key;
+			Value          value;
+			MyRemovalCause cause;
+		};
+
+		Listener             listener_;
+		std::vector<Removal> pending_;
+
+	public:
+		// 一次加锁期间排下的通知，锁内take，解锁后deliver
+		class Batch {
+		private:
+			Listener             listener_;
+			std::vector<Removal> removals_;
+
+			friend class MyRemovalQueue;
+
+		public:
+			void deliver() {
+				for (Removal& removal : removals_) {
+					try {
+						listener_(removal.key, std::move(removal.value), removal.cause);
+					}
+					catch (...) {} // 在锁的析构里投递，异常不能往外抛
+				}
+			}
+		};
+
+		// 以下调用方都持有缓存的锁
+		void setListener(Listener listener) { listener_ = std::move(listener); }
+
+		bool active() const { return static_cast<bool>(listener_); }
+
+		bool empty() const { return pending_.empty(); }
+
+		void push(const Key& key, Value&& value, MyRemovalCause cause) {
+			if (listener_)
+				pending_.push_back(Removal{ key, std::move(value), cause });
+		}
+
+		Batch take() {
+			Batch batch;
+			batch.listener_ = listener_; // 复制一份，投递期间别的线程换掉回调也不影响这一批
+			batch.removals_.swap(pending_);
+			return batch;
+		}
+	};
+
+	// 策略用的锁：加锁和MyStatsLock一样（带等锁统计），解锁时如果锁内排了移除通知，先取走再解锁，解锁后投递
+	template<typename Mutex, typename Key, typename Value>
+	class MyNotifyingLock {
+	private:
+		Mutex&                        mutex_;
+		MyRemovalQueue<Key, Value>&   removals_;
+		bool                          owns_ = true;
+#if MYCACHE_PROFILE
+		MyStatsCounter*               stats_ = nullptr; // 不做等锁统计的构造方式不记持有时间
+		uint64_t                      acquiredAt_ = 0;
+#endif
+
+	public:
+		MyNotifyingLock(Mutex& mutex, MyStatsCounter& stats, MyRemovalQueue<Key, Value>& removals) :mutex_(mutex), removals_(removals) {
+			MyStatsLock<Mutex>::acquire(mutex_, stats);
+#if MYCACHE_PROFILE
+			stats_ = &stats;
+			acquiredAt_ = MyProfileCounter::now();
+#endif
+		}
+
+		MyNotifyingLock(Mutex& mutex, MyRemovalQueue<Key, Value>& removals) :mutex_(mutex), removals_(removals) { // 不做等锁统计的策略用
+			mutex_.lock();
+		}
+
+		// 只尝试一次，拿不到锁不等待，由调用方检查ownsLock()
+		MyNotifyingLock(Mutex& mutex, MyRemovalQueue<Key, Value>& removals, std::try_to_lock_t) :mutex_(mutex), removals_(removals) {
+			owns_ = mutex_.try_lock();
+		}
+
+		bool ownsLock() const { return owns_; }
+
+		~MyNotifyingLock() {
+			if (!owns_)
+				return;
+#if MYCACHE_PROFILE
+			if (stats_)
+				stats_->profile().lockHold(MyProfileCounter::now() - acquiredAt_);
+#endif
+			if (removals_.empty()) {
+				mutex_.unlock();
+				return;
+			}
+			typename MyRemovalQueue<Key, Value>::Batch batch = removals_.take();
+			mutex_.unlock();
+			batch.deliver();
+		}
+
+		MyNotifyingLock(const MyNotifyingLock&) = delete;
+		MyNotifyingLock& operator=(const MyNotifyingLock&) = delete;
+	};
+
+}
@@ -0,0 +1,461 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "MyCachePolicy.h"
+#include "MyCacheStats.h"
+#include "MyHash.h"
+#include "MyNuma.h"
+
+namespace MyCache {
+
+	// 分片在NUMA节点上的摆放方式
+	enum class MyNumaLayout {
+		kNone,        // 不区分节点，分片都由构造线程分配
+		kPartitioned, // 分片轮流摆到各个节点上，每个key只存一份；配合nodeOf(key)把请求派给该节点上的线程才能本地访问
+		kReplicated,  // 每个节点一整套分片（各自拥有全部容量），读只查本节点那一套，写入和删除同步到所有副本；适合读多写少。
+		              // 写入按分片下标串行化，同一个key在各副本上按同样的先后顺序应用，并发写不会让副本永久不一致
+	};
+
+	namespace detail {
+
+		// 分片默认用Policy索引的Hash（Policy提供KeyHasher时），这样选分片算的hash可以直接交给分片，分片内不再算第二次
+		template<typename Policy, typename Key, typename = void>
+		struct policyHasher { using type = MyDefaultHash<Key>; };
+
+		template<typename Policy, typename Key>
+		struct policyHasher<Policy, Key, std::void_t<typename Policy::KeyHasher>> { using type = typename Policy::KeyHasher; };
+
+		template<typename Policy, typename Hash, typename = void>
+		constexpr bool passesHash = false;
+
+		template<typename Policy, typename Hash>
+		constexpr bool passesHash<Policy, Hash, std::void_t<typename Policy::KeyHasher>> = std::is_same<typename Policy::KeyHasher, Hash>::value;
+
+	}
+
+	// 分片缓存：按key的hash把请求分散到多个独立加锁的Policy上，不同分片之间互不竞争。
+	// Policy可以是MyLruCache、MyLfuCache、MyKLruCache等，构造参数为(分片容量, policyArgs...)。
+	// Policy提供KeyHasher和*Hashed系列接口（getHashed/putHashed/eraseHashed/containsHashed/emplaceHashed/getManyHashed/putManyHashed）
+	// 且Hash与KeyHasher相同时（默认如此），单key和批量的读写删都只算一次hash，
+	// 选分片用中间的位，分片内的索引用低位和最高7位；要换更快的hash就换Policy的索引，例如MyLruCache<K, V, MyFastFlatIndex>
+	// NUMA布局下每个分片在绑定到所属节点的线程里构造，Policy构造时预留的节点池和索引按first-touch落在该节点上；
+	// 之后才第一次写到的内存（索引里还没用过的槽位页、value自己的堆内存）跟随写入线程所在的节点
+	template<typename Key, typename Value, typename Policy, typename Hash = typename detail::policyHasher<Policy, Key>::type>
+	class MyShardedCache : public MyCachePolicy<Key, Value> {
+	private:
+		static constexpr bool kPassHash = detail::passesHash<Policy, Hash>;
+
+		struct alignas(kCacheLineSize) Shard { // 每个分片独占cache line，分片的锁和计数不会和邻居伪共享
+			Policy cache;
+
+			template<typename... Args>
+			explicit Shard(Args&&... args) :cache(std::forward<Args>(args)...) {}
+		};
+
+		struct alignas(kCacheLineSize) OrderLock {
+			std::mutex mutex;
+		};
+
+		// kReplicated时第i个分片在所有副本上的写入在orderLocks_[i]下整体完成，各副本看到的写入顺序相同。同一个分片的写入本来就要
+		// 排队拿分片锁，多一把锁不增加竞争；一次只持有一把，批量写和clear逐个分片进行。
+		// 分片解锁时投递的移除回调里再写缓存（本线程已经持有一把）时不再加锁，避免两个线程各持一把再互等，这类写入不保证顺序
+		class OrderGuard {
+		private:
+			std::mutex* mutex_ = nullptr;
+
+		public:
+			OrderGuard(MyShardedCache& cache, size_t index) {
+				if (!cache.orderLocks_ || heldOrder() > 0)
+					return;
+				mutex_ = &cache.orderLocks_[index].mutex;
+				mutex_->lock();
+				heldOrder()++;
+			}
+
+			~OrderGuard() {
+				if (!mutex_)
+					return;
+				heldOrder()--;
+				mutex_->unlock();
+			}
+
+			OrderGuard(const OrderGuard&) = delete;
+			OrderGuard& operator=(const OrderGuard&) = delete;
+		};
+
+		std::atomic<size_t>                 capacity_;
+		size_t                              shardNum_; // 每套分片的个数
+		MyNumaLayout                        layout_;
+		size_t                              replicaNum_; // kReplicated时等于节点数，否则为1
+		std::vector<std::unique_ptr<Shard>> shards_; // 第r套副本的第i个分片在r*shardNum_+i
+		std::vector<size_t>                 shardNode_; // 每个分片所在的节点
+		std::unique_ptr<OrderLock[]>        orderLocks_; // 每个分片下标一把，只在kReplicated且多于一套副本时分配
+		Hash                                hash_;
+
+	public:
+		// shardNum为0时取hardware_concurrency()；capacity比分片数小时每个分片至少放1个，总容量会略多于capacity
+		template<typename... PolicyArgs>
+		explicit MyShardedCache(size_t capacity, size_t shardNum = 0, PolicyArgs&&... policyArgs)
+			:MyShardedCache(MyNumaLayout::kNone, capacity, shardNum, std::forward<PolicyArgs>(policyArgs)...) {}
+
+		// 按layout把分片摆到各个NUMA节点上；单节点机器上和kNone一样。kReplicated时capacity是每套副本的容量
+		template<typename... PolicyArgs>
+		MyShardedCache(MyNumaLayout layout, size_t capacity, size_t shardNum = 0, PolicyArgs&&... policyArgs)
+			:capacity_(capacity), shardNum_(shardNum > 0 ? shardNum : std::thread::hardware_concurrency()), layout_(layout),
+			replicaNum_(layout == MyNumaLayout::kReplicated ? MyNuma::nodeCount() : 1) {
+			if (shardNum_ == 0) shardNum_ = 1; // hardware_concurrency()拿不到时返回0
+			if (replicaNum_ > 1) orderLocks_.reset(new OrderLock[shardNum_]);
+			size_t nodeNum = layout == MyNumaLayout::kNone ? 1 : MyNuma::nodeCount();
+			shards_.resize(replicaNum_ * shardNum_);
+			shardNode_.resize(shards_.size());
+			for (size_t i = 0; i < shards_.size(); i++) {
+				shardNode_[i] = layout == MyNumaLayout::kReplicated ? i / shardNum_ : i % nodeNum;
+			}
+			for (size_t node = 0; node < nodeNum; node++) {
+				auto build = [&] { // 同一节点的分片在同一个绑定线程里构造
+					for (size_t i = 0; i < shards_.size(); i++) {
+						if (shardNode_[i] == node)
+							shards_[i] = std::make_unique<Shard>(static_cast<int>(shardCapacity(capacity, i)), policyArgs...);
+					}
+				};
+				if (layout == MyNumaLayout::kNone) build();
+				else MyNuma::runOn(node, build);
+			}
+		}
+
+		~MyShardedCache() override = default;
+
+		void put(const Key& key, const Value& value) override {
+			uint64_t h = keyHash(key);
+			size_t index = shardOf(h);
+			OrderGuard order(*this, index);
+			for (size_t r = 0; r < replicaNum_; r++) {
+				putTo(shards_[r * shardNum_ + index]->cache, key, h, value);
+			}
+		}
+
+		void put(const Key& key, Value&& value) override {
+			uint64_t h = keyHash(key);
+			size_t index = shardOf(h);
+			OrderGuard order(*this, index);
+			for (size_t r = 1; r < replicaNum_; r++) { // 其他副本拷贝，第0套最后移动
+				putTo(shards_[r * shardNum_ + index]->cache, key, h, static_cast<const Value&>(value));
+			}
+			putTo(shards_[index]->cache, key, h, std::move(value));
+		}
+
+		// 写入ttl后过期的条目，需要Policy本身提供带ttl的put（MyLruCache、MyLfuCache）；ttl<=0等于删除
+		void put(const Key& key, const Value& value, std::chrono::milliseconds ttl) {
+			uint64_t h = keyHash(key);
+			size_t index = shardOf(h);
+			OrderGuard order(*this, index);
+			for (size_t r = 0; r < replicaNum_; r++) {
+				putTo(shards_[r * shardNum_ + index]->cache, key, h, value, ttl);
+			}
+		}
+
+		void put(const Key& key, Value&& value, std::chrono::milliseconds ttl) {
+			uint64_t h = keyHash(key);
+			size_t index = shardOf(h);
+			OrderGuard order(*this, index);
+			for (size_t r = 1; r < replicaNum_; r++) {
+				putTo(shards_[r * shardNum_ + index]->cache, key, h, static_cast<const Value&>(value), ttl);
+			}
+			putTo(shards_[index]->cache, key, h, std::move(value), ttl);
+		}
+
+		template<typename... Args>
+		void emplace(const Key& key, Args&&... args) { // 需要Policy本身提供emplace（传hash时是emplaceHashed）
+			uint64_t h = keyHash(key);
+			size_t index = shardOf(h);
+			OrderGuard order(*this, index);
+			for (size_t r = 1; r < replicaNum_; r++) {
+				emplaceTo(shards_[r * shardNum_ + index]->cache, key, h, args...);
+			}
+			emplaceTo(shards_[index]->cache, key, h, std::forward<Args>(args)...);
+		}
+
+		bool get(const Key& key, Value& value) override {
+			return getFrom(key, value);
+		}
+
+		// 异构查找：分片用的Hash和分片内索引的默认Hash都是透明的，同一个key算出的分片一致
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		bool get(const K& key, Value& value) {
+			return getFrom(key, value);
+		}
+
+		Value get(const Key& key) override {
+			Value value{};
+			get(key, value);
+			return value;
+		}
+
+		// 批量读：先把整批key按分片分组（只排下标，不拷贝key），每个分片只进一次、加一次锁；分组时算的hash一并交给分片
+		size_t getMany(const Key* keys, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) override {
+			if (count == 0)return 0;
+			BatchScratch scratch = takeBatchScratch();
+			groupByShard(scratch, keys, count, indices);
+			const uint32_t* order = scratch.order.data();
+			const uint64_t* hashes = scratch.hashes.data();
+			const std::vector<uint32_t>& offsets = scratch.offsets;
+			size_t base = localReplica() * shardNum_;
+			size_t hitCount = 0;
+			for (size_t s = 0; s < shardNum_; s++) {
+				size_t n = offsets[s + 1] - offsets[s];
+				if (n == 0)
+					continue;
+				Policy& shard = shards_[base + s]->cache;
+				if constexpr (kPassHash) hitCount += shard.getManyHashed(keys, hashes + offsets[s], n, values, hits, order + offsets[s]);
+				else hitCount += shard.getMany(keys, n, values, hits, order + offsets[s]);
+			}
+			batchScratch() = std::move(scratch);
+			return hitCount;
+		}
+
+		void putMany(const Key* keys, const Value* values, size_t count, const uint32_t* indices = nullptr) override {
+			if (count == 0)return;
+			BatchScratch scratch = takeBatchScratch();
+			groupByShard(scratch, keys, count, indices);
+			const uint32_t* order = scratch.order.data();
+			const uint64_t* hashes = scratch.hashes.data();
+			const std::vector<uint32_t>& offsets = scratch.offsets;
+			for (size_t s = 0; s < shardNum_; s++) {
+				size_t n = offsets[s + 1] - offsets[s];
+				if (n == 0)
+					continue;
+				OrderGuard guard(*this, s);
+				for (size_t r = 0; r < replicaNum_; r++) { // 每套副本都写一遍
+					Policy& shard = shards_[r * shardNum_ + s]->cache;
+					if constexpr (kPassHash) shard.putManyHashed(keys, hashes + offsets[s], values, n, order + offsets[s]);
+					else shard.putMany(keys, values, n, order + offsets[s]);
+				}
+			}
+			batchScratch() = std::move(scratch);
+		}
+
+		bool erase(const Key& key) override {
+			uint64_t h = keyHash(key);
+			size_t index = shardOf(h);
+			bool erased = false;
+			OrderGuard order(*this, index);
+			for (size_t r = 0; r < replicaNum_; r++) {
+				Policy& shard = shards_[r * shardNum_ + index]->cache;
+				if constexpr (kPassHash) erased = shard.eraseHashed(key, h) || erased;
+				else erased = shard.erase(key) || erased;
+			}
+			return erased;
+		}
+
+		void clear() override { // 逐个分片清空，不是整体的原子操作；kReplicated时一个分片的各副本一起清，并发的写入在各副本上都落在clear同一侧
+			for (size_t s = 0; s < shardNum_; s++) {
+				OrderGuard order(*this, s);
+				for (size_t r = 0; r < replicaNum_; r++) {
+					shards_[r * shardNum_ + s]->cache.clear();
+				}
+			}
+		}
+
+		bool contains(const Key& key) override {
+			uint64_t h = keyHash(key);
+			Policy& shard = shards_[localReplica() * shardNum_ + shardOf(h)]->cache;
+			if constexpr (kPassHash) return shard.containsHashed(key, h);
+			else return shard.contains(key);
+		}
+
+		size_t size() override { // 逐个分片加锁求和，并发写入时是近似值；kReplicated时只数本节点那一套
+			size_t base = localReplica() * shardNum_;
+			size_t total = 0;
+			for (size_t s = 0; s < shardNum_; s++) {
+				total += shards_[base + s]->cache.size();
+			}
+			return total;
+		}
+
+		// 各分片统计之和，需要Policy提供stats()；单个分片的统计用shard(i).stats()
+		MyCacheStats stats() const {
+			MyCacheStats total;
+			for (const std::unique_ptr<Shard>& shard : shards_) {
+				total += shard->cache.stats();
+			}
+			return total;
+		}
+
+		// 各分片剖析数据之和，需要Policy提供profile()；每个分片自己的锁等待/持有直方图用shard(i).profile()看，
+		// 某几个分片的长尾明显更重说明热点key集中在它们上面
+		MyCacheProfile profile() const {
+			MyCacheProfile total;
+			for (const std::unique_ptr<Shard>& shard : shards_) {
+				total += shard->cache.profile();
+			}
+			return total;
+		}
+
+		// 摆在node上的分片的统计之和，用来确认访问是否落在本地：kReplicated时各节点的命中数就是各节点线程的读取数
+		MyCacheStats nodeStats(size_t node) const {
+			MyCacheStats total;
+			for (size_t i = 0; i < shards_.size(); i++) {
+				if (shardNode_[i] == node)
+					total += shards_[i]->cache.stats();
+			}
+			return total;
+		}
+
+		// 每个分片设同一个回调，回调会被不同分片并发调用，需要自己保证线程安全；kReplicated时每套副本各自通知自己的淘汰
+		template<typename Listener>
+		void setEvictionListener(const Listener& listener) { // 需要Policy本身提供setEvictionListener
+			for (auto& shard : shards_) {
+				shard->cache.setEvictionListener(listener);
+			}
+		}
+
+		// 以下两个需要Policy本身提供，例如MyLruCache、MyLfuCache
+		void enableReadBuffer(size_t stripeNum = 0) { // 每个分片各自一份读缓冲
+			for (auto& shard : shards_) {
+				shard->cache.enableReadBuffer(stripeNum);
+			}
+		}
+
+		void cleanUp() {
+			for (auto& shard : shards_) {
+				shard->cache.cleanUp();
+			}
+		}
+
+		// 运行时调整总容量，平均分给各个分片（比分片数小时每个分片至少1个）；需要Policy本身提供setCapacity，收缩由各分片分批完成
+		void setCapacity(size_t capacity) {
+			capacity_.store(capacity, std::memory_order_relaxed);
+			for (size_t i = 0; i < shards_.size(); i++) {
+				shards_[i]->cache.setCapacity(static_cast<int>(shardCapacity(capacity, i)));
+			}
+		}
+
+		size_t capacity() const { return capacity_.load(std::memory_order_relaxed); }
+		size_t shardNum() const { return shardNum_; }
+		Policy& shard(size_t index) { return shards_[index]->cache; } // kReplicated时第r套副本的分片从r*shardNum()开始
+		MyNumaLayout layout() const { return layout_; }
+		size_t replicaNum() const { return replicaNum_; }
+		size_t shardNode(size_t index) const { return shardNode_[index]; }
+
+		// key所在分片的节点；kPartitioned时把这个key的请求交给该节点上的线程处理，访问的就都是本地内存
+		template<typename K>
+		size_t nodeOf(const K& key) const { return shardNode_[localReplica() * shardNum_ + shardIndex(key)]; }
+
+		template<typename K>
+		size_t shardIndex(const K& key) const { return shardOf(keyHash(key)); }
+
+		// 以下给在外面自己调度分片的代码用（例如MyAsyncCache）：key的hash、hash对应的分片下标、读操作该用的那套副本。
+		// passesHash()为true时keyHash的结果可以直接传给分片的*Hashed接口
+		template<typename K>
+		uint64_t keyHash(const K& key) const { return detail::hashKey(hash_, key); }
+
+		size_t shardOf(uint64_t h) const {
+			// 分片取hash的中间32位（bit 25~56），分片内的索引用低位、指纹用最高7位，三者互不相关。
+			// 乘法取高位代替取模，分片数不必是2的幂
+			uint64_t mid = static_cast<uint32_t>(h >> 25);
+			return static_cast<size_t>((mid * shardNum_) >> 32);
+		}
+
+		size_t localReplica() const { return replicaNum_ > 1 ? MyNuma::currentNode() % replicaNum_ : 0; }
+
+		static constexpr bool passesHash() { return kPassHash; }
+
+	private:
+		static int& heldOrder() {
+			thread_local int depth = 0;
+			return depth;
+		}
+
+		// 每个分片取整除的部分，余数从第0个分片起每个多分1，总和正好是capacity。
+		// capacity比分片数还小时每个分片至少1个，否则落到0容量分片上的key一写就被挤掉；总容量最多多出shardNum-capacity个。
+		// capacity为0时照旧全部为0（清空）
+		size_t shardCapacity(size_t capacity, size_t index) const {
+			if (capacity == 0)
+				return 0;
+			size_t i = index % shardNum_;
+			return std::max<size_t>(1, capacity / shardNum_ + (i < capacity % shardNum_ ? 1 : 0));
+		}
+
+		template<typename K>
+		bool getFrom(const K& key, Value& value) {
+			uint64_t h = keyHash(key);
+			Policy& shard = shards_[localReplica() * shardNum_ + shardOf(h)]->cache;
+			if constexpr (kPassHash) return shard.getHashed(key, h, value);
+			else return shard.get(key, value);
+		}
+
+		template<typename V>
+		static void putTo(Policy& shard, const Key& key, uint64_t h, V&& value) {
+			if constexpr (kPassHash) shard.putHashed(key, h, std::forward<V>(value));
+			else shard.put(key, std::forward<V>(value));
+		}
+
+		template<typename V>
+		static void putTo(Policy& shard, const Key& key, uint64_t h, V&& value, std::chrono::milliseconds ttl) {
+			if constexpr (kPassHash) shard.putHashed(key, h, std::forward<V>(value), ttl);
+			else shard.put(key, std::forward<V>(value), ttl);
+		}
+
+		template<typename... Args>
+		static void emplaceTo(Policy& shard, const Key& key, uint64_t h, Args&&... args) {
+			if constexpr (kPassHash) shard.emplaceHashed(key, h, std::forward<Args>(args)...);
+			else shard.emplace(key, std::forward<Args>(args)...);
+		}
+
+		// 批量分组用的线程局部缓冲，反复调用不再分配。用的时候整个取出来、用完放回：分片解锁时投递的移除回调可能又调用批量接口
+		// （同一个实例或别的实例），嵌套的调用拿到的是空缓冲，不会改写外层还在用的order和offsets
+		struct BatchScratch {
+			std::vector<uint32_t> shardOf;
+			std::vector<uint64_t> hashOf; // 第i个输入key的hash
+			std::vector<uint32_t> order;
+			std::vector<uint64_t> hashes; // 和order一一对应，kPassHash时交给分片的*ManyHashed
+			std::vector<uint32_t> offsets;
+			std::vector<uint32_t> cursor;
+		};
+
+		static BatchScratch& batchScratch() {
+			thread_local BatchScratch scratch;
+			return scratch;
+		}
+
+		static BatchScratch takeBatchScratch() { return std::move(batchScratch()); }
+
+		// 按分片做计数排序，scratch.order里是排好的原始下标，scratch.hashes是对应key的hash；offsets[s]~offsets[s+1]是第s个分片的那一段
+		void groupByShard(BatchScratch& scratch, const Key* keys, size_t count, const uint32_t* indices) {
+			scratch.shardOf.resize(count);
+			scratch.hashOf.resize(count);
+			scratch.order.resize(count);
+			scratch.hashes.resize(count);
+			scratch.offsets.assign(shardNum_ + 1, 0);
+			for (size_t i = 0; i < count; i++) {
+				uint64_t h = keyHash(keys[detail::batchIndex(indices, i)]);
+				uint32_t s = static_cast<uint32_t>(shardOf(h));
+				scratch.hashOf[i] = h;
+				scratch.shardOf[i] = s;
+				scratch.offsets[s + 1]++;
+			}
+			for (size_t s = 0; s < shardNum_; s++) {
+				scratch.offsets[s + 1] += scratch.offsets[s];
+			}
+			scratch.cursor.assign(scratch.offsets.begin(), scratch.offsets.end() - 1);
+			for (size_t i = 0; i < count; i++) {
+				uint32_t pos = scratch.cursor[scratch.shardOf[i]]++;
+				scratch.order[pos] = static_cast<uint32_t>(detail::batchIndex(indices, i));
+				scratch.hashes[pos] = scratch.hashOf[i];
+			}
+		}
+	};
+
+}
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "MyCachePolicy.h"
+#include "MyCacheStats.h"
+#include "MyFlatIndex.h"
+#include "MyNodePool.h"
+#include "MyRemovalQueue.h"
+
+namespace MyCache {
+
+	// 分段LRU(SLRU)：新条目先进试用段(probation)，在试用段里再次命中才升到保护段(protected)，
+	// 保护段超出份额时把最旧的降回试用段的最近端；淘汰总是先从试用段最旧的开始，试用段空了才动保护段。
+	// 只访问一次的扫描流量只在试用段里进出，挤不掉保护段里的热点。
+	// 两个段共用一个索引和一个节点池，每次操作只比LRU多一次段号判断，不需要MyKLruCache那样的历史队列
+	template<typename Key, typename Value, template<typename...> class Index = MyFlatIndex>
+	class MySlruCache :public MyCachePolicy<Key, Value> {
+	private:
+		enum SegmentId : uint8_t { kProbation, kProtected, kSegmentNum };
+
+		struct Node {
+			Key key;
+			Value value;
+			Node* prev;
+			Node* next;
+			uint8_t segment;
+
+			Node() :key(), value(), prev(this), next(this), segment(kProbation) {}
+
+			template<typename... Args>
+			explicit Node(const Key& k, Args&&... args)
+				:key(k), value(std::forward<Args>(args)...), prev(nullptr), next(nullptr), segment(kProbation) {}
+		};
+
+		struct Segment { // 带哨兵的循环链表，head.next是最近使用端，head.prev是最久未使用端
+			Node   head;
+			size_t size = 0;
+		};
+
+		using NodePtr = Node*;
+		using NodeMap = Index<Key, NodePtr>;
+		using Lock = MyNotifyingLock<std::mutex, Key, Value>;
+
+		int                 capacity_;
+		size_t              protectedCapacity_;
+		Segment             segments_[kSegmentNum];
+		NodeMap             nodeMap_;
+		MyNodePool<Node>    nodePool_;
+		std::mutex          mutex_;
+		MyStatsCounter      stats_;
+		MyRemovalQueue<Key, Value> removals_; // 锁内排队的移除通知
+
+	public:
+		// protectedPercent是保护段最多占容量的百分比，默认80%；为0时退化成普通LRU
+		explicit MySlruCache(int capacity, int protectedPercent = 80)
+			:capacity_(capacity),
+			protectedCapacity_(capacity > 0 ? static_cast<size_t>(capacity) * static_cast<size_t>(std::min(std::max(protectedPercent, 0), 100)) / 100 : 0),
+			nodeMap_(capacity > 0 ? capacity : 0),
+			nodePool_(capacity > 0 ? static_cast<size_t>(capacity) : 0) {} // 先淘汰再分配，节点数不会超过容量
+
+		~MySlruCache() override { // 析构不发移除通知
+			releaseAll();
+		}
+
+		void put(const Key& key, const Value& value) override {
+			putInternal(key, value);
+		}
+
+		void put(const Key& key, Value&& value) override {
+			putInternal(key, std::move(value));
+		}
+
+		Value get(const Key& key) override {
+			Value value{};
+			get(key, value);
+			return value;
+		}
+
+		bool get(const Key& key, Value& value) override {
+			return getInternal(key, value);
+		}
+
+		// 异构查找，例如key为std::string时直接传std::string_view/const char*
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		bool get(const K& key, Value& value) {
+			return getInternal(key, value);
+		}
+
+		// 批量读：整批只加一次锁，每kBatchChunk个key先算hash并预取索引，再依次探测
+		size_t getMany(const Key* keys, size_t count, Value* values, bool* hits, const uint32_t* indices = nullptr) override {
+			size_t hitCount = 0;
+			uint64_t hashes[detail::kBatchChunk];
+			Lock lock(mutex_, stats_, removals_);
+			for (size_t base = 0; base < count; base += detail::kBatchChunk) {
+				size_t n = std::min(detail::kBatchChunk, count - base);
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = nodeMap_.hash(keys[detail::batchIndex(indices, base + i)]);
+					nodeMap_.prefetch(hashes[i]);
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t idx = detail::batchIndex(indices, base + i);
+					NodePtr* it = nodeMap_.find(keys[idx], hashes[i]);
+					hits[idx] = it != nullptr;
+					if (it != nullptr) {
+						onHit(*it);
+						values[idx] = (*it)->value;
+						hitCount++;
+					}
+				}
+			}
+			stats_.hit(hitCount);
+			stats_.miss(count - hitCount);
+			return hitCount;
+		}
+
+		void putMany(const Key* keys, const Value* values, size_t count, const uint32_t* indices = nullptr) override {
+			if (capacity_ <= 0)return;
+
+			uint64_t hashes[detail::kBatchChunk];
+			Lock lock(mutex_, stats_, removals_);
+			for (size_t base = 0; base < count; base += detail::kBatchChunk) {
+				size_t n = std::min(detail::kBatchChunk, count - base);
+				for (size_t i = 0; i < n; i++) {
+					hashes[i] = nodeMap_.hash(keys[detail::batchIndex(indices, base + i)]);
+					nodeMap_.prefetch(hashes[i]);
+				}
+				for (size_t i = 0; i < n; i++) {
+					size_t idx = detail::batchIndex(indices, base + i);
+					putLocked(keys[idx], hashes[i], values[idx]);
+				}
+			}
+		}
+
+		bool contains(const Key& key) override { // 只查不动链表，不算一次访问
+			Lock lock(mutex_, stats_, removals_);
+			return nodeMap_.find(key) != nullptr;
+		}
+
+		bool peek(const Key& key, Value& value) { // 读值但不提升
+			Lock lock(mutex_, stats_, removals_);
+			NodePtr* it = nodeMap_.find(key);
+			if (it == nullptr)
+				return false;
+			value = (*it)->value;
+			return true;
+		}
+
+		bool erase(const Key& key) override {
+			Lock lock(mutex_, stats_, removals_);
+			NodePtr* it = nodeMap_.find(key);
+			if (it == nullptr)
+				return false;
+			removeNode(*it, MyRemovalCause::kExplicit);
+			return true;
+		}
+
+		void clear() override {
+			Lock lock(mutex_, stats_, removals_);
+			if (removals_.active()) {
+				for (Segment& segment : segments_) {
+					for (NodePtr node = segment.head.next; node != &segment.head; node = node->next) {
+						removals_.push(node->key, std::move(node->value), MyRemovalCause::kExplicit);
+					}
+				}
+			}
+			releaseAll();
+			nodeMap_.clear();
+		}
+
+		size_t size() override {
+			Lock lock(mutex_, stats_, removals_);
+			return nodeMap_.size();
+		}
+
+		size_t protectedSize() { // 保护段当前的条目数
+			Lock lock(mutex_, stats_, removals_);
+			return segments_[kProtected].size;
+		}
+
+		MyCacheStats stats() const { // 不加锁
+			return stats_.snapshot();
+		}
+
+		// 条目被淘汰或删除时的回调，在解锁后调用
+		void setEvictionListener(MyEvictionListener<Key, Value> listener) {
+			Lock lock(mutex_, stats_, removals_);
+			removals_.setListener(std::move(listener));
+		}
+
+	private:
+		template<typename V>
+		void putInternal(const Key& key, V&& value) {
+			if (capacity_ <= 0)return;
+
+			Lock lock(mutex_, stats_, removals_);
+			putLocked(key, nodeMap_.hash(key), std::forward<V>(value));
+		}
+
+		template<typename V>
+		void putLocked(const Key& key, uint64_t h, V&& value) { // 调用方持有mutex_；已有的key更新值并算一次访问
+			stats_.put();
+			NodePtr* it = nodeMap_.find(key, h);
+			if (it != nullptr) {
+				(*it)->value = std::forward<V>(value);
+				onHit(*it);
+				return;
+			}
+
+			if (nodeMap_.size() >= static_cast<size_t>(capacity_))
+				evictOne();
+			NodePtr node = nodePool_.allocate(key, std::forward<V>(value));
+			linkFront(node, kProbation);
+			nodeMap_.emplace(key, node, h);
+		}
+
+		template<typename K>
+		bool getInternal(const K& key, Value& value) {
+			Lock lock(mutex_, stats_, removals_);
+			NodePtr* it = nodeMap_.find(key);
+			if (it == nullptr) {
+				stats_.miss();
+				return false;
+			}
+			onHit(*it);
+			value = (*it)->value; // 拷贝赋值，value原有的缓冲区够大时不会重新分配
+			stats_.hit();
+			return true;
+		}
+
+		void onHit(NodePtr node) {
+			if (node->segment == kProtected) {
+				if (segments_[kProtected].head.next != node) // 已在最近端，省掉链表操作
+					moveToFront(node, kProtected);
+				return;
+			}
+			moveToFront(node, kProtected); // 试用段里第二次命中，升到保护段
+			while (segments_[kProtected].size > protectedCapacity_) {
+				moveToFront(segments_[kProtected].head.prev, kProbation);
+			}
+		}
+
+		void evictOne() { // 先淘汰试用段最旧的，试用段空了才轮到保护段
+			Segment& segment = segments_[kProbation].size > 0 ? segments_[kProbation] : segments_[kProtected];
+			removeNode(segment.head.prev, MyRemovalCause::kEvicted);
+			stats_.eviction();
+		}
+
+		void removeNode(NodePtr node, MyRemovalCause cause) {
+			unlink(node);
+			removals_.push(node->key, std::move(node->value), cause);
+			nodeMap_.erase(node->key);
+			nodePool_.deallocate(node);
+		}
+
+		void releaseAll() { // 节点全部还给池，不动索引
+			for (Segment& segment : segments_) {
+				NodePtr node = segment.head.next;
+				while (node != &segment.head) {
+					NodePtr next = node->next;
+					nodePool_.deallocate(node);
+					node = next;
+				}
+				segment.head.prev = segment.head.next = &segment.head;
+				segment.size = 0;
+			}
+		}
+
+		void moveToFront(NodePtr node, uint8_t id) {
+			unlink(node);
+			linkFront(node, id);
+		}
+
+		void unlink(NodePtr node) {
+			node->prev->next = node->next;
+			node->next->prev = node->prev;
+			segments_[node->segment].size--;
+		}
+
+		void linkFront(NodePtr node, uint8_t id) {
+			Segment& segment = segments_[id];
+			node->segment = id;
+			node->prev = &segment.head;
+			node->next = segment.head.next;
+			segment.head.next->prev = node;
+			segment.head.next = node;
+			segment.size++;
+		}
+	};
+
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "MyCachePolicy.h"
+#include "MyCacheStats.h"
+#include "MyHash.h"
+#include "MyLogStore.h"
+
+namespace MyCache {
+
+	struct MyTieredStats {
+		uint64_t l1Hits = 0;
+		uint64_t l2Hits = 0; // 一级未命中、从二级读到并提升回一级
+		uint64_t misses = 0; // 两级都没有
+		uint64_t staleDemotes = 0; // 淘汰之后、降级之前同一条带上有过put/erase/clear，为了不让旧值复活而放弃的降级
+		MyLogStoreStats l2;
+	};
+
+	// 两级缓存：L1是任意提供setEvictionListener的内存策略（MyLruCache、MyLfuCache、MyShardedCache……），L2是MyLogStore。
+	// L1因容量淘汰的条目经回调交给L2的待写队列，由L2的后台线程批量顺序写盘，L1的锁内只多一次哈希表插入；
+	// L1未命中时查L2，命中就把条目从L2取出放回L1。只有容量淘汰的条目降级，ttl过期和erase掉的不降级。
+	// 同一个key的提升和put用按hash分条的锁串行化，避免慢一步的提升用L2里的旧值覆盖刚put进L1的新值；L1命中不加这把锁。
+	// 淘汰回调在L1解锁后才投递，这时同一个key可能已经被重新put或erase过，所以降级前要确认淘汰之后这个条带没有被写过，
+	// 否则放弃降级：宁可少留一份L2副本，也不让旧值在下一次L1未命中时复活
+	template<typename Key, typename Value, typename L1, typename KeySerializer = MySerializer<Key>, typename ValueSerializer = MySerializer<Value>,
+		typename Hash = MyDefaultHash<Key>>
+	class MyTieredCache :public MyCachePolicy<Key, Value> {
+	public:
+		using Store = MyLogStore<Key, Value, KeySerializer, ValueSerializer, Hash>;
+		using Options = typename Store::Options;
+
+	private:
+		static constexpr size_t kStripeNum = 64;
+
+		struct alignas(kCacheLineSize) Stripe {
+			std::mutex mutex; // 串行化同一个key的put、erase和提升
+			std::mutex demoteMutex; // 只保护lastWrite，降级的检查和demote在它下面一起完成；不在它下面调用L1，不会和其它锁成环
+			uint64_t   lastWrite = 0; // 最近一次put/erase/clear改动这个条带时的序号
+		};
+
+		struct L1Call { // 本线程正在进行的一次L1调用，期间投递的淘汰都发生在seq之后
+			const MyTieredCache* owner;
+			uint64_t             seq;
+			L1Call*              prev; // 嵌套的调用（回调里又操作了缓存）退出时恢复
+		};
+
+		class L1Scope {
+		private:
+			L1Call call_;
+
+		public:
+			explicit L1Scope(MyTieredCache& cache) :call_{ &cache, cache.writeSeq_.load(), currentCall() } { currentCall() = &call_; }
+			~L1Scope() { currentCall() = call_.prev; }
+
+			L1Scope(const L1Scope&) = delete;
+			L1Scope& operator=(const L1Scope&) = delete;
+		};
+
+		Store                     l2_; // 先于l1_构造、后于l1_析构，L1的淘汰回调一直有效
+		L1                        l1_;
+		std::unique_ptr<Stripe[]> stripes_;
+		Hash                      hash_;
+		std::atomic<uint64_t>     l1Hits_{ 0 };
+		std::atomic<uint64_t>     l2Hits_{ 0 };
+		std::atomic<uint64_t>     misses_{ 0 };
+		std::atomic<uint64_t>     staleDemotes_{ 0 };
+		std::atomic<uint64_t>     writeSeq_{ 0 };
+
+	public:
+		// l1Args原样传给L1的构造函数
+		template<typename... L1Args>
+		explicit MyTieredCache(Options options, L1Args&&... l1Args)
+			:l2_(std::move(options)), l1_(std::forward<L1Args>(l1Args)...), stripes_(new Stripe[kStripeNum]) {
+			l1_.setEvictionListener([this](const Key& key, Value&& value, MyRemovalCause cause) {
+				if (cause == MyRemovalCause::kEvicted) // 过期和显式删除的条目不降级
+					demoteEvicted(key, std::move(value));
+			});
+		}
+
+		~MyTieredCache() override = default;
+
+		void put(const Key& key, const Value& value) override {
+			Stripe& stripe = stripeFor(key);
+			std::lock_guard<std::mutex> lock(stripe.mutex);
+			{
+				L1Scope scope(*this);
+				l1_.put(key, value);
+			}
+			markWritten(stripe); // 在L1写入之后、L2作废之前：还没投递的旧值降级要么被下面的erase清掉，要么看到这次写入而放弃
+			l2_.erase(key); // L2里的旧值作废
+		}
+
+		void put(const Key& key, Value&& value) override {
+			Stripe& stripe = stripeFor(key);
+			std::lock_guard<std::mutex> lock(stripe.mutex);
+			{
+				L1Scope scope(*this);
+				l1_.put(key, std::move(value));
+			}
+			markWritten(stripe);
+			l2_.erase(key);
+		}
+
+		Value get(const Key& key) override {
+			Value value{};
+			get(key, value);
+			return value;
+		}
+
+		bool get(const Key& key, Value& value) override {
+			if (l1_.get(key, value)) {
+				l1Hits_.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+			std::lock_guard<std::mutex> lock(stripeFor(key).mutex);
+			if (l2_.take(key, value)) {
+				L1Scope scope(*this);
+				l1_.put(key, value); // 可能挤出别的条目，降级进L2
+				l2Hits_.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+			if (l1_.get(key, value)) { // 等锁期间别的线程刚把它提升回来
+				l1Hits_.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+			misses_.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		bool erase(const Key& key) override { // 两级都删
+			Stripe& stripe = stripeFor(key);
+			std::lock_guard<std::mutex> lock(stripe.mutex);
+			bool inL1 = l1_.erase(key);
+			markWritten(stripe);
+			bool inL2 = l2_.erase(key);
+			return inL1 || inL2;
+		}
+
+		void clear() override {
+			l1_.clear();
+			for (size_t i = 0; i < kStripeNum; i++) {
+				markWritten(stripes_[i]);
+			}
+			l2_.clear();
+		}
+
+		bool contains(const Key& key) override { // 不读盘，也不提升
+			return l1_.contains(key) || l2_.contains(key);
+		}
+
+		size_t size() override { // 同一个key可能短暂地同时在两级，是近似值
+			return l1_.size() + l2_.size();
+		}
+
+		MyTieredStats stats() const {
+			MyTieredStats stats;
+			stats.l1Hits = l1Hits_.load(std::memory_order_relaxed);
+			stats.l2Hits = l2Hits_.load(std::memory_order_relaxed);
+			stats.misses = misses_.load(std::memory_order_relaxed);
+			stats.staleDemotes = staleDemotes_.load(std::memory_order_relaxed);
+			stats.l2 = l2_.stats();
+			return stats;
+		}
+
+		L1& l1() { return l1_; }
+		Store& l2() { return l2_; }
+
+	private:
+		Stripe& stripeFor(const Key& key) {
+			return stripes_[static_cast<size_t>(detail::hashKey(hash_, key) >> 58)]; // 高6位选64个条带之一
+		}
+
+		static L1Call*& currentCall() {
+			thread_local L1Call* call = nullptr;
+			return call;
+		}
+
+		void markWritten(Stripe& stripe) {
+			std::lock_guard<std::mutex> lock(stripe.demoteMutex);
+			stripe.lastWrite = writeSeq_.fetch_add(1) + 1;
+		}
+
+		// 淘汰发生在本线程这次L1调用开始之后；直接通过l1()操作L1引起的淘汰没有调用记录，只能以投递时刻为准
+		void demoteEvicted(const Key& key, Value&& value) {
+			L1Call* call = currentCall();
+			uint64_t since = call != nullptr && call->owner == this ? call->seq : writeSeq_.load();
+			Stripe& stripe = stripeFor(key);
+			std::lock_guard<std::mutex> lock(stripe.demoteMutex);
+			if (stripe.lastWrite > since) {
+				staleDemotes_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			l2_.demote(key, std::move(value));
+		}
+	};
+
+}
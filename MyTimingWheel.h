@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace MyCache {
+
+	// 侵入式定时钩子：缓存节点继承它，挂进时间轮不需要额外分配
+	struct MyTimerHook {
+		MyTimerHook* timerPrev = nullptr; // 为nullptr表示不在时间轮里
+		MyTimerHook* timerNext = nullptr;
+		uint64_t     expireTick = 0; // 过期的tick，0表示永不过期
+	};
+
+	// 分层时间轮：4层、每层64个槽，第0层一格一个tick，第i层一格64^i个tick，覆盖64^4个tick（按毫秒约4.6小时），更远的先挂在最高层，转到时再重新分配。
+	// 插入、取消都是O(1)；推进时每层用一个64位的占用位图直接跳到下一个非空槽，长时间空闲后追赶也不会逐个tick空转。
+	// 不加锁，由使用它的缓存在自己的锁内调用
+	class MyTimingWheel {
+	private:
+		static constexpr int      kLevels = 4;
+		static constexpr int      kSlotBits = 6;
+		static constexpr uint64_t kSlots = 1ULL << kSlotBits;
+		static constexpr uint64_t kSlotMask = kSlots - 1;
+		static constexpr uint64_t kMaxSpan = 1ULL << (kSlotBits * kLevels);
+
+		MyTimerHook slots_[kLevels][kSlots]; // 每个槽是带哨兵的循环链表
+		uint64_t    occupied_[kLevels]; // 第i位为1表示该层第i个槽非空
+		uint64_t    now_; // 已经处理到的tick
+		size_t      size_;
+
+	public:
+		explicit MyTimingWheel(uint64_t nowTick) :occupied_(), now_(nowTick), size_(0) {
+			for (auto& level : slots_) {
+				for (MyTimerHook& slot : level) {
+					slot.timerPrev = slot.timerNext = &slot;
+				}
+			}
+		}
+
+		MyTimingWheel(const MyTimingWheel&) = delete; // 槽里存的是哨兵地址，不能拷贝
+		MyTimingWheel& operator=(const MyTimingWheel&) = delete;
+
+		// 挂上hook，在expireTick到期；已经挂着的先摘下来
+		void schedule(MyTimerHook* hook, uint64_t expireTick) {
+			if (hook->timerPrev != nullptr)
+				cancel(hook);
+			hook->expireTick = expireTick;
+			place(hook);
+			size_++;
+		}
+
+		void cancel(MyTimerHook* hook) {
+			if (hook->timerPrev == nullptr)
+				return;
+			MyTimerHook* next = hook->timerNext;
+			hook->timerPrev->timerNext = next;
+			next->timerPrev = hook->timerPrev;
+			if (next == hook->timerPrev) { // 摘完只剩哨兵，说明槽空了，哨兵所在的层和槽由地址算出
+				clearOccupied(next);
+			}
+			hook->timerPrev = hook->timerNext = nullptr;
+			size_--;
+		}
+
+		// 推进到nowTick，对到期的hook调用onExpire(hook)（调用前hook已经摘下）。
+		// 最多处理budget个到期项，没处理完的留在当前槽里，下次调用接着处理；返回处理的个数
+		template<typename F>
+		size_t advance(uint64_t nowTick, F&& onExpire, size_t budget) {
+			size_t expired = 0;
+			while (true) {
+				expired += expireSlot(onExpire, budget - expired);
+				if (expired >= budget || now_ >= nowTick)
+					return expired;
+				uint64_t target = size_ == 0 ? nowTick : nextEvent(); // 空轮直接跳到当前时刻
+				if (target > nowTick) {
+					now_ = nowTick;
+					return expired;
+				}
+				now_ = target;
+				if ((now_ & kSlotMask) == 0)
+					cascade();
+			}
+		}
+
+		bool empty() const { return size_ == 0; }
+		size_t size() const { return size_; }
+
+	private:
+		static int lowestBit(uint64_t x) {
+			int n = 0;
+			while ((x & 1) == 0) {
+				x >>= 1;
+				n++;
+			}
+			return n;
+		}
+
+		// 下一个需要处理的tick：各层下一个非空槽变成当前槽的时刻取最小。
+		// 第L层的槽在tick是64^L的整数倍时变成当前槽，中间跳过的边界上对应的槽都是空的
+		uint64_t nextEvent() const {
+			uint64_t best = UINT64_MAX;
+			for (int level = 0; level < kLevels; level++) {
+				if (occupied_[level] == 0)
+					continue;
+				int shift = kSlotBits * level;
+				uint64_t base = now_ >> shift;
+				uint64_t index = base & kSlotMask;
+				uint64_t ahead = index + 1 < kSlots ? occupied_[level] & (~0ULL << (index + 1)) : 0;
+				uint64_t slot = ahead != 0 ? base - index + lowestBit(ahead) // 本圈后面的槽
+					: base - index + kSlots + lowestBit(occupied_[level]); // 当前槽及之前的槽属于下一圈
+				uint64_t tick = slot << shift;
+				if (tick < best)
+					best = tick;
+			}
+			return best;
+		}
+
+		void place(MyTimerHook* hook) {
+			uint64_t expire = hook->expireTick > now_ ? hook->expireTick : now_; // 已过期的放进当前槽，下次推进就处理
+			uint64_t delta = expire - now_;
+			if (delta >= kMaxSpan) // 超出范围的先挂在最高层最远的位置，转到时重新分配
+				expire = now_ + kMaxSpan - 1, delta = kMaxSpan - 1;
+			int level = 0;
+			while (level + 1 < kLevels && delta >= (1ULL << (kSlotBits * (level + 1)))) {
+				level++;
+			}
+			uint64_t index = (expire >> (kSlotBits * level)) & kSlotMask;
+			MyTimerHook& slot = slots_[level][index];
+			hook->timerNext = &slot;
+			hook->timerPrev = slot.timerPrev;
+			slot.timerPrev->timerNext = hook;
+			slot.timerPrev = hook;
+			occupied_[level] |= 1ULL << index;
+		}
+
+		void clearOccupied(const MyTimerHook* sentinel) {
+			size_t offset = static_cast<size_t>(sentinel - &slots_[0][0]);
+			occupied_[offset / kSlots] &= ~(1ULL << (offset % kSlots));
+		}
+
+		// 第0层转完一圈：依次把上面各层当前格里的项按剩余时间重新分配，某层的格号不为0时更高层还没到
+		void cascade() {
+			for (int level = 1; level < kLevels; level++) {
+				uint64_t index = (now_ >> (kSlotBits * level)) & kSlotMask;
+				occupied_[level] &= ~(1ULL << index);
+				redistribute(slots_[level][index]);
+				if (index != 0)
+					return;
+			}
+		}
+
+		void redistribute(MyTimerHook& slot) {
+			MyTimerHook* hook = slot.timerNext;
+			slot.timerPrev = slot.timerNext = &slot;
+			while (hook != &slot) {
+				MyTimerHook* next = hook->timerNext;
+				place(hook);
+				hook = next;
+			}
+		}
+
+		template<typename F>
+		size_t expireSlot(F& onExpire, size_t budget) { // 处理第0层当前槽
+			uint64_t index = now_ & kSlotMask;
+			MyTimerHook& slot = slots_[0][index];
+			size_t expired = 0;
+			while (expired < budget && slot.timerNext != &slot) {
+				MyTimerHook* hook = slot.timerNext;
+				if (hook->expireTick > now_) { // 还没真正到期（防御），重新挂到对应的层
+					schedule(hook, hook->expireTick);
+					continue;
+				}
+				cancel(hook);
+				onExpire(hook);
+				expired++;
+			}
+			return expired;
+		}
+	};
+
+}
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "MyCachePolicy.h"
+#include "MyFlatIndex.h"
+#include "MyFrequencySketch.h"
+#include "MyHash.h"
+#include "MyNodePool.h"
+#include "MyRemovalQueue.h"
+
+namespace MyCache {
+
+	// W-TinyLFU：新数据先进容量1%的窗口LRU；被窗口挤出的候选者要和主区的淘汰者比较sketch里的访问频次，
+	// 更高才能进主区，否则直接丢弃，一次性访问的key进不了主区。
+	// 主区是分段LRU(SLRU)：试用段(probation)占20%，在试用段里再次命中升到保护段(protected)，保护段满了把最旧的降回试用段。
+	// 相比MyKLruCache用一整个LRU做历史队列，这里每个key的统计只占sketch里的几个bit
+	template<typename Key, typename Value, template<typename...> class Index = MyFlatIndex>
+	class MyTinyLfuCache :public MyCachePolicy<Key, Value> {
+	private:
+		enum QueueId : uint8_t { kWindow, kProbation, kProtected, kQueueNum };
+
+		struct Node {
+			Key key;
+			Value value;
+			uint64_t sketchHash; // 淘汰比较时直接用，不再对key重新hash
+			Node* prev;
+			Node* next;
+			uint8_t queue;
+
+			Node() :key(), value(), sketchHash(0), prev(this), next(this), queue(kWindow) {}
+
+			template<typename... Args>
+			Node(const Key& k, uint64_t sh, Args&&... args)
+				:key(k), value(std::forward<Args>(args)...), sketchHash(sh), prev(nullptr), next(nullptr), queue(kWindow) {}
+		};
+
+		struct Queue { // 带哨兵的循环链表，head.next是最近使用端，head.prev是最久未使用端
+			Node   head;
+			size_t size = 0;
+		};
+
+		using NodePtr = Node*;
+		using NodeMap = Index<Key, NodePtr>;
+		using Lock = MyNotifyingLock<std::mutex, Key, Value>;
+
+		int                 capacity_;
+		size_t              windowCapacity_;
+		size_t              mainCapacity_;
+		size_t              protectedCapacity_;
+		Queue               queues_[kQueueNum];
+		NodeMap             nodeMap_;
+		MyNodePool<Node>    nodePool_;
+		MyFrequencySketch   sketch_; // 自身无锁，记录访问不需要mutex_
+		MyDefaultHash<Key>  hash_; // sketch用的hash，和索引的hash彼此独立，换成MyStdIndex也不影响频次统计
+		std::mutex          mutex_;
+		MyRemovalQueue<Key, Value> removals_; // 锁内排队的移除通知，没能进主区的候选者也算淘汰
+
+	public:
+		explicit MyTinyLfuCache(int capacity)
+			:capacity_(capacity),
+			windowCapacity_(capacity > 0 ? std::max<size_t>(1, static_cast<size_t>(capacity) / 100) : 0),
+			mainCapacity_(capacity > 0 ? static_cast<size_t>(capacity) - windowCapacity_ : 0),
+			protectedCapacity_(mainCapacity_ * 4 / 5),
+			nodeMap_(capacity > 0 ? static_cast<size_t>(capacity) + 1 : 0), // 淘汰决定前窗口会暂时多出一个，索引和节点池都按capacity+1预留
+			nodePool_(capacity > 0 ? static_cast<size_t>(capacity) + 1 : 0),
+			sketch_(capacity > 0 ? static_cast<size_t>(capacity) : 0) {}
+
+		~MyTinyLfuCache() override {
+			releaseAll();
+		}
+
+		void put(const Key& key, const Value& value) override {
+			putInternal(key, value);
+		}
+
+		void put(const Key& key, Value&& value) override {
+			putInternal(key, std::move(value));
+		}
+
+		Value get(const Key& key) override {
+			Value value{};
+			get(key, value);
+			return value;
+		}
+
+		bool get(const Key& key, Value& value) override {
+			return getInternal(key, value);
+		}
+
+		// 异构查找，例如key为std::string时直接传std::string_view/const char*
+		template<typename K, typename = std::enable_if_t<detail::isOtherKey<K, Key>>>
+		bool get(const K& key, Value& value) {
+			return getInternal(key, value);
+		}
+
+		bool contains(const Key& key) override { // 只查不动链表，也不计入访问频次
+			Lock lock(mutex_, removals_);
+			return nodeMap_.find(key) != nullptr;
+		}
+
+		bool erase(const Key& key) override {
+			Lock lock(mutex_, removals_);
+			NodePtr* it = nodeMap_.find(key);
+			if (it == nullptr)
+				return false;
+			removeNode(*it, MyRemovalCause::kExplicit);
+			return true;
+		}
+
+		void clear() override { // sketch里的频次保留，清空后热点key仍然更容易被接纳
+			Lock lock(mutex_, removals_);
+			for (Queue& queue : queues_) {
+				for (NodePtr node = queue.head.next; node != &queue.head; node = node->next) {
+					removals_.push(node->key, std::move(node->value), MyRemovalCause::kExplicit);
+				}
+			}
+			releaseAll();
+			nodeMap_.clear();
+		}
+
+		size_t size() override {
+			Lock lock(mutex_, removals_);
+			return nodeMap_.size();
+		}
+
+		// 条目被淘汰或删除时的回调，在解锁后调用
+		void setEvictionListener(MyEvictionListener<Key, Value> listener) {
+			Lock lock(mutex_, removals_);
+			removals_.setListener(std::move(listener));
+		}
+
+		// 估计的访问频次，不加锁
+		template<typename K>
+		int frequency(const K& key) const {
+			return sketch_.frequency(static_cast<uint64_t>(hash_(key)));
+		}
+
+	private:
+		template<typename V>
+		void putInternal(const Key& key, V&& value) {
+			if (capacity_ <= 0)return;
+
+			uint64_t sh = static_cast<uint64_t>(hash_(key));
+			sketch_.increment(sh); // 锁外记录访问
+			Lock lock(mutex_, removals_);
+			uint64_t h = nodeMap_.hash(key);
+			NodePtr* it = nodeMap_.find(key, h);
+			if (it != nullptr) {
+				(*it)->value = std::forward<V>(value);
+				onHit(*it);
+				return;
+			}
+
+			NodePtr node = nodePool_.allocate(key, sh, std::forward<V>(value));
+			linkFront(node, kWindow);
+			nodeMap_.emplace(key, node, h);
+			if (queues_[kWindow].size > windowCapacity_)
+				evictFromWindow();
+		}
+
+		template<typename K>
+		bool getInternal(const K& key, Value& value) {
+			sketch_.increment(static_cast<uint64_t>(hash_(key))); // 未命中也要计数，回源后的put才有机会被接纳
+			Lock lock(mutex_, removals_);
+			NodePtr* it = nodeMap_.find(key);
+			if (it == nullptr)
+				return false;
+			onHit(*it);
+			value = (*it)->value;
+			return true;
+		}
+
+		void onHit(NodePtr node) {
+			switch (node->queue) {
+			case kWindow:
+			case kProtected:
+				moveToFront(node, node->queue);
+				break;
+			case kProbation: // 试用段再次命中，升到保护段
+				moveToFront(node, kProtected);
+				while (queues_[kProtected].size > protectedCapacity_) {
+					moveToFront(queues_[kProtected].head.prev, kProbation);
+				}
+				break;
+			}
+		}
+
+		// 窗口超出容量：窗口最旧的候选者和主区最旧的淘汰者比频次，赢的留在主区
+		void evictFromWindow() {
+			NodePtr candidate = queues_[kWindow].head.prev;
+			if (mainCapacity_ == 0) {
+				removeNode(candidate, MyRemovalCause::kEvicted);
+				return;
+			}
+			if (queues_[kProbation].size + queues_[kProtected].size < mainCapacity_) { // 主区没满直接进
+				moveToFront(candidate, kProbation);
+				return;
+			}
+
+			Queue& victimQueue = queues_[kProbation].size > 0 ? queues_[kProbation] : queues_[kProtected];
+			NodePtr victim = victimQueue.head.prev;
+			if (sketch_.frequency(candidate->sketchHash) > sketch_.frequency(victim->sketchHash)) {
+				removeNode(victim, MyRemovalCause::kEvicted);
+				moveToFront(candidate, kProbation);
+			}
+			else {
+				removeNode(candidate, MyRemovalCause::kEvicted);
+			}
+		}
+
+		void removeNode(NodePtr node, MyRemovalCause cause) {
+			unlink(node);
+			removals_.push(node->key, std::move(node->value), cause);
+			nodeMap_.erase(node->key);
+			nodePool_.deallocate(node);
+		}
+
+		void releaseAll() { // 节点全部还给池，不动索引
+			for (Queue& queue : queues_) {
+				NodePtr node = queue.head.next;
+				while (node != &queue.head) {
+					NodePtr next = node->next;
+					nodePool_.deallocate(node);
+					node = next;
+				}
+				queue.head.prev = queue.head.next = &queue.head;
+				queue.size = 0;
+			}
+		}
+
+		void moveToFront(NodePtr node, uint8_t id) {
+			unlink(node);
+			linkFront(node, id);
+		}
+
+		void unlink(NodePtr node) {
+			node->prev->next = node->next;
+			node->next->prev = node->prev;
+			queues_[node->queue].size--;
+		}
+
+		void linkFront(NodePtr node, uint8_t id) {
+			Queue& queue = queues_[id];
+			node->queue = id;
+			node->prev = &queue.head;
+			node->next = queue.head.next;
+			queue.head.next->prev = node;
+			queue.head.next = node;
+			queue.size++;
+		}
+	};
+
+}
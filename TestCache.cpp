@@ -5,10 +5,22 @@
 #include <iomanip>
 #include <random>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <optional>
+#include <thread>
 
 #include "MyCachePolicy.h"
 #include "MyLruCache.h"
 #include "MyLfuCache.h"
+#include "MyArcCache.h"
+#include "MySlruCache.h"
+#include "MyTinyLfuCache.h"
+#include "MyShardedCache.h"
+#include "MyLoadingCache.h"
+#include "MyTieredCache.h"
+#include "MyArenaLruCache.h"
+#include "MyAsyncCache.h" // C++17下是空的，testAsyncCache只在C++20下编进来
 
 class Timer {
 public:
@@ -24,16 +36,25 @@ private:
 };
 
 // 辅助函数：打印结果
+// 吞吐和延迟见MyCacheBench.cpp，这里只看命中率
+const char* const kPolicyNames[] = { "LRU", "LFU", "ARC", "TinyLFU", "SLRU" };
+
+// 功能检查：前端、分层这类头文件不参与命中率对比，在这里各跑一遍最基本的场景，保证它们至少被编译、被执行过
+int failedChecks = 0;
+
+void expect(bool ok, const std::string& what) {
+    std::cout << (ok ? "通过: " : "失败: ") << what << std::endl;
+    if (!ok) failedChecks++;
+}
+
 void printResults(const std::string& testName, int capacity,
     const std::vector<int>& get_operations,
     const std::vector<int>& hits) {
     std::cout << "缓存大小: " << capacity << std::endl;
-    std::cout << "LRU - 命中率: " << std::fixed << std::setprecision(2)
-        << (100.0 * hits[0] / get_operations[0]) << "%" << std::endl;
-    std::cout << "LFU - 命中率: " << std::fixed << std::setprecision(2)
-        << (100.0 * hits[1] / get_operations[1]) << "%" << std::endl;
-    std::cout << "ARC - 命中率: " << std::fixed << std::setprecision(2)
-        << (100.0 * hits[2] / get_operations[2]) << "%" << std::endl;
+    for (size_t i = 0; i < hits.size(); ++i) {
+        std::cout << kPolicyNames[i] << " - 命中率: " << std::fixed << std::setprecision(2)
+            << (100.0 * hits[i] / get_operations[i]) << "%" << std::endl;
+    }
 }
 
 void testHotDataAccess() {
@@ -46,16 +67,19 @@ void testHotDataAccess() {
 
     MyCache::MyLruCache<int, std::string> lru(CAPACITY);
     MyCache::MyLfuCache<int, std::string> lfu(CAPACITY);
+    MyCache::MyArcCache<int, std::string> arc(CAPACITY);
+    MyCache::MyTinyLfuCache<int, std::string> tinyLfu(CAPACITY);
+    MyCache::MySlruCache<int, std::string> slru(CAPACITY);
 
     std::random_device rd;
     std::mt19937 gen(rd());
 
-    std::array<MyCache::MyCachePolicy<int, std::string>*, 2> caches = { &lru, &lfu };
+    std::array<MyCache::MyCachePolicy<int, std::string>*, 5> caches = { &lru, &lfu, &arc, &tinyLfu, &slru };
     /*std::vector<MyCache::MyCachePolicy<int, std::string>*> caches;
     caches.emplace_back(lru);
     caches.emplace_back(lfu);*/
-    std::vector<int> hits(2, 0);
-    std::vector<int> get_operations(2, 0);
+    std::vector<int> hits(caches.size(), 0);
+    std::vector<int> get_operations(caches.size(), 0);
 
     // 先进行一系列put操作
     for (int i = 0; i < caches.size(); ++i) {
@@ -101,14 +125,19 @@ void testLoopPattern() {
 
    MyCache::MyLruCache<int, std::string> lru(CAPACITY);
    MyCache::MyLfuCache<int, std::string> lfu(CAPACITY);
-   
+   MyCache::MyArcCache<int, std::string> arc(CAPACITY);
+   MyCache::MyTinyLfuCache<int, std::string> tinyLfu(CAPACITY);
+   MyCache::MySlruCache<int, std::string> slru(CAPACITY);
 
     //std::array<MyCache::MyCachePolicy<int, std::string>*, 2> caches = { &lru, &lfu };
     std::vector<MyCache::MyCachePolicy<int, std::string>*> caches;
-    caches.emplace_back(lru);
-    caches.emplace_back(lfu);
-    std::vector<int> hits(2, 0);
-    std::vector<int> get_operations(2, 0);
+    caches.emplace_back(&lru);
+    caches.emplace_back(&lfu);
+    caches.emplace_back(&arc);
+    caches.emplace_back(&tinyLfu);
+    caches.emplace_back(&slru);
+    std::vector<int> hits(caches.size(), 0);
+    std::vector<int> get_operations(caches.size(), 0);
 
     std::random_device rd;
     std::mt19937 gen(rd());
@@ -155,16 +184,21 @@ void testWorkloadShift() {
 
    MyCache::MyLruCache<int, std::string> lru(CAPACITY);
    MyCache::MyLfuCache<int, std::string> lfu(CAPACITY);
-   
+   MyCache::MyArcCache<int, std::string> arc(CAPACITY);
+   MyCache::MyTinyLfuCache<int, std::string> tinyLfu(CAPACITY);
+   MyCache::MySlruCache<int, std::string> slru(CAPACITY);
 
     std::random_device rd;
     std::mt19937 gen(rd());
     //std::array<MyCache::MyCachePolicy<int, std::string>*, 2> caches = { &lru, &lfu };
     std::vector<MyCache::MyCachePolicy<int, std::string>*> caches;
-    caches.emplace_back(lru);
-    caches.emplace_back(lfu);
-    std::vector<int> hits(2, 0);
-    std::vector<int> get_operations(2, 0);
+    caches.emplace_back(&lru);
+    caches.emplace_back(&lfu);
+    caches.emplace_back(&arc);
+    caches.emplace_back(&tinyLfu);
+    caches.emplace_back(&slru);
+    std::vector<int> hits(caches.size(), 0);
+    std::vector<int> get_operations(caches.size(), 0);
 
     // 先填充一些初始数据
     for (int i = 0; i < caches.size(); ++i) {
@@ -220,9 +254,149 @@ void testWorkloadShift() {
     printResults("工作负载剧烈变化测试", CAPACITY, get_operations, hits);
 }
 
+// MyLoadingCache套在MyShardedCache上：并发未命中只回源一次，带ttl加载的条目在过期前被命中时后台预刷新
+void testLoadingCache() {
+    std::cout << "\n=== 功能检查：MyLoadingCache ===" << std::endl;
+
+    using Sharded = MyCache::MyShardedCache<int, std::string, MyCache::MyLruCache<int, std::string>>;
+    Sharded sharded(100, 4);
+    MyCache::MyLoadingCache<int, std::string, Sharded> loading(sharded, std::chrono::milliseconds(100));
+
+    std::atomic<int> version(0);
+    auto loader = [&version](const int& key) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20)); // 慢回源，让并发请求都赶上同一次加载
+        return "value" + std::to_string(key) + "-" + std::to_string(++version);
+    };
+
+    std::vector<std::thread> threads;
+    std::atomic<int> matched(0);
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&] {
+            if (loading.getOrLoad(7, loader, std::chrono::milliseconds(300)) == "value7-1") matched++;
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    expect(matched == 8 && loading.stats().loads == 1, "8个线程并发未命中同一个key，只回源一次");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(230)); // 进入过期前100ms的预刷新窗口
+    expect(loading.getOrLoad(7, loader, std::chrono::milliseconds(300)) == "value7-1", "预刷新窗口内命中先返回旧值");
+    std::string value;
+    for (int i = 0; i < 100 && !(sharded.get(7, value) && value == "value7-2"); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    expect(value == "value7-2" && loading.stats().refreshes == 1, "后台预刷新写回新值");
+}
+
+// MyTieredCache：L1淘汰的条目经MyLogStore落盘，再次读到时提升回L1；erase和并发写入挤出的降级赛跑时旧值不能复活
+void testTieredCache() {
+    std::cout << "\n=== 功能检查：MyTieredCache ===" << std::endl;
+
+    using Tiered = MyCache::MyTieredCache<int, std::string, MyCache::MyLruCache<int, std::string>>;
+    Tiered::Options options;
+    options.path = "TestCache.tiered"; // 段文件随析构删除
+    options.segmentBytes = 4096; // 段开得小，写满后滚动到新段、超过maxSegments时丢弃最老的段
+    options.maxSegments = 4;
+    options.flushInterval = std::chrono::milliseconds(1);
+    Tiered tiered(options, 8);
+
+    for (int key = 0; key < 20; ++key) {
+        tiered.put(key, "value" + std::to_string(key));
+    }
+    std::string value;
+    expect(tiered.get(0, value) && value == "value0" && tiered.stats().l2Hits == 1, "L1淘汰的条目从L2读回并提升");
+    expect(tiered.l1().contains(0), "提升后的条目回到L1");
+
+    std::atomic<bool> stop(false);
+    std::thread writer([&] { // 不停写别的key，把L1里的条目挤出去降级
+        for (int i = 0; !stop.load(); ++i) tiered.put(1000 + i % 2000, std::string(64, 'x'));
+    });
+    int resurrected = 0;
+    for (int i = 0; i < 2000; ++i) {
+        tiered.put(7, "round" + std::to_string(i));
+        tiered.erase(7);
+        if (tiered.get(7, value)) resurrected++;
+    }
+    stop = true;
+    writer.join();
+    MyCache::MyTieredStats stats = tiered.stats();
+    expect(resurrected == 0, "erase和降级赛跑，删掉的key不会从L2复活");
+    expect(stats.l2.demoted > 0 && stats.l2.segmentsDropped > 0, "降级写盘并滚动丢弃旧段");
+}
+
+// MyArenaLruCache：容量满后淘汰最久未使用的槽位并原地复用
+void testArenaLruCache() {
+    std::cout << "\n=== 功能检查：MyArenaLruCache ===" << std::endl;
+
+    MyCache::MyArenaLruCache<int, int> arena(3);
+    int evicted = -1;
+    arena.setEvictionListener([&evicted](const int& key, int&&, MyCache::MyRemovalCause cause) {
+        if (cause == MyCache::MyRemovalCause::kEvicted) evicted = key;
+    });
+    arena.put(1, 10);
+    arena.put(2, 20);
+    arena.put(3, 30);
+    int value = 0;
+    arena.get(1, value); // 1变成最近使用，2成了最久未使用
+    arena.put(4, 40);
+    expect(evicted == 2 && !arena.get(2, value), "淘汰最久未使用的条目");
+    expect(arena.get(1, value) && value == 10 && arena.get(4, value) && value == 40 && arena.size() == 3, "其余条目保留，槽位复用");
+}
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+// 立即开始、不等人取结果的协程，用来驱动MyAsyncCache
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+using AsyncPolicy = MyCache::MyLruCache<int, std::string>;
+
+DetachedTask runAsyncChecks(MyCache::MyAsyncCache<int, std::string, AsyncPolicy>& async, int& loads, bool& finished) {
+    std::optional<std::string> miss = co_await async.getAsync(1);
+    co_await async.putAsync(1, std::string("one"));
+    std::optional<std::string> hit = co_await async.getAsync(1);
+    expect(!miss && hit && *hit == "one", "getAsync/putAsync");
+    auto loader = [&loads](const int& key) {
+        loads++;
+        return "loaded" + std::to_string(key);
+    };
+    std::string first = co_await async.getOrLoadAsync(2, loader);
+    std::string second = co_await async.getOrLoadAsync(2, loader);
+    expect(first == "loaded2" && second == "loaded2" && loads == 1, "getOrLoadAsync未命中加载一次，之后命中");
+    bool erased = co_await async.eraseAsync(1);
+    std::optional<std::string> gone = co_await async.getAsync(1);
+    expect(erased && !gone, "eraseAsync");
+    finished = true;
+}
+
+void testAsyncCache() {
+    std::cout << "\n=== 功能检查：MyAsyncCache ===" << std::endl;
+
+    MyCache::MyShardedCache<int, std::string, AsyncPolicy> sharded(100, 4);
+    MyCache::MyAsyncCache<int, std::string, AsyncPolicy> async(sharded);
+    int loads = 0;
+    bool finished = false;
+    runAsyncChecks(async, loads, finished); // 没有竞争时每一步都当场完成，返回时协程已经跑完
+    expect(finished, "协程跑完");
+}
+#else
+void testAsyncCache() {
+    std::cout << "\n=== 功能检查：MyAsyncCache（需要C++20，跳过） ===" << std::endl;
+}
+#endif
+
 int main() {
     testHotDataAccess();
-    /*testLoopPattern();
-    testWorkloadShift();*/
-    return 0;
+    testLoopPattern();
+    testWorkloadShift();
+    testLoadingCache();
+    testTieredCache();
+    testArenaLruCache();
+    testAsyncCache();
+    return failedChecks > 0 ? 1 : 0;
 }
\ No newline at end of file